@@ -0,0 +1,217 @@
+// compress.cc
+//	Routines to compress and decompress the chunks of a compressed
+//	file, and to cache decompressed chunks in memory.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+#ifndef FILESYS_STUB
+
+#include "copyright.h"
+#include "compress.h"
+#include "filehdr.h"
+#include "synch.h"
+
+// Limits of a back reference: two bytes hold a 12 bit distance and a
+// 4 bit length.  Shorter repeats are cheaper stored as literals.
+#define MinMatch	3
+#define MaxMatch	(MinMatch + 15)
+#define MaxDistance	4096
+
+//----------------------------------------------------------------------
+// Compress
+// 	Compress "size" bytes of data.  The result is only useful if it
+//	is smaller than the data, so give up as soon as it is not.
+//
+//	Return the number of bytes stored in "into", or -1 if the data
+//	does not compress.
+//
+//	"from" -- the data to compress
+//	"size" -- how many bytes of it
+//	"into" -- where to put the result; must hold "size" bytes
+//----------------------------------------------------------------------
+
+int
+Compress(char *from, int size, char *into)
+{
+    int in = 0, out = 0, flagPos = 0, item = 8;
+
+    while (in < size) {
+	if (out + 3 > size)			// flag byte + a reference
+	    return -1;
+	if (item == 8) {			// start a new group
+	    flagPos = out++;
+	    into[flagPos] = 0;
+	    item = 0;
+	}
+
+	// find the longest earlier copy of what comes next
+	int bestLength = 0, bestDistance = 0;
+	int start = (in > MaxDistance) ? in - MaxDistance : 0;
+	for (int i = start; i < in; i++) {
+	    int length = 0;
+	    while (length < MaxMatch && in + length < size
+			&& from[i + length] == from[in + length])
+		length++;
+	    if (length > bestLength) {
+		bestLength = length;
+		bestDistance = in - i;
+	    }
+	}
+
+	if (bestLength >= MinMatch) {
+	    into[flagPos] |= (1 << item);
+	    into[out++] = (char) ((bestDistance - 1) >> 4);
+	    into[out++] = (char) ((((bestDistance - 1) & 0xf) << 4) 
+					| (bestLength - MinMatch));
+	    in += bestLength;
+	} else {
+	    into[out++] = from[in++];
+	}
+	item++;
+    }
+    return (out < size) ? out : -1;
+}
+
+//----------------------------------------------------------------------
+// Decompress
+// 	Rebuild "size" bytes of data from the output of Compress.
+//
+//	"from" -- the compressed data
+//	"length" -- how many bytes of it
+//	"into" -- where to put the data
+//	"size" -- how many bytes the data had before it was compressed
+//----------------------------------------------------------------------
+
+void
+Decompress(char *from, int length, char *into, int size)
+{
+    int in = 0, out = 0;
+
+    while (in < length && out < size) {
+	unsigned char flags = (unsigned char) from[in++];
+	for (int item = 0; item < 8 && in < length && out < size; item++) {
+	    if (flags & (1 << item)) {
+		unsigned char hi = (unsigned char) from[in++];
+		unsigned char lo = (unsigned char) from[in++];
+		int distance = ((hi << 4) | (lo >> 4)) + 1;
+		int count = (lo & 0xf) + MinMatch;
+		ASSERT(distance <= out);
+		for (int i = 0; i < count && out < size; i++, out++)
+		    into[out] = into[out - distance];
+	    } else {
+		into[out++] = from[in++];
+	    }
+	}
+    }
+    ASSERT(out == size);
+}
+
+//----------------------------------------------------------------------
+// ChunkCache::ChunkCache
+// 	Initialize an empty cache of decompressed chunks.
+//
+//	"size" is the number of chunks the cache can hold
+//----------------------------------------------------------------------
+
+ChunkCache::ChunkCache(int size)
+{
+    cacheSize = size;
+    table = new ChunkCacheEntry[size];
+    for (int i = 0; i < size; i++) {
+	table[i].valid = FALSE;
+	table[i].data = new char[ChunkSize];
+    }
+    clock = 0;
+    lock = new Lock("chunk cache");
+}
+
+//----------------------------------------------------------------------
+// ChunkCache::~ChunkCache
+// 	De-allocate the cache.
+//----------------------------------------------------------------------
+
+ChunkCache::~ChunkCache()
+{
+    for (int i = 0; i < cacheSize; i++)
+	delete [] table[i].data;
+    delete [] table;
+    delete lock;
+}
+
+//----------------------------------------------------------------------
+// ChunkCache::Read
+// 	Copy chunk "chunk" of the file whose header is in "hdrSector"
+//	into "into", if it is in the cache.  Return TRUE if it was.
+//----------------------------------------------------------------------
+
+bool
+ChunkCache::Read(int hdrSector, int chunk, char *into)
+{
+    bool found = FALSE;
+
+    lock->Acquire();
+    for (int i = 0; i < cacheSize; i++) {
+	if (table[i].valid && table[i].hdrSector == hdrSector 
+				&& table[i].chunk == chunk) {
+	    bcopy(table[i].data, into, ChunkSize);
+	    table[i].lastUsed = ++clock;
+	    found = TRUE;
+	    break;
+	}
+    }
+    lock->Release();
+    return found;
+}
+
+//----------------------------------------------------------------------
+// ChunkCache::Write
+// 	Remember the contents of chunk "chunk" of the file whose header
+//	is in "hdrSector", replacing any older copy.  If the chunk is not
+//	in the cache, it takes a free slot, or else the slot of the
+//	least recently used chunk.
+//----------------------------------------------------------------------
+
+void
+ChunkCache::Write(int hdrSector, int chunk, char *from)
+{
+    int victim = 0;
+
+    lock->Acquire();
+    for (int i = 0; i < cacheSize; i++) {
+	if (table[i].valid && table[i].hdrSector == hdrSector 
+				&& table[i].chunk == chunk) {
+	    victim = i;
+	    break;
+	}
+	if (!table[i].valid) 
+	    victim = i;
+	else if (table[victim].valid && table[i].lastUsed < table[victim].lastUsed)
+	    victim = i;
+    }
+    table[victim].valid = TRUE;
+    table[victim].hdrSector = hdrSector;
+    table[victim].chunk = chunk;
+    table[victim].lastUsed = ++clock;
+    bcopy(from, table[victim].data, ChunkSize);
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// ChunkCache::Invalidate
+// 	Forget every chunk of the file whose header is in "hdrSector".
+//	Called when the file is removed, since its header sector may be
+//	reused by another file.
+//----------------------------------------------------------------------
+
+void
+ChunkCache::Invalidate(int hdrSector)
+{
+    lock->Acquire();
+    for (int i = 0; i < cacheSize; i++)
+	if (table[i].valid && table[i].hdrSector == hdrSector)
+	    table[i].valid = FALSE;
+    lock->Release();
+}
+
+#endif // FILESYS_STUB
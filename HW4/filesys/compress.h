@@ -0,0 +1,77 @@
+// compress.h
+//	Routines to compress the data of a file, and data structures to
+//	keep recently used parts of compressed files in memory.
+//
+//	A compressed file is stored as a sequence of chunks, each of
+//	ChunkSize bytes (see filehdr.h), compressed independently of
+//	the others so that any part of the file can be read or changed
+//	without touching the rest.  The compressed length of each chunk
+//	is kept in the file header.
+//
+//	The compression is a simple LZ77 variant: the output is a series
+//	of groups, each a flag byte followed by up to eight items.  Each
+//	bit of the flag byte says whether the matching item is a literal
+//	byte, or a two-byte reference to an earlier copy of 3 to 18 bytes
+//	within the same chunk.  Text, and especially text with many
+//	repeated digits, typically shrinks to a third of its size.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef COMPRESS_H
+#define COMPRESS_H
+
+#include "copyright.h"
+#include "utility.h"
+
+class Lock;
+
+extern int Compress(char *from, int size, char *into);
+					// Compress "size" bytes into "into";
+					// return the compressed length, or
+					// -1 if that would not be smaller
+extern void Decompress(char *from, int length, char *into, int size);
+					// Undo Compress: "length" compressed
+					// bytes become "size" bytes of data
+
+// The following class defines a cache of decompressed chunks, shared by
+// every open compressed file.  Each chunk is identified by the sector
+// of its file's header, and its index within the file.  Reading a
+// chunk that is in the cache costs no disk access at all.
+//
+// The cache is write-through: whoever changes a chunk also writes it
+// to disk, and then updates the cache.  The least recently used chunk
+// is replaced when there is no free slot.
+
+class ChunkCacheEntry {
+  public:
+    bool valid;				// Does this slot hold a chunk?
+    int hdrSector;			// Header of the file it belongs to
+    int chunk;				// Which chunk of that file
+    int lastUsed;			// For replacement
+    char *data;				// The decompressed chunk
+};
+
+class ChunkCache {
+  public:
+    ChunkCache(int size);		// Initialize an empty cache with
+					// room for "size" chunks
+    ~ChunkCache();			// De-allocate the cache
+
+    bool Read(int hdrSector, int chunk, char *into);
+					// Copy a chunk out of the cache;
+					// FALSE if it isn't there
+    void Write(int hdrSector, int chunk, char *from);
+					// Put a new copy of a chunk in
+					// the cache
+    void Invalidate(int hdrSector);	// Forget all chunks of a file
+
+  private:
+    int cacheSize;			// Number of slots
+    ChunkCacheEntry *table;		// The slots
+    int clock;				// Bumped on each use, for LRU
+    Lock *lock;				// Protects everything above
+};
+
+#endif // COMPRESS_H
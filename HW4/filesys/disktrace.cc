@@ -0,0 +1,287 @@
+// disktrace.cc
+//	Routines to record disk requests in a trace file, and to replay
+//	a trace against a scratch disk.  See disktrace.h.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "disktrace.h"
+#include "ssd.h"
+#include "main.h"
+
+//----------------------------------------------------------------------
+// DiskTrace::DiskTrace
+// 	Start a new, empty trace in the UNIX file "name", replacing any
+//	file already there.
+//----------------------------------------------------------------------
+
+DiskTrace::DiskTrace(char *name)
+{
+    int magicNum = TraceMagicNumber;
+
+    fileno = OpenForWrite(name);
+    WriteFile(fileno, (char *) &magicNum, sizeof(int));
+    numBuffered = 0;
+}
+
+//----------------------------------------------------------------------
+// DiskTrace::~DiskTrace
+// 	Write out the records still buffered, and close the trace.
+//----------------------------------------------------------------------
+
+DiskTrace::~DiskTrace()
+{
+    Drain();
+    Close(fileno);
+}
+
+//----------------------------------------------------------------------
+// DiskTrace::Record
+// 	Note a request made just now by the current thread: "numSectors"
+//	sectors from "sector", or a flush.  The file is the one whose
+//	data the thread is moving, if any (see OpenFile::ReadAt).
+//	Records are written out TraceBufferSize at a time.
+//----------------------------------------------------------------------
+
+void
+DiskTrace::Record(int sector, int numSectors, TraceKind kind)
+{
+    TraceRecord *record = &buffer[numBuffered++];
+
+    record->tick = kernel->stats->totalTicks;
+    record->thread = kernel->currentThread->getID();
+    record->sector = sector;
+    record->origin = kernel->currentThread->diskOrigin;
+    record->numSectors = numSectors;
+    record->kind = kind;
+    if (numBuffered == TraceBufferSize)
+	Drain();
+}
+
+void
+DiskTrace::Drain()
+{
+    WriteFile(fileno, (char *) buffer, numBuffered * sizeof(TraceRecord));
+    numBuffered = 0;
+}
+
+//----------------------------------------------------------------------
+// ReplayRequest::ReplayRequest
+// 	A request of a trace, made just now.
+//----------------------------------------------------------------------
+
+ReplayRequest::ReplayRequest(TraceReplay *replay, TraceRecord *record)
+{
+    this->replay = replay;
+    this->record = record;
+    arrived = kernel->stats->totalTicks;
+}
+
+void
+ReplayRequest::CallBack()
+{
+    replay->Done(this);
+}
+
+//----------------------------------------------------------------------
+// TraceReplay::TraceReplay
+// 	Read the trace in UNIX file "name", and make a scratch disk to
+//	replay it on: a flash disk if kernel->flash, with a write cache
+//	if kernel->writeCache isn't 0.
+//----------------------------------------------------------------------
+
+TraceReplay::TraceReplay(char *name)
+{
+    int fileno = OpenForRead(name, TRUE);
+    int magicNum, length, maxSectors = 1;
+
+    Read(fileno, (char *) &magicNum, sizeof(int));
+    ASSERT(magicNum == TraceMagicNumber);
+    Lseek(fileno, 0, 2);
+    length = Tell(fileno) - sizeof(int);
+    numRecords = length / sizeof(TraceRecord);
+    records = new TraceRecord[numRecords + 1];
+    Lseek(fileno, sizeof(int), 0);
+    Read(fileno, (char *) records, numRecords * sizeof(TraceRecord));
+    Close(fileno);
+    for (int i = 0; i < numRecords; i++) {
+	ASSERT(records[i].kind == TraceFlush || (records[i].sector >= 0
+		&& records[i].numSectors > 0
+		&& records[i].sector + records[i].numSectors <= NumSectors));
+	if (records[i].numSectors > maxSectors)
+	    maxSectors = records[i].numSectors;
+    }
+
+    sprintf(diskName, "DISK_%d_replay", kernel->hostName);
+    Unlink(diskName);			// start from an empty disk
+    if (kernel->flash) {
+	disk = new Ssd(diskName, NULL, NULL);
+    } else {
+	disk = new Disk(diskName, NULL, NULL);
+	if (kernel->writeCache > 0)
+	    disk->EnableWriteCache(kernel->writeCache);
+    }
+    data = new char[maxSectors * SectorSize];
+    bzero(data, maxSectors * SectorSize);
+    waiting = new List<ReplayRequest *>;
+    finished = new Semaphore("replay finished", 0);
+    next = numSent = numDone = numSectors = 0;
+    startTicks = endTicks = 0;
+
+    latency = new Histogram("replay_latency");
+    readLatency = new Histogram("replay_read_latency");
+    writeLatency = new Histogram("replay_write_latency");
+    flushLatency = new Histogram("replay_flush_latency");
+}
+
+TraceReplay::~TraceReplay()
+{
+    delete disk;
+    Unlink(diskName);
+    delete [] records;
+    delete [] data;
+    delete waiting;
+    delete finished;
+    delete latency;
+    delete readLatency;
+    delete writeLatency;
+    delete flushLatency;
+}
+
+//----------------------------------------------------------------------
+// TraceReplay::Run
+// 	Replay the trace: the first request is made right away (well,
+//	in a tick), and each of the others the same time after it as
+//	when it was recorded.  Return once all of them are done, and
+//	the disk has nothing left to do.
+//----------------------------------------------------------------------
+
+void
+TraceReplay::Run()
+{
+    if (numRecords == 0)
+	return;
+    startTicks = kernel->stats->totalTicks + 1;
+    offset = startTicks - records[0].tick;
+    kernel->interrupt->Schedule(this, 1, DiskInt);
+    finished->P();
+
+    // empty the write cache, so that the disk can be deleted; this
+    // isn't counted in the report
+    disk->FlushRequest(new ReplayRequest(this, NULL));
+    finished->P();
+}
+
+//----------------------------------------------------------------------
+// TraceReplay::CallBack
+// 	Interrupt handler: make every request that is due, then schedule
+//	the interrupt for the next.  A request is sent to the disk if it
+//	holds fewer than kernel->queueDepth requests; otherwise it waits
+//	its turn, as it would have at SynchDisk.
+//----------------------------------------------------------------------
+
+void
+TraceReplay::CallBack()
+{
+    int now = kernel->stats->totalTicks;
+    ReplayRequest *request;
+
+    while (next < numRecords && records[next].tick + offset <= now) {
+	request = new ReplayRequest(this, &records[next++]);
+	if (numSent < kernel->queueDepth)
+	    Send(request);
+	else
+	    waiting->Append(request);
+    }
+    if (next < numRecords)
+	kernel->interrupt->Schedule(this, records[next].tick + offset - now,
+				    DiskInt);
+}
+
+//----------------------------------------------------------------------
+// TraceReplay::Send
+// 	Send a request to the disk.  The sector contents don't matter:
+//	reads and writes all use the same scratch buffer.
+//----------------------------------------------------------------------
+
+void
+TraceReplay::Send(ReplayRequest *request)
+{
+    TraceRecord *record = request->record;
+
+    numSent++;
+    switch (record->kind) {
+      case TraceRead:
+	disk->ReadRequest(record->sector, data, record->numSectors, request);
+	break;
+      case TraceWrite:
+	disk->WriteRequest(record->sector, data, record->numSectors, request);
+	break;
+      case TraceFlush:
+	disk->FlushRequest(request);
+	break;
+      default:
+	ASSERTNOTREACHED();
+    }
+}
+
+//----------------------------------------------------------------------
+// TraceReplay::Done
+// 	Disk interrupt handler: note how long "request" took from when
+//	it was made, and send the next request waiting, if any.  When
+//	the last is done, wake up Run.
+//----------------------------------------------------------------------
+
+void
+TraceReplay::Done(ReplayRequest *request)
+{
+    int now = kernel->stats->totalTicks;
+    int ticks = now - request->arrived;
+
+    if (request->record == NULL) {		// the final flush
+	delete request;
+	finished->V();
+	return;
+    }
+    latency->Record(ticks);
+    switch (request->record->kind) {
+      case TraceRead:
+	readLatency->Record(ticks);
+	break;
+      case TraceWrite:
+	writeLatency->Record(ticks);
+	break;
+      default:
+	flushLatency->Record(ticks);
+    }
+    numSectors += request->record->numSectors;
+    delete request;
+
+    numSent--;
+    if (!waiting->IsEmpty())
+	Send(waiting->RemoveFront());
+    if (++numDone == numRecords) {
+	endTicks = now;
+	finished->V();
+    }
+}
+
+//----------------------------------------------------------------------
+// TraceReplay::Print
+// 	Report how long the replay took, and how long the requests took.
+//----------------------------------------------------------------------
+
+void
+TraceReplay::Print()
+{
+    cout << "Replay: " << numRecords << " requests, " << numSectors
+	 << " sectors, in " << endTicks - startTicks << " ticks (recorded in "
+	 << ((numRecords > 0) ? records[numRecords - 1].tick - records[0].tick : 0)
+	 << ")\n";
+    latency->Print();
+    readLatency->Print();
+    writeLatency->Print();
+    flushLatency->Print();
+}
@@ -0,0 +1,124 @@
+// disktrace.h
+//	Data structures to record the requests made of the disk in a
+//	"trace" file, and to replay a trace against a simulated disk.
+//
+//	With -trace, SynchDisk records every read, write and flush it is
+//	asked for: when, by which thread, which sectors, and for which
+//	file.  The sector numbers are those the file system asked for,
+//	before any striping or mirroring.
+//
+//	With -replay, the requests of a trace are sent straight to a
+//	scratch Disk -- no file system, no user programs -- each at the
+//	same time after the start as it was recorded.  Other flags choose
+//	the disk to replay on (-ncq, -wcache, -ssd), so that the same
+//	workload can be timed under each.  The report gives the total
+//	time, and the distribution of the time from when each request
+//	was made until it was done.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef DISKTRACE_H
+#define DISKTRACE_H
+
+#include "copyright.h"
+#include "disk.h"
+#include "stats.h"
+#include "synch.h"
+
+// A trace file starts with a magic number, followed by one record
+// per request, in the order they were made.
+
+const int TraceMagicNumber = 0x456789ad;
+const int TraceBufferSize = 256;	// records written out at a time
+
+enum TraceKind { TraceRead, TraceWrite, TraceFlush };
+
+class TraceRecord {
+  public:
+    int tick;				// When the request was made
+    int thread;				// ID of the thread that made it
+    int sector;				// First sector, or -1 for a flush
+    int origin;				// Header sector of the file it was
+					// for, or -1 if none
+    short numSectors;			// Sectors in the run; 0 for a flush
+    short kind;				// A TraceKind
+};
+
+// The following class records requests in a trace file.
+
+class DiskTrace {
+  public:
+    DiskTrace(char *name);		// Start a new trace in UNIX file
+					// "name"
+    ~DiskTrace();			// Write what is left, and close it
+
+    void Record(int sector, int numSectors, TraceKind kind);
+    					// Note a request made just now by
+					// the current thread
+
+  private:
+    int fileno;				// UNIX file number of the trace
+    TraceRecord buffer[TraceBufferSize];// Records not yet written
+    int numBuffered;			// How many
+
+    void Drain();			// Write out the buffered records
+};
+
+class TraceReplay;
+
+// A request of a trace, sent or waiting to be sent to the disk.
+
+class ReplayRequest : public CallBackObj {
+  public:
+    ReplayRequest(TraceReplay *replay, TraceRecord *record);
+
+    void CallBack();			// Called by the disk when done
+
+    TraceReplay *replay;		// Which replay it is part of
+    TraceRecord *record;		// What to send; NULL for the flush
+					// at the end of the replay
+    int arrived;			// When it was made
+};
+
+// The following class replays a trace against a disk.
+
+class TraceReplay : public CallBackObj {
+  public:
+    TraceReplay(char *name);		// Read the trace in UNIX file "name"
+    ~TraceReplay();			// Remove the scratch disk
+
+    void Run();				// Replay the trace, returning once
+					// every request is done
+    void Print();			// Report the timing
+
+    void CallBack();			// The next requests are made
+    void Done(ReplayRequest *request);	// "request" is done
+
+  private:
+    Disk *disk;				// The disk it is replayed on
+    char diskName[64];			// Its UNIX file
+    TraceRecord *records;		// The requests
+    int numRecords;			// How many
+    int next;				// The next to be made
+    int offset;				// Add to a recorded tick, to get
+					// the tick it is made at
+    List<ReplayRequest *> *waiting;	// Made, but the disk is full
+    int numSent;			// At the disk, not yet done
+    int numDone;			// Done
+    char *data;				// Scratch buffer for the sectors
+    Semaphore *finished;		// Signalled when all are done
+    int startTicks, endTicks;		// When the first was made, and the
+					// last was done
+    int numSectors;			// Sectors read and written
+
+    Histogram *latency;			// Made until done, for all requests
+    Histogram *readLatency;		// and for each kind
+    Histogram *writeLatency;
+    Histogram *flushLatency;
+
+    void Send(ReplayRequest *request);	// Send a request to the disk
+};
+
+#endif // DISKTRACE_H
@@ -25,6 +25,7 @@
 #include "copyright.h"
 
 #include "filehdr.h"
+#include "refcount.h"
 #include "debug.h"
 #include "synchdisk.h"
 #include "main.h"
@@ -40,6 +41,7 @@ FileHeader::FileHeader() //demo 2
 {
 	numBytes = -1;
 	numSectors = -1;
+	flags = 0;
 	memset(dataSectors, -1, sizeof(dataSectors));
 	nextFileHeader = NULL; 
     nextFileHeaderSector = -1;
@@ -64,50 +66,120 @@ FileHeader::~FileHeader() //demo 2
 //	Return FALSE if there are not enough free blocks to accomodate
 //	the new file.
 //
+//	The data sectors of each header are taken from a single run of
+//	free sectors if there is one, so that they can be transferred
+//	in one disk request.
+//
+//	The data sectors are cleared, unless "clear" is FALSE (the caller
+//	is about to overwrite all of them), or the file is compressed
+//	(its chunk index already says that nothing has been written).
+//
 //	"freeMap" is the bit map of free disk sectors
 //	"fileSize" is the bit map of free disk sectors
+//	"compressed" is whether the data is to be stored compressed
+//	"clear" is whether to fill the data sectors with zeros
 //----------------------------------------------------------------------
 
 int
-FileHeader::Allocate(PersistentBitmap *freeMap, int fileSize) //demo 2
+FileHeader::Allocate(PersistentBitmap *freeMap, int fileSize, bool compressed,
+			bool clear) //demo 2
 { 
-    if(fileSize <= (int)MaxFileSize) numBytes = fileSize;
-    else numBytes = (int)MaxFileSize;
+    flags = compressed ? FileCompressed : 0;
+    int maxSize = NumDirectSectors() * SectorSize;
+    if(fileSize <= maxSize) numBytes = fileSize;
+    else numBytes = maxSize;
     
     numSectors = divRoundUp(numBytes, SectorSize);
+    if(compressed) memset(ChunkIndex(), 0, ChunksPerHeader * sizeof(unsigned short));
     
     if(freeMap->Num() < numSectors) return 0;
     else{
+        int start = freeMap->FindRun(numSectors);
         for(int i=0; i<numSectors; i++){
-            dataSectors[i] = freeMap->FindAndSet();
-            char clean[SectorSize];   
-            for(int j=0 ; j<SectorSize; j++)clean[j] = 0;
-            kernel->synchDisk->WriteSector(dataSectors[i], clean);
+            if(start != -1){
+                dataSectors[i] = start + i;
+                freeMap->Mark(start + i);
+            }
+            else dataSectors[i] = freeMap->FindAndSet();
         }   
-        if(fileSize > (int)MaxFileSize){
+        if(clear && !compressed && numSectors > 0){
+            char *clean = new char[numSectors * SectorSize];
+            memset(clean, 0, numSectors * SectorSize);
+            for(int i=0, run; i<numSectors; i+=run){
+                for(run=1; i+run<numSectors && dataSectors[i+run]==dataSectors[i]+run; run++);
+                kernel->synchDisk->WriteSectors(dataSectors[i], clean, run);
+            }
+            delete [] clean;
+        }
+        if(fileSize > maxSize){
             nextFileHeaderSector = freeMap->FindAndSet();   
             nextFileHeader = new FileHeader;
-            return SectorSize + nextFileHeader->Allocate(freeMap, fileSize - (int)MaxFileSize);           
+            return SectorSize + nextFileHeader->Allocate(freeMap, fileSize - maxSize, compressed, clear);           
         }
     }
     return SectorSize;
 }
 
+//----------------------------------------------------------------------
+// FileHeader::Share
+// 	Initialize a fresh file header as a clone of "source": the new
+//	header points at the same data sectors, and each of them gets one
+//	more reference.  Only the header sectors of the clone are
+//	allocated, so the cost does not depend on the amount of data.
+//	Both headers are marked shared, so that later writes to either
+//	file copy a sector before changing it.
+//
+//	Return FALSE if there is not enough room for the clone's headers,
+//	or in the table of shared sectors; nothing is changed in that case.
+//
+//	"source" is the header of the file being cloned
+//	"freeMap" is the bit map of free disk sectors
+//	"refCounts" is the table of shared sectors
+//----------------------------------------------------------------------
+
+bool
+FileHeader::Share(FileHeader *source, PersistentBitmap *freeMap,
+			RefCountTable *refCounts)
+{
+    if (freeMap->NumClear() < source->NumHeaders() - 1
+		|| refCounts->NumFree() < divRoundUp(source->FileLength(), SectorSize))
+	return FALSE;
+
+    numBytes = source->numBytes;
+    numSectors = source->numSectors;
+    bcopy((char *) source->dataSectors, (char *) dataSectors, sizeof(dataSectors));
+    for (int i = 0; i < numSectors; i++)		// (and the chunk index)
+	refCounts->Increment(dataSectors[i]);
+    source->flags |= FileShared;
+    flags = source->flags;
+    if (source->nextFileHeader != NULL) {
+	nextFileHeaderSector = freeMap->FindAndSet();
+	nextFileHeader = new FileHeader;
+	nextFileHeader->Share(source->nextFileHeader, freeMap, refCounts);
+    }
+    return TRUE;
+}
+
 //----------------------------------------------------------------------
 // FileHeader::Deallocate
 // 	De-allocate all the space allocated for data blocks for this file.
+//	Sectors still shared with a clone only lose a reference.
 //
 //	"freeMap" is the bit map of free disk sectors
+//	"refCounts" is the table of shared sectors; only consulted if
+//		this file may share sectors, so may be NULL otherwise
 //----------------------------------------------------------------------
 
 void 
-FileHeader::Deallocate(PersistentBitmap *freeMap)
+FileHeader::Deallocate(PersistentBitmap *freeMap, RefCountTable *refCounts)
 {
     for (int i = 0; i < numSectors; i++) {
+	if (IsShared() && refCounts->Decrement((int) dataSectors[i]) > 0)
+	    continue;				// a clone still uses it
 	ASSERT(freeMap->Test((int) dataSectors[i]));  // ought to be marked!
 	freeMap->Clear((int) dataSectors[i]);
     }
-	if(nextFileHeader != NULL) nextFileHeader->Deallocate(freeMap);  //demo 2
+	if(nextFileHeader != NULL) nextFileHeader->Deallocate(freeMap, refCounts);  //demo 2
 }
 
 //----------------------------------------------------------------------
@@ -127,7 +199,8 @@ FileHeader::FetchFrom(int sector)//demo 2
     memcpy(&numBytes, buffer, sizeof(numBytes));
     memcpy(&numSectors, buffer + sizeof(numBytes), sizeof(numSectors));  
     memcpy(&nextFileHeaderSector, buffer + sizeof(numBytes) + sizeof(numSectors), sizeof(nextFileHeaderSector)); 
-    memcpy(dataSectors, buffer + sizeof(numBytes) + sizeof(numSectors) + sizeof(nextFileHeaderSector), NumDirect * sizeof(int));
+    memcpy(&flags, buffer + sizeof(numBytes) + sizeof(numSectors) + sizeof(nextFileHeaderSector), sizeof(flags));
+    memcpy(dataSectors, buffer + sizeof(numBytes) + sizeof(numSectors) + sizeof(nextFileHeaderSector) + sizeof(flags), NumDirect * sizeof(int));
 
     if(nextFileHeaderSector != -1){
        nextFileHeader = new FileHeader; 
@@ -155,7 +228,8 @@ FileHeader::WriteBack(int sector)//demo 2
     memcpy(buffer , &numBytes, sizeof(numBytes));
     memcpy(buffer + sizeof(numBytes), &numSectors, sizeof(numSectors)); 
     memcpy(buffer + sizeof(numBytes) + sizeof(numSectors), &nextFileHeaderSector, sizeof(nextFileHeaderSector)); 
-    memcpy(buffer + sizeof(numBytes) + sizeof(numSectors) + sizeof(nextFileHeaderSector), dataSectors, NumDirect*sizeof(int));
+    memcpy(buffer + sizeof(numBytes) + sizeof(numSectors) + sizeof(nextFileHeaderSector), &flags, sizeof(flags));
+    memcpy(buffer + sizeof(numBytes) + sizeof(numSectors) + sizeof(nextFileHeaderSector) + sizeof(flags), dataSectors, NumDirect*sizeof(int));
     kernel->synchDisk->WriteSector(sector, buffer);
 
     if(nextFileHeaderSector != -1) nextFileHeader->WriteBack(nextFileHeaderSector);
@@ -185,10 +259,65 @@ int
 FileHeader::ByteToSector(int offset)//demo 2
 {
     int sector = offset / SectorSize;
-    if (sector >= NumDirect) return nextFileHeader->ByteToSector(offset - (int)MaxFileSize);
+    if (sector >= NumDirectSectors()) return nextFileHeader->ByteToSector(offset - NumDirectSectors() * SectorSize);
     else return (dataSectors[sector]);
 }
 
+//----------------------------------------------------------------------
+// FileHeader::SetSector
+// 	Record that the data containing byte "offset" now lives in
+//	"sector".  Used when a shared sector is copied before a write.
+//	The caller must write the header back.
+//
+//	"offset" is the location within the file of a byte in the sector
+//	"sector" is the new disk sector holding that part of the file
+//----------------------------------------------------------------------
+
+void
+FileHeader::SetSector(int offset, int sector)
+{
+    int index = offset / SectorSize;
+    if (index >= NumDirectSectors()) nextFileHeader->SetSector(offset - NumDirectSectors() * SectorSize, sector);
+    else dataSectors[index] = sector;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::ChunkLength/SetChunkLength
+// 	Get or change the compressed length of chunk "chunk" of a
+//	compressed file: 0 if nothing was ever written to it, the full
+//	length of the chunk if it is stored uncompressed, and anything
+//	else if it is compressed.  The caller must write the header back
+//	after a change.
+//----------------------------------------------------------------------
+
+int
+FileHeader::ChunkLength(int chunk)
+{
+    ASSERT(IsCompressed());
+    if (chunk >= ChunksPerHeader) return nextFileHeader->ChunkLength(chunk - ChunksPerHeader);
+    return ChunkIndex()[chunk];
+}
+
+void
+FileHeader::SetChunkLength(int chunk, int length)
+{
+    ASSERT(IsCompressed());
+    if (chunk >= ChunksPerHeader) nextFileHeader->SetChunkLength(chunk - ChunksPerHeader, length);
+    else ChunkIndex()[chunk] = length;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::NumHeaders
+// 	Return the number of header sectors in this file's header chain.
+//----------------------------------------------------------------------
+
+int
+FileHeader::NumHeaders()
+{
+    if (nextFileHeader == NULL) return 1;
+    return 1 + nextFileHeader->NumHeaders();
+}
+
 //----------------------------------------------------------------------
 // FileHeader::FileLength
 // 	Return the number of bytes in the file.
@@ -217,6 +346,15 @@ FileHeader::Print()
     printf("FileHeader contents.  File size: %d.  File blocks:\n", numBytes);
     for (i = 0; i < numSectors; i++)
 	printf("%d ", dataSectors[i]);
+    if (IsCompressed()) {
+	printf("\nCompressed chunk lengths:\n");
+	for (i = 0; i < divRoundUp(numSectors, ChunkSectors); i++)
+	    printf("%d ", ChunkIndex()[i]);
+	printf("\n");
+	if (nextFileHeader != NULL) nextFileHeader->Print();
+	delete [] data;
+	return;
+    }
     printf("\nFile contents:\n");
     for (i = k = 0; i < numSectors; i++) {
 	kernel->synchDisk->ReadSector(dataSectors[i], data);
@@ -17,9 +17,27 @@
 #include "disk.h"
 #include "pbitmap.h"
 
-#define NumDirect 	((SectorSize - 3 * sizeof(int)) / sizeof(int))
+class RefCountTable;
+
+#define NumDirect 	((SectorSize - 4 * sizeof(int)) / sizeof(int))
 #define MaxFileSize 	(NumDirect * SectorSize)
 
+// Bits in FileHeader "flags"
+#define FileShared	0x1	// some data sectors may be shared with a
+				// clone, and must be copied before writing
+#define FileCompressed	0x2	// data is stored as compressed chunks
+
+// A compressed file is divided into chunks of ChunkSectors sectors,
+// each compressed on its own (see compress.h) and stored at the start
+// of the sectors reserved for it.  Its headers point at only ChunkDirect
+// data sectors; the rest of dataSectors holds the chunk index, the
+// compressed length of each chunk the header covers (0 for a chunk
+// never written, which reads as zeros).
+#define ChunkSectors	4
+#define ChunkSize	(ChunkSectors * SectorSize)
+#define ChunkDirect	24
+#define ChunksPerHeader	(ChunkDirect / ChunkSectors)
+
 // The following class defines the Nachos "file header" (in UNIX terms,  
 // the "i-node"), describing where on disk to find all of the data in the file.
 // The file header is organized as a simple table of pointers to
@@ -41,11 +59,22 @@ class FileHeader {
 	FileHeader(); // dummy constructor to keep valgrind happy
 	~FileHeader();
 	
-    int Allocate(PersistentBitmap *bitMap, int fileSize);// Initialize a file header, 
+    int Allocate(PersistentBitmap *bitMap, int fileSize, bool compressed,
+			bool clear);
+						// Initialize a file header, 
 						//  including allocating space 
 						//  on disk for the file data
-    void Deallocate(PersistentBitmap *bitMap);  // De-allocate this file's 
-						//  data blocks
+    void Deallocate(PersistentBitmap *bitMap, RefCountTable *refCounts);
+						// De-allocate this file's 
+						//  data blocks, except those
+						//  still shared with a clone
+    bool Share(FileHeader *source, PersistentBitmap *bitMap,
+				RefCountTable *refCounts);
+						// Initialize a file header as
+						//  a clone of "source",
+						//  pointing at the same data
+    int NumHeaders();				// Number of header sectors
+						//  in the chain
 
     void FetchFrom(int sectorNumber); 	// Initialize file header from disk
     void WriteBack(int sectorNumber); 	// Write modifications to file header
@@ -54,6 +83,16 @@ class FileHeader {
     int ByteToSector(int offset);	// Convert a byte offset into the file
 					// to the disk sector containing
 					// the byte
+    void SetSector(int offset, int sector);
+					// Move the data containing byte
+					// "offset" to a new disk sector
+
+    bool IsShared() { return (flags & FileShared) != 0; }
+					// Must writes check for sharing?
+    bool IsCompressed() { return (flags & FileCompressed) != 0; }
+					// Is the data stored in chunks?
+    int ChunkLength(int chunk);		// Compressed length of a chunk
+    void SetChunkLength(int chunk, int length);
 
     int FileLength();			// Return the length of the file 
 					// in bytes
@@ -81,8 +120,15 @@ class FileHeader {
 	
     int numBytes;			// Number of bytes in the file
     int numSectors;			// Number of data sectors in the file
+    int flags;				// FileShared, etc.
     int dataSectors[NumDirect];		// Disk sector numbers for each data 
 					// block in the file
+
+    int NumDirectSectors() { return IsCompressed() ? ChunkDirect : NumDirect; }
+					// How many data sectors fit in
+					// this header
+    unsigned short *ChunkIndex() { return (unsigned short *) &dataSectors[ChunkDirect]; }
+					// Chunk index of a compressed file
 };
 
 #endif // FILEHDR_H
@@ -28,9 +28,37 @@
 //	modified part of the directory and/or bitmap, we simply discard
 //	the changed version, without writing it back to disk.
 //
+//	Concurrent accesses are synchronized at a fine grain, so that
+//	one thread can use the file system while another waits on the disk:
+//	   each file has a reader/writer lock (see OpenFile), which makes
+//	     every ReadAt/WriteAt -- and so every directory fetch or
+//	     write back -- atomic
+//	   each directory has a lock, held by Create and Remove across
+//	     the fetch, modify, and write back of that directory only
+//	   the free sector bitmap has a lock, held the same way
+//	   the table of shared sectors has a lock, held the same way
+//	   the open file table has a lock
+//	Locks are always taken in the order: directory, the file being
+//	cloned or written, bitmap, shared sectors, and last the files
+//	holding the directories, bitmap and shared sector table.
+//
+//	If the disk has a write cache, the sectors written by one
+//	operation can reach the media in any order.  So a flush (see
+//	SynchDisk::Flush) is used as a barrier wherever a crash in
+//	between could leave a pointer to something not yet written: a
+//	file header, and the free map (and shared sector counts) marking
+//	its sectors in use, are on the media before the directory entry
+//	naming it, and a directory entry is gone before the sectors it
+//	named are freed.
+//
+//	Files can be cloned: the clone gets its own header, but points at
+//	the same data sectors as the original.  A table of reference counts
+//	(itself kept in a file, whose header is in sector 2) records which
+//	sectors are shared; writing to a shared sector first moves it to a
+//	private copy (see OpenFile::WriteAt).
+//
 // 	Our implementation at this point has the following restrictions:
 //
-//	   there is no synchronization for concurrent accesses
 //	   files have a fixed size, set when the file is created
 //	   files cannot be bigger than about 3KB in size
 //	   there is no hierarchical directory structure, and only a limited
@@ -50,7 +78,13 @@
 #include "pbitmap.h"
 #include "directory.h"
 #include "filehdr.h"
+#include "refcount.h"
+#include "compress.h"
 #include "filesys.h"
+#include "synch.h"
+#include "synchdisk.h"
+#include "filetable.h"
+#include "main.h"
 
 //----------------------------------------------------------------------
 // FileSystem::FileSystem
@@ -67,14 +101,19 @@
 
 FileSystem::FileSystem(bool format)
 { 
-    num_openfile = 0;
-    for (int i = 0; i < MAXFILENUM; i++) fileDescriptorTable[i] = NULL;
+    freeMapLock = new Lock("free map");
+    dirLocks = new FileLockTable("directory lock");
+    refCountLock = new Lock("shared sectors");
+    refCountFile = NULL;
+    refCounts = NULL;
+    chunkCache = new ChunkCache(NumCachedChunks);
     DEBUG(dbgFile, "Initializing the file system.");
     if (format) {
         PersistentBitmap *freeMap = new PersistentBitmap(NumSectors);
         Directory *directory = new Directory(NumDirEntries);
 		FileHeader *mapHdr = new FileHeader;
 		FileHeader *dirHdr = new FileHeader;
+		FileHeader *refHdr = new FileHeader;
 
         DEBUG(dbgFile, "Formatting the file system.");
 
@@ -82,12 +121,14 @@ FileSystem::FileSystem(bool format)
 		// (make sure no one else grabs these!)
 		freeMap->Mark(FreeMapSector);	    
 		freeMap->Mark(DirectorySector);
+		freeMap->Mark(RefCountSector);
 
 		// Second, allocate space for the data blocks containing the contents
 		// of the directory and bitmap files.  There better be enough space!
 
-		ASSERT(mapHdr->Allocate(freeMap, FreeMapFileSize));
-		ASSERT(dirHdr->Allocate(freeMap, DirectoryFileSize));
+		ASSERT(mapHdr->Allocate(freeMap, FreeMapFileSize, FALSE, TRUE));
+		ASSERT(dirHdr->Allocate(freeMap, DirectoryFileSize, FALSE, TRUE));
+		ASSERT(refHdr->Allocate(freeMap, RefCountFileSize, FALSE, TRUE));
 
 		// Flush the bitmap and directory FileHeaders back to disk
 		// We need to do this before we can "Open" the file, since open
@@ -97,6 +138,7 @@ FileSystem::FileSystem(bool format)
         DEBUG(dbgFile, "Writing headers back to disk.");
 		mapHdr->WriteBack(FreeMapSector);    
 		dirHdr->WriteBack(DirectorySector);
+		refHdr->WriteBack(RefCountSector);
 
 		// OK to open the bitmap and directory files now
 		// The file system operations assume these two files are left open
@@ -104,6 +146,8 @@ FileSystem::FileSystem(bool format)
 
         freeMapFile = new OpenFile(FreeMapSector);
         directoryFile = new OpenFile(DirectorySector);
+        refCountFile = new OpenFile(RefCountSector);
+        refCounts = new RefCountTable(MaxSharedSectors);
      
 		// Once we have the files "open", we can write the initial version
 		// of each file back to disk.  The directory at this point is completely
@@ -114,6 +158,7 @@ FileSystem::FileSystem(bool format)
         DEBUG(dbgFile, "Writing bitmap and directory back to disk.");
 		freeMap->WriteBack(freeMapFile);	 // flush changes to disk
 		directory->WriteBack(directoryFile);
+		refCounts->WriteBack(refCountFile);
 
 		if (debug->IsEnabled('f')) {
 			freeMap->Print();
@@ -123,6 +168,7 @@ FileSystem::FileSystem(bool format)
 		delete directory; 
 		delete mapHdr; 
 		delete dirHdr;
+		delete refHdr;
     } else {
 		// if we are not formatting the disk, just open the files representing
 		// the bitmap and directory; these are left open while Nachos is running
@@ -139,6 +185,12 @@ FileSystem::~FileSystem()
 {
 	delete freeMapFile;
 	delete directoryFile;
+	if (refCountFile != NULL) delete refCountFile;
+	if (refCounts != NULL) delete refCounts;
+	delete refCountLock;
+	delete chunkCache;
+	delete dirLocks;
+	delete freeMapLock;
 }
 
 //----------------------------------------------------------------------
@@ -163,22 +215,28 @@ FileSystem::~FileSystem()
 //	 	no free entry for file in directory
 //	 	no free space for data blocks for the file 
 //
-// 	Note that this implementation assumes there is no concurrent access
-//	to the file system!
+//	The parent directory stays locked from the check that the name is
+//	free until the new entry has been written back.
 //
 //	"name" -- name of file to be created
 //	"initialSize" -- size of file to be created
+//	"flags" -- CreateCompressed and/or CreateUncleared (see filesys.h)
 //----------------------------------------------------------------------
 
 bool
-FileSystem::Create(char *path, int initialSize, bool Dir) 
+FileSystem::Create(char *path, int initialSize, bool Dir, int flags) 
 {
     Directory *directory;
     PersistentBitmap *freeMap;
     FileHeader *hdr;
+    RWLock *dirLock;
     int sector;
     bool success;
-    if (Dir == TRUE) initialSize = DirectoryFileSize;//demo
+    if (Dir == TRUE)
+    {
+        initialSize = DirectoryFileSize;//demo
+        flags = 0;
+    }
     DEBUG(dbgFile, "Creating file " << path << " size " << initialSize);
 
     directory = new Directory(NumDirEntries); 
@@ -190,11 +248,14 @@ FileSystem::Create(char *path, int initialSize, bool Dir)
         delete directory;
         return FALSE;
     }
+    dirLock = dirLocks->Get(current_dirfile->HeaderSector());
+    dirLock->AcquireWrite();
     directory->FetchFrom(current_dirfile);
 
     if (directory->Find(targetPath) != -1) success = FALSE; // file is already in directory
     else
     {
+        freeMapLock->Acquire();
         freeMap = new PersistentBitmap(freeMapFile, NumSectors);
         sector = freeMap->FindAndSet(); // find a sector to hold the file header
         if (sector == -1) success = FALSE; // no free block for file header
@@ -202,21 +263,27 @@ FileSystem::Create(char *path, int initialSize, bool Dir)
         else
         {
             hdr = new FileHeader;
-            int totalheadersize = hdr->Allocate(freeMap, initialSize); //demo 3(int)
+            int totalheadersize = hdr->Allocate(freeMap, initialSize,
+                                    (flags & CreateCompressed) != 0,
+                                    (flags & CreateUncleared) == 0); //demo 3(int)
             if (totalheadersize == 0) success = FALSE; // no space on disk for data
             else
             {
                 success = TRUE;
                 // everthing worked, flush all changes back to disk
                 hdr->WriteBack(sector);
-                directory->WriteBack(current_dirfile);
                 freeMap->WriteBack(freeMapFile);
+                kernel->synchDisk->Flush();  // header and map before its name
+                directory->WriteBack(current_dirfile);
                 printf ("Total header's size:  %d bytes\n", totalheadersize);
             }
             delete hdr;
         }
         delete freeMap;
+        freeMapLock->Release();
     }
+    dirLock->ReleaseWrite();
+    dirLocks->Put(current_dirfile->HeaderSector());
 
     if (current_dirfile != directoryFile) delete current_dirfile;
     delete directory;
@@ -229,13 +296,13 @@ FileSystem::Create(char *path, int initialSize, bool Dir)
 //	To open a file:
 //	  Find the location of the file's header, using the directory 
 //	  Bring the header into memory
+//	  Give it a descriptor in the current thread's open file table
 //
 //	"name" -- the text name of the file to be opened
 //----------------------------------------------------------------------
 
 std::pair<OpenFile *, OpenFileId> FileSystem::Open(char *path) //demo 3
 {    
-    if (num_openfile == MAXFILENUM) return make_pair((OpenFile *)NULL, -1);
     Directory *directory = new Directory(NumDirEntries);
     OpenFile *openFile = NULL;
     int sector;
@@ -261,21 +328,392 @@ std::pair<OpenFile *, OpenFileId> FileSystem::Open(char *path) //demo 3
         return make_pair((OpenFile *)NULL, -1);
     }
 
-    for (int i = 1; i <= MAXFILENUM; i++)
+    delete directory;
+    if (current_dirfile != directoryFile) delete current_dirfile;
+
+    OpenFileId id = kernel->currentThread->files->Add(openFile);
+    if (id == -1)
+    {
+        delete openFile;
+        return make_pair((OpenFile *)NULL, -1);  // too many files open
+    }
+    return make_pair((OpenFile *)openFile, id);
+}
+
+//----------------------------------------------------------------------
+// FileSystem::Close
+// 	Give back a descriptor returned by Open.  The file is closed once
+//	no descriptor of the current thread refers to it any more.
+//	Return 1 on success, -1 if "id" is not an open file.
+//
+//	"id" -- the descriptor to be released
+//----------------------------------------------------------------------
+
+int
+FileSystem::Close(OpenFileId id)
+{
+    return kernel->currentThread->files->Remove(id);
+}
+
+//----------------------------------------------------------------------
+// FileSystem::Clone
+// 	Make the file "to" a copy of the file "from", without copying any
+//	data: the new file gets its own header (chain), pointing at the
+//	same data sectors, and each of those sectors gets one more reference.
+//	Either file can then be written, or removed, without affecting the
+//	other; see OpenFile::WriteAt and FileHeader::Deallocate.
+//
+//	Return TRUE if everything goes ok, otherwise, return FALSE.
+//
+// 	Clone fails if:
+//   		"from" does not exist, or is a directory
+//   		"to" is already in its directory
+//	 	no free space for the new file headers
+//	 	no free entry for "to" in its directory
+//	 	too many sectors are shared already
+//
+//	"from" -- name of the file to be cloned
+//	"to" -- name of the new file
+//----------------------------------------------------------------------
+
+bool
+FileSystem::Clone(char *from, char *to)
+{
+    Directory *directory;
+    PersistentBitmap *freeMap;
+    FileHeader *hdr;
+    OpenFile *source;
+    RWLock *dirLock;
+    int sector;
+    bool success;
+
+    DEBUG(dbgFile, "Cloning file " << from << " to " << to);
+    directory = new Directory(NumDirEntries);
+    char targetPath[500];
+    strcpy(targetPath, from);
+    OpenFile *current_dirfile = findsubdirectory(targetPath);
+    if (current_dirfile == NULL)
+    {
+        delete directory;
+        return FALSE;
+    }
+    directory->FetchFrom(current_dirfile);
+    sector = directory->Find(targetPath);
+    if (current_dirfile != directoryFile) delete current_dirfile;
+    if (sector == -1 || directory->IsDir(targetPath) == TRUE)
+    {
+        delete directory;
+        return FALSE; // nothing to clone
+    }
+    source = new OpenFile(sector);
+
+    strcpy(targetPath, to);
+    current_dirfile = findsubdirectory(targetPath);
+    if (current_dirfile == NULL)
+    {
+        delete source;
+        delete directory;
+        return FALSE;
+    }
+    dirLock = dirLocks->Get(current_dirfile->HeaderSector());
+    dirLock->AcquireWrite();
+    directory->FetchFrom(current_dirfile);
+
+    if (directory->Find(targetPath) != -1) success = FALSE; // file is already in directory
+    else
     {
-        if (fileDescriptorTable[i] == NULL)
+        source->LockHeader();
+        freeMapLock->Acquire();
+        freeMap = new PersistentBitmap(freeMapFile, NumSectors);
+        refCountLock->Acquire();
+        LoadRefCounts();
+        sector = freeMap->FindAndSet(); // find a sector to hold the file header
+        if (sector == -1) success = FALSE; // no free block for file header
+        else if (!directory->Add(targetPath, sector, FALSE)) success = FALSE; // no space in directory
+        else
         {
-            num_openfile++;
-            fileDescriptorTable[i] = openFile;
-            delete directory;
-            if (current_dirfile != directoryFile) delete current_dirfile;
-            return make_pair((OpenFile *)openFile, i);
+            hdr = new FileHeader;
+            if (!hdr->Share(source->Header(), freeMap, refCounts)) success = FALSE;
+            else
+            {
+                success = TRUE;
+                // everthing worked, flush all changes back to disk
+                source->Header()->WriteBack(source->HeaderSector());
+                hdr->WriteBack(sector);
+                refCounts->WriteBack(refCountFile);
+                freeMap->WriteBack(freeMapFile);
+                kernel->synchDisk->Flush();  // header and maps before its name
+                directory->WriteBack(current_dirfile);
+            }
+            delete hdr;
         }
+        refCountLock->Release();
+        delete freeMap;
+        freeMapLock->Release();
+        source->UnlockHeader();
     }
+    dirLock->ReleaseWrite();
+    dirLocks->Put(current_dirfile->HeaderSector());
 
-    delete directory;
     if (current_dirfile != directoryFile) delete current_dirfile;
-    return make_pair((OpenFile *)NULL, -1); // return NULL if not found
+    delete source;
+    delete directory;
+    return success;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::CopyOnWrite
+// 	Called before a file that may share data with a clone is written.
+//	Each sector in "sectors" that is still shared is replaced by a
+//	newly allocated sector, and loses one reference.  The caller is
+//	responsible for writing the data to the new sectors.
+//
+//	Return the number of sectors replaced, or -1 (changing nothing)
+//	if there is no room on the disk for the copies.
+//
+//	"sectors" -- the data sectors about to be written
+//	"numSectors" -- how many there are
+//----------------------------------------------------------------------
+
+int
+FileSystem::CopyOnWrite(int *sectors, int numSectors)
+{
+    PersistentBitmap *freeMap;
+    int i, needed = 0;
+
+    freeMapLock->Acquire();
+    refCountLock->Acquire();
+    LoadRefCounts();
+    for (i = 0; i < numSectors; i++)
+        if (refCounts->Count(sectors[i]) > 1) needed++;
+    if (needed == 0)
+    {
+        refCountLock->Release();
+        freeMapLock->Release();
+        return 0;
+    }
+
+    freeMap = new PersistentBitmap(freeMapFile, NumSectors);
+    if (freeMap->NumClear() < needed) needed = -1; // no room for the copies
+    else
+    {
+        for (i = 0; i < numSectors; i++)
+        {
+            if (refCounts->Count(sectors[i]) > 1)
+            {
+                refCounts->Decrement(sectors[i]);
+                sectors[i] = freeMap->FindAndSet();
+            }
+        }
+        refCounts->WriteBack(refCountFile);
+        freeMap->WriteBack(freeMapFile);
+    }
+    delete freeMap;
+    refCountLock->Release();
+    freeMapLock->Release();
+    return needed;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::LoadRefCounts
+// 	Bring the table of shared sectors into memory, the first time it
+//	is needed.  It then stays in memory until Nachos halts, since
+//	every change to it goes through this file system.
+//
+//	The caller holds refCountLock.
+//----------------------------------------------------------------------
+
+void
+FileSystem::LoadRefCounts()
+{
+    if (refCounts != NULL) return;
+    refCountFile = new OpenFile(RefCountSector);
+    refCounts = new RefCountTable(MaxSharedSectors);
+    refCounts->FetchFrom(refCountFile);
+}
+
+//----------------------------------------------------------------------
+// FileSystem::Defragment
+// 	Walk every directory, moving the data of each file whose sectors
+//	are scattered into a single run of consecutive free sectors, when
+//	the disk model says that reading the file would then be faster.
+//	Prints the read time saved for each file moved, and in total: as
+//	expected from the sector maps (Disk::EstimateLatency), and as
+//	achieved, timing a read of the file before and after the move.
+//
+//	Only data sectors are moved; file headers stay where they are.
+//	Files sharing data with a clone are skipped, since the clone
+//	points at the same sectors.
+//
+//	Meant to run in a kernel thread of its own (Kernel::Defragment),
+//	which gives up the CPU after each file.
+//----------------------------------------------------------------------
+
+void
+FileSystem::Defragment()
+{
+    int expected = 0, achieved = 0, moved;
+
+    moved = DefragmentDirectory(directoryFile, "", &expected, &achieved);
+    printf("defrag: %d files moved, read time saved: expected %d ticks, achieved %d ticks\n",
+	   moved, expected, achieved);
+}
+
+//----------------------------------------------------------------------
+// FileSystem::DefragmentDirectory
+// 	Defragment every file in the directory stored in "dirFile", and
+//	in the directories below it.  Return the number of files moved.
+//
+//	The directory is read-locked while each of its files is moved,
+//	so the file can't be removed meanwhile.
+//
+//	"dirFile" -- the open directory
+//	"path" -- its name, used in the report
+//	"expected", "achieved" -- totals of the time saved, in ticks
+//----------------------------------------------------------------------
+
+int
+FileSystem::DefragmentDirectory(OpenFile *dirFile, char *path,
+				int *expected, int *achieved)
+{
+    Directory *directory = new Directory(NumDirEntries);
+    DirectoryEntry *table = directory->gettable();
+    RWLock *dirLock = dirLocks->Get(dirFile->HeaderSector());
+    char name[500];
+    int moved = 0;
+
+    dirLock->AcquireRead();
+    directory->FetchFrom(dirFile);
+    dirLock->ReleaseRead();
+
+    for (int i = 0; i < directory->gettablesize(); i++)
+    {
+        if (table[i].inUse == FALSE) continue;
+        int sector = table[i].sector;
+        sprintf(name, "%s/%s", path, table[i].name);
+        if (table[i].Dir == TRUE)
+        {
+            OpenFile *subdirfile = new OpenFile(sector);
+            moved += DefragmentDirectory(subdirfile, name, expected, achieved);
+            delete subdirfile;
+            continue;
+        }
+        dirLock->AcquireRead();
+        directory->FetchFrom(dirFile);  // may have changed meanwhile
+        if (table[i].inUse == TRUE && table[i].sector == sector
+            && DefragmentFile(name, sector, expected, achieved))
+            moved++;
+        dirLock->ReleaseRead();
+        kernel->currentThread->Yield();  // let others use the disk
+    }
+
+    dirLocks->Put(dirFile->HeaderSector());
+    delete directory;
+    return moved;
+}
+
+//----------------------------------------------------------------------
+// FileSystem::DefragmentFile
+// 	Move the data of the file whose header is in "sector" to the first
+//	run of free sectors long enough to hold it, if its data is not
+//	already contiguous and the move makes reading it faster.  Return
+//	TRUE if the file was moved.
+//
+//	The steps are ordered so that a crash at any point leaves the
+//	file intact, at worst leaking the sectors of one of the copies:
+//	the data is copied, the new sectors are marked in use on disk,
+//	the header is switched over (the point at which the file moves),
+//	and then the old sectors are freed.
+//
+//	"path" -- the name of the file, used in the report
+//	"sector" -- the location of the file header
+//	"expected", "achieved" -- totals of the time saved, in ticks
+//----------------------------------------------------------------------
+
+bool
+FileSystem::DefragmentFile(char *path, int sector,
+			   int *expected, int *achieved)
+{
+    OpenFile *file = new OpenFile(sector);
+    FileHeader *hdr;
+    PersistentBitmap *freeMap;
+    char *data;
+    int *oldSectors, *newSectors;
+    int numSectors, start, estBefore, estAfter, before, after, i;
+    bool moved = FALSE;
+
+    file->LockHeader();  // nobody reads or writes the file while it moves
+    hdr = file->Header();
+    numSectors = divRoundUp(hdr->FileLength(), SectorSize);
+    if (hdr->IsShared() || numSectors < 2)
+    {
+        file->UnlockHeader();
+        delete file;
+        return FALSE;
+    }
+
+    oldSectors = new int[numSectors];
+    newSectors = new int[numSectors];
+    for (i = 0; i < numSectors; i++)
+        oldSectors[i] = hdr->ByteToSector(i * SectorSize);
+    for (i = 1; i < numSectors; i++)
+        if (oldSectors[i] != oldSectors[i - 1] + 1) break;
+
+    if (i < numSectors)  // not contiguous
+    {
+        freeMapLock->Acquire();
+        freeMap = new PersistentBitmap(freeMapFile, NumSectors);
+        start = freeMap->FindRun(numSectors);
+        if (start != -1)
+        {
+            for (i = 0; i < numSectors; i++)
+                newSectors[i] = start + i;
+            estBefore = kernel->synchDisk->EstimateLatency(oldSectors, numSectors);
+            estAfter = kernel->synchDisk->EstimateLatency(newSectors, numSectors);
+            moved = (estAfter < estBefore);
+        }
+        if (moved)
+        {
+            data = new char[numSectors * SectorSize];
+            before = kernel->stats->totalTicks;
+            for (i = 0; i < numSectors; i++)
+                kernel->synchDisk->ReadSector(oldSectors[i], data + i * SectorSize);
+            before = kernel->stats->totalTicks - before;
+            for (i = 0; i < numSectors; i++)
+                kernel->synchDisk->WriteSector(newSectors[i], data + i * SectorSize);
+
+            for (i = 0; i < numSectors; i++)
+                freeMap->Mark(newSectors[i]);
+            freeMap->WriteBack(freeMapFile);
+            kernel->synchDisk->Flush();  // data and map before the header
+            for (i = 0; i < numSectors; i++)
+                hdr->SetSector(i * SectorSize, newSectors[i]);
+            hdr->WriteBack(sector);
+            kernel->synchDisk->Flush();  // header before freeing old sectors
+            for (i = 0; i < numSectors; i++)
+                freeMap->Clear(oldSectors[i]);
+            freeMap->WriteBack(freeMapFile);
+
+            after = kernel->stats->totalTicks;
+            for (i = 0; i < numSectors; i++)
+                kernel->synchDisk->ReadSector(newSectors[i], data + i * SectorSize);
+            after = kernel->stats->totalTicks - after;
+            delete [] data;
+
+            printf("defrag: %s, %d sectors moved to %d, read time: expected %d -> %d ticks, achieved %d -> %d ticks\n",
+                   path, numSectors, start, estBefore, estAfter, before, after);
+            *expected += estBefore - estAfter;
+            *achieved += before - after;
+        }
+        delete freeMap;
+        freeMapLock->Release();
+    }
+
+    file->UnlockHeader();
+    delete [] oldSectors;
+    delete [] newSectors;
+    delete file;
+    return moved;
 }
 
 //----------------------------------------------------------------------
@@ -289,6 +727,11 @@ std::pair<OpenFile *, OpenFileId> FileSystem::Open(char *path) //demo 3
 //	Return TRUE if the file was deleted, FALSE if the file wasn't
 //	in the file system.
 //
+//	The contents of a directory are removed before its parent is
+//	locked, since removing them locks the directory being emptied.
+//	The directory is written back before the bitmap, so that a freed
+//	header sector can't be handed out while a name still points at it.
+//
 //	"name" -- the text name of the file to be removed
 //----------------------------------------------------------------------
 
@@ -298,6 +741,7 @@ FileSystem::Remove(bool recursive, char *path)
     Directory *directory;
     PersistentBitmap *freeMap;
     FileHeader *fileHdr;
+    RWLock *dirLock;
     int sector;
     
     directory = new Directory(NumDirEntries);
@@ -340,19 +784,47 @@ FileSystem::Remove(bool recursive, char *path)
         delete subdirfile;
     }
 
+    dirLock = dirLocks->Get(current_dirfile->HeaderSector());
+    dirLock->AcquireWrite();
+    directory->FetchFrom(current_dirfile);  // may have changed meanwhile
+    if (directory->Find(targetPath) != sector)
+    {
+        dirLock->ReleaseWrite();
+        dirLocks->Put(current_dirfile->HeaderSector());
+        delete directory;
+        if (current_dirfile != directoryFile) delete current_dirfile;
+        return FALSE; // someone else removed it first
+    }
+
     printf("remove: %s\n",targetPath);
 
     fileHdr = new FileHeader;
     fileHdr->FetchFrom(sector);
 
+    freeMapLock->Acquire();
     freeMap = new PersistentBitmap(freeMapFile, NumSectors);
+    if (fileHdr->IsShared())
+    {
+        refCountLock->Acquire();
+        LoadRefCounts();
+    }
 
-    fileHdr->Deallocate(freeMap); // remove data blocks
+    fileHdr->Deallocate(freeMap, refCounts); // remove data blocks
     freeMap->Clear(sector);       // remove header block
     directory->Remove(targetPath);
+    if (fileHdr->IsCompressed()) chunkCache->Invalidate(sector);
 
-    freeMap->WriteBack(freeMapFile);  // flush to disk
     directory->WriteBack(current_dirfile); // flush to disk
+    kernel->synchDisk->Flush();   // name gone before its sectors are freed
+    if (fileHdr->IsShared())
+    {
+        refCounts->WriteBack(refCountFile);
+        refCountLock->Release();
+    }
+    freeMap->WriteBack(freeMapFile);  // flush to disk
+    freeMapLock->Release();
+    dirLock->ReleaseWrite();
+    dirLocks->Put(current_dirfile->HeaderSector());
     if (current_dirfile != directoryFile) delete current_dirfile;
     delete fileHdr;
     delete directory;
@@ -417,9 +889,12 @@ FileSystem::Print()
 {
     FileHeader *bitHdr = new FileHeader;
     FileHeader *dirHdr = new FileHeader;
-    PersistentBitmap *freeMap = new PersistentBitmap(freeMapFile,NumSectors);
     Directory *directory = new Directory(NumDirEntries);
 
+    freeMapLock->Acquire();
+    PersistentBitmap *freeMap = new PersistentBitmap(freeMapFile,NumSectors);
+    freeMapLock->Release();
+
     printf("Bit map file header:\n");
     bitHdr->FetchFrom(FreeMapSector);
     bitHdr->Print();
@@ -36,7 +36,10 @@
 #include "copyright.h"
 #include "sysdep.h"
 #include "openfile.h"
-#define MAXFILENUM 500
+#define MAXFILENUM 500		// most files one thread can have open
+
+class RefCountTable;
+class ChunkCache;
 typedef int OpenFileId;
 
 // Sectors containing the file headers for the bitmap of free sectors,
@@ -44,6 +47,7 @@ typedef int OpenFileId;
 // sectors, so that they can be located on boot-up.
 #define FreeMapSector 		0
 #define DirectorySector 	1
+#define RefCountSector		2
 
 // Initial file sizes for the bitmap and directory; until the file system
 // supports extensible files, the directory size sets the maximum number 
@@ -52,6 +56,19 @@ typedef int OpenFileId;
 #define NumDirEntries 		64  //demo3
 #define DirectoryFileSize 	(sizeof(DirectoryEntry) * NumDirEntries)
 
+// The table of data sectors shared between cloned files has a fixed
+// size, which bounds how much data can be shared at once.
+#define MaxSharedSectors	(NumSectors / 16)
+#define RefCountFileSize	(sizeof(int) + sizeof(RefCountEntry) * MaxSharedSectors)
+
+// Options for FileSystem::Create
+#define CreateCompressed	0x1	// store the data compressed
+#define CreateUncleared		0x2	// don't clear the data sectors; the
+					// caller will overwrite all of them
+
+// Number of decompressed chunks of compressed files kept in memory
+#define NumCachedChunks		32
+
 #ifdef FILESYS_STUB 		// Temporarily implement file system calls as 
 				// calls to UNIX, until the real file system
 				// implementation is available
@@ -92,7 +109,7 @@ class FileSystem {
 	// MP4 mod tag
 	~FileSystem();
 
-    bool Create(char *path, int initialSize, bool Dir);  //demo 3
+    bool Create(char *path, int initialSize, bool Dir, int flags);  //demo 3
 					// Create a file (UNIX creat)
 
     std::pair<OpenFile*,OpenFileId> Open(char *path); //demo 3
@@ -102,14 +119,39 @@ class FileSystem {
     void List(bool recursive, char *path);			// List all the files in the file system
 
     void Print();			// List all the files and their contents
+    int Close(OpenFileId id);		// Release a descriptor handed out
+					// by Open, and close the file
+
+    bool Clone(char *from, char *to);	// Make "to" a copy-on-write copy
+					// of the file "from"
+    int CopyOnWrite(int *sectors, int numSectors);
+					// Replace the shared sectors in
+					// "sectors" by private copies
+    void Defragment();			// Move the data of scattered files
+					// into runs of consecutive sectors
+
 	OpenFile* findsubdirectory(char* path); //demo 3
-	OpenFile* fileDescriptorTable[MAXFILENUM]; //demo 3
-	int num_openfile; //demo 3
+	ChunkCache *chunkCache;		// Recently used chunks of
+					// compressed files
   private:
    OpenFile* freeMapFile;		// Bit map of free disk blocks,
 					// represented as a file
    OpenFile* directoryFile;		// "Root" directory -- list of 
 					// file names, represented as a file
+   Lock *freeMapLock;			// Held across each read-modify-write
+					// of the free sector bitmap
+   FileLockTable *dirLocks;		// One lock per directory, held while
+					// adding or removing its entries
+   OpenFile* refCountFile;		// Table of shared sectors, opened
+   RefCountTable *refCounts;		// and read in the first time a
+					// clone is made or written
+   Lock *refCountLock;			// Protects refCounts
+
+   void LoadRefCounts();		// Make sure refCounts is in memory
+   int DefragmentDirectory(OpenFile *dirFile, char *path,
+			int *expected, int *achieved);
+   bool DefragmentFile(char *path, int sector,
+			int *expected, int *achieved);
 };
 
 #endif // FILESYS
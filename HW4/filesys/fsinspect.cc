@@ -0,0 +1,923 @@
+// fsinspect.cc
+//	A host program to look inside a Nachos disk image (DISK_0) without
+//	running Nachos.
+//
+//	Booting the kernel to run -l or -D starts the timer, console and
+//	scheduler, and makes every sector read wait for the simulated disk.
+//	Instead, this program maps the image file into memory, and reads
+//	the free map, file headers and directories straight out of it,
+//	using the on-disk formats of FileHeader::WriteBack and
+//	Directory::WriteBack.
+//
+//	Usage: fsinspect [-j threads] <disk image> <command> [path]
+//
+//	    ls <dir>	 list a directory
+//	    lsr <dir>	 list a directory and everything below it
+//	    cat <file>	 copy a file to standard output
+//	    stat <file>	 describe a file's headers and data sectors
+//	    frag	 report how fragmented the files and free space are
+//	    df		 count used and free sectors
+//	    fsck [repair] check the free map against the files, and
+//			 with "repair", fix it (see Fsck below)
+//
+//	frag, df and fsck split their work among host threads (by default,
+//	one per processor; -j sets the number), so that big images are
+//	scanned in parallel.  The image is never trusted: out of range
+//	sectors and header chains that loop are reported, not followed.
+//	Only "fsck repair" ever writes to the image.
+//
+//	This file is not part of Nachos; build it with "make fsinspect".
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "disk.h"
+#include "filehdr.h"
+#include "directory.h"
+#include "filesys.h"
+#include "refcount.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// A file header as it is laid out in its sector; see FileHeader::WriteBack.
+
+class DiskHeader {
+  public:
+    int numBytes;			// Bytes described by this header
+    int numSectors;			// Data sectors in this header
+    int nextSector;			// Next header of the file, or -1
+    int flags;				// FileShared, FileCompressed
+    int dataSectors[NumDirect];
+};
+
+// Fails to compile if the layout above does not fill exactly one sector.
+typedef char DiskHeaderFitsSector[(sizeof(DiskHeader) == SectorSize) ? 1 : -1];
+
+// What "frag" and "stat" learn about one file.
+
+class FileInfo {
+  public:
+    char *path;				// Full name, eg. "/t0/f1"
+    int hdrSector;			// Its first header
+    int length;				// Bytes
+    int numHeaders;			// Header sectors in the chain
+    int numSectors;			// Data sectors
+    int extents;			// Runs of consecutive data sectors
+    int flags;				// Of the first header
+    bool bad;				// Chain or sectors out of range
+};
+
+static char *image;			// The image, mapped into memory
+static int numThreads;			// Host threads for frag and df
+static unsigned int *visited;		// Directory headers ls and frag
+					// have read, one bit per sector
+
+//----------------------------------------------------------------------
+// ValidSector, Sector, Header
+// 	Find sector "sector" of the image, as raw bytes or as a header.
+//----------------------------------------------------------------------
+
+static bool
+ValidSector(int sector)
+{
+    return sector >= 0 && sector < NumSectors;
+}
+
+static char *
+Sector(int sector)
+{
+    return image + MagicSize + sector * SectorSize;
+}
+
+static DiskHeader *
+Header(int sector)
+{
+    return (DiskHeader *) Sector(sector);
+}
+
+//----------------------------------------------------------------------
+// NumDataSectors
+// 	How many of a header's dataSectors point at data: a compressed
+//	file keeps its chunk index in the rest.
+//----------------------------------------------------------------------
+
+static int
+NumDataSectors(DiskHeader *hdr)
+{
+    int max = (hdr->flags & FileCompressed) ? ChunkDirect : NumDirect;
+
+    return (hdr->numSectors < 0 || hdr->numSectors > max) ? -1 : hdr->numSectors;
+}
+
+//----------------------------------------------------------------------
+// Describe
+// 	Walk the header chain starting at "sector", filling in "info".
+//	Chains longer than the disk (which must loop) are cut off.
+//----------------------------------------------------------------------
+
+static void
+Describe(int sector, FileInfo *info)
+{
+    int last = -2, count;
+
+    info->hdrSector = sector;
+    info->length = info->numHeaders = info->numSectors = info->extents = 0;
+    info->flags = ValidSector(sector) ? Header(sector)->flags : 0;
+    info->bad = FALSE;
+
+    while (sector != -1) {
+	if (!ValidSector(sector) || info->numHeaders >= NumSectors) {
+	    info->bad = TRUE;
+	    return;
+	}
+	DiskHeader *hdr = Header(sector);
+	if ((count = NumDataSectors(hdr)) < 0 || hdr->numBytes < 0
+			|| hdr->numBytes > count * SectorSize) {
+	    info->bad = TRUE;
+	    return;
+	}
+	info->numHeaders++;
+	info->length += hdr->numBytes;
+	for (int i = 0; i < count; i++) {
+	    if (!ValidSector(hdr->dataSectors[i]))
+		info->bad = TRUE;
+	    else if (hdr->dataSectors[i] != last + 1)
+		info->extents++;
+	    last = hdr->dataSectors[i];
+	    info->numSectors++;
+	}
+	sector = hdr->nextSector;
+    }
+}
+
+//----------------------------------------------------------------------
+// FetchFile
+// 	Return a new buffer holding the contents of the uncompressed file
+//	whose first header is at "sector", and set "length".  Return NULL
+//	if the file is compressed, or the headers are damaged.
+//----------------------------------------------------------------------
+
+static char *
+FetchFile(int sector, int *length)
+{
+    FileInfo info;
+    char *data;
+    int done = 0;
+
+    Describe(sector, &info);
+    if (info.bad || (info.flags & FileCompressed))
+	return NULL;
+    data = new char[info.length + 1];
+    for (; sector != -1; sector = Header(sector)->nextSector) {
+	DiskHeader *hdr = Header(sector);
+	for (int i = 0, left = hdr->numBytes; i < hdr->numSectors && left > 0; i++) {
+	    int n = (left < SectorSize) ? left : SectorSize;
+	    memcpy(data + done, Sector(hdr->dataSectors[i]), n);
+	    done += n;
+	    left -= n;
+	}
+    }
+    *length = done;
+    return data;
+}
+
+//----------------------------------------------------------------------
+// FetchDirectory
+// 	Return a new copy of the table of the directory whose header is
+//	at "sector", or NULL if it can't be read.
+//----------------------------------------------------------------------
+
+static DirectoryEntry *
+FetchDirectory(int sector)
+{
+    int length;
+    char *data = FetchFile(sector, &length);
+
+    if (data != NULL && length < (int) DirectoryFileSize) {
+	delete [] data;
+	return NULL;
+    }
+    return (DirectoryEntry *) data;
+}
+
+//----------------------------------------------------------------------
+// Lookup
+// 	Find the header sector of "path", starting from the root
+//	directory.  Set "isDir".  Return -1 if there is no such file.
+//----------------------------------------------------------------------
+
+static int
+Lookup(char *path, bool *isDir)
+{
+    char *copy = new char[strlen(path) + 1];
+    int sector = DirectorySector;
+
+    strcpy(copy, path);
+    *isDir = TRUE;
+    for (char *name = strtok(copy, "/"); name != NULL; name = strtok(NULL, "/")) {
+	DirectoryEntry *table = (*isDir) ? FetchDirectory(sector) : NULL;
+	int i;
+
+	if (table == NULL) {
+	    sector = -1;
+	    break;
+	}
+	for (i = 0; i < NumDirEntries; i++)
+	    if (table[i].inUse && strncmp(table[i].name, name, FileNameMaxLen) == 0)
+		break;
+	sector = (i < NumDirEntries) ? table[i].sector : -1;
+	*isDir = (i < NumDirEntries) && table[i].Dir;
+	delete [] (char *) table;
+	if (sector == -1)
+	    break;
+    }
+    delete [] copy;
+    return sector;
+}
+
+//----------------------------------------------------------------------
+// FirstVisit
+// 	Return TRUE if the directory whose header is at "sector" hasn't
+//	been read before, and remember that it now has.  A damaged tree
+//	can name a directory above itself; like fsck, ls and frag only go
+//	into a directory the first time it is found, instead of forever.
+//----------------------------------------------------------------------
+
+static bool
+FirstVisit(int sector)
+{
+    unsigned int bit = 1 << (sector % BitsInWord);
+    bool first;
+
+    if (!ValidSector(sector))
+	return TRUE;			// FetchDirectory reports it
+    if (visited == NULL) {
+	visited = new unsigned int[NumSectors / BitsInWord];
+	memset(visited, 0, NumSectors / BitsInByte);
+    }
+    first = (visited[sector / BitsInWord] & bit) == 0;
+    visited[sector / BitsInWord] |= bit;
+    return first;
+}
+
+//----------------------------------------------------------------------
+// ListDirectory
+// 	Print the entries of the directory at "sector", one per line, with
+//	"depth" levels of indentation; go into subdirectories if
+//	"recursive".  A directory found again is reported, not listed.
+//----------------------------------------------------------------------
+
+static void
+ListDirectory(int sector, bool recursive, int depth)
+{
+    DirectoryEntry *table;
+    FileInfo info;
+
+    if (!FirstVisit(sector)) {
+	printf("%*s(directory at sector %d was already listed: the tree loops)\n",
+		2 * depth, "", sector);
+	return;
+    }
+    table = FetchDirectory(sector);
+    if (table == NULL) {
+	printf("%*s(directory at sector %d is damaged)\n", 2 * depth, "", sector);
+	return;
+    }
+    for (int i = 0; i < NumDirEntries; i++) {
+	if (!table[i].inUse)
+	    continue;
+	Describe(table[i].sector, &info);
+	printf("%*s%-*.*s %s %8d bytes  header %d\n", 2 * depth, "",
+		FileNameMaxLen, FileNameMaxLen, table[i].name,
+		table[i].Dir ? "D" : "F", info.length, table[i].sector);
+	if (recursive && table[i].Dir)
+	    ListDirectory(table[i].sector, TRUE, depth + 1);
+    }
+    delete [] (char *) table;
+}
+
+//----------------------------------------------------------------------
+// Collect
+// 	Describe every file below the directory at "sector", named
+//	"path", adding them to "files" (growing it as needed).  A
+//	directory found again is reported, not read again.
+//----------------------------------------------------------------------
+
+static void
+Collect(int sector, const char *path, FileInfo **files, int *numFiles, int *size)
+{
+    DirectoryEntry *table;
+
+    if (!FirstVisit(sector)) {
+	printf("%s: directory was already read: the tree loops\n",
+		(*path == '\0') ? "/" : path);
+	return;
+    }
+    table = FetchDirectory(sector);
+    if (table == NULL)
+	return;
+    for (int i = 0; i < NumDirEntries; i++) {
+	if (!table[i].inUse)
+	    continue;
+	char *name = new char[strlen(path) + FileNameMaxLen + 2];
+	sprintf(name, "%s/%.*s", path, FileNameMaxLen, table[i].name);
+	if (table[i].Dir) {
+	    Collect(table[i].sector, name, files, numFiles, size);
+	    delete [] name;
+	    continue;
+	}
+	if (*numFiles == *size) {
+	    FileInfo *bigger = new FileInfo[2 * *size];
+	    memcpy(bigger, *files, *size * sizeof(FileInfo));
+	    delete [] *files;
+	    *files = bigger;
+	    *size *= 2;
+	}
+	(*files)[*numFiles].path = name;
+	(*files)[*numFiles].hdrSector = table[i].sector;
+	(*numFiles)++;
+    }
+    delete [] (char *) table;
+}
+
+// The work of one host thread: a slice of the files to describe, and
+// a slice of the free map to scan.
+
+class ScanJob {
+  public:
+    FileInfo *files;			// Files to Describe
+    int numFiles;
+    unsigned int *freeMap;		// The whole free map
+    int firstSector, lastSector;	// Slice of it to scan
+    int numFree;			// Out: free sectors in the slice
+    int freeRuns;			// Out: runs of free sectors
+    int longestRun;			// Out: longest run
+    int leadingFree, trailingFree;	// Out: free sectors at either end,
+					// to join runs across slices
+};
+
+//----------------------------------------------------------------------
+// Scan
+// 	Body of each host thread.
+//----------------------------------------------------------------------
+
+static void *
+Scan(void *arg)
+{
+    ScanJob *job = (ScanJob *) arg;
+    int run = 0;
+
+    for (int i = 0; i < job->numFiles; i++)
+	Describe(job->files[i].hdrSector, &job->files[i]);
+
+    job->numFree = job->freeRuns = job->longestRun = 0;
+    job->leadingFree = -1;
+    for (int s = job->firstSector; s < job->lastSector; s++) {
+	bool used = (job->freeMap[s / BitsInWord] >> (s % BitsInWord)) & 1;
+	if (!used) {
+	    job->numFree++;
+	    if (run++ == 0)
+		job->freeRuns++;
+	    if (run > job->longestRun)
+		job->longestRun = run;
+	} else {
+	    if (job->leadingFree == -1)
+		job->leadingFree = run;
+	    run = 0;
+	}
+    }
+    if (job->leadingFree == -1)
+	job->leadingFree = run;		// the whole slice is free
+    job->trailingFree = run;
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// Report
+// 	Scan the files (if "fragReport") and the free map in parallel,
+//	then print either the fragmentation report or the space totals.
+//----------------------------------------------------------------------
+
+static void
+Report(bool fragReport)
+{
+    int size = 64, numFiles = 0, length;
+    FileInfo *files = new FileInfo[size];
+    unsigned int *freeMap = (unsigned int *) FetchFile(FreeMapSector, &length);
+    ScanJob *jobs = new ScanJob[numThreads];
+    pthread_t *threads = new pthread_t[numThreads];
+
+    if (freeMap == NULL || length < (int) FreeMapFileSize) {
+	printf("The free map is damaged\n");
+	exit(1);
+    }
+    if (fragReport)
+	Collect(DirectorySector, "", &files, &numFiles, &size);
+
+    for (int t = 0; t < numThreads; t++) {
+	int filesFrom = numFiles * t / numThreads;
+	jobs[t].files = files + filesFrom;
+	jobs[t].numFiles = numFiles * (t + 1) / numThreads - filesFrom;
+	jobs[t].freeMap = freeMap;
+	jobs[t].firstSector = (int) ((long long) NumSectors * t / numThreads);
+	jobs[t].lastSector = (int) ((long long) NumSectors * (t + 1) / numThreads);
+	pthread_create(&threads[t], NULL, Scan, &jobs[t]);
+    }
+
+    int numFree = 0, freeRuns = 0, longestRun = 0, run = 0;
+    for (int t = 0; t < numThreads; t++) {
+	pthread_join(threads[t], NULL);
+	numFree += jobs[t].numFree;
+	freeRuns += jobs[t].freeRuns;
+	if (run > 0 && jobs[t].leadingFree > 0)
+	    freeRuns--;			// one run, split between slices
+	if (run + jobs[t].leadingFree > longestRun)
+	    longestRun = run + jobs[t].leadingFree;
+	if (jobs[t].longestRun > longestRun)
+	    longestRun = jobs[t].longestRun;
+	if (jobs[t].numFree == jobs[t].lastSector - jobs[t].firstSector)
+	    run += jobs[t].numFree;
+	else
+	    run = jobs[t].trailingFree;
+    }
+
+    if (fragReport) {
+	int fragmented = 0, extents = 0;
+	for (int i = 0; i < numFiles; i++) {
+	    FileInfo *f = &files[i];
+	    extents += f->extents;
+	    if (f->bad)
+		printf("%s: header chain or data sectors out of range\n", f->path);
+	    else if (f->extents > f->numHeaders) {
+		fragmented++;
+		printf("%s: %d bytes in %d extents\n", f->path, f->length, f->extents);
+	    }
+	}
+	printf("%d files, %d fragmented, %d extents\n", numFiles, fragmented, extents);
+	printf("Free space: %d sectors in %d runs, longest %d\n",
+		numFree, freeRuns, longestRun);
+    } else {
+	printf("%d sectors of %d bytes: %d used, %d free\n", NumSectors,
+		SectorSize, NumSectors - numFree, numFree);
+	printf("Largest file that fits in one run: %d bytes\n", longestRun * SectorSize);
+    }
+
+    for (int i = 0; i < numFiles; i++)
+	delete [] files[i].path;
+    delete [] files;
+    delete [] jobs;
+    delete [] threads;
+    delete [] (char *) freeMap;
+}
+
+//----------------------------------------------------------------------
+// Stat
+// 	Print where a file's headers and data sectors are.
+//----------------------------------------------------------------------
+
+static void
+Stat(char *path, int sector, bool isDir)
+{
+    FileInfo info;
+
+    Describe(sector, &info);
+    printf("%s: %s, %d bytes\n", path, isDir ? "directory" : "file", info.length);
+    printf("Flags:%s%s\n", (info.flags & FileShared) ? " shared" : "",
+		(info.flags & FileCompressed) ? " compressed" : "");
+    printf("%d headers, %d data sectors in %d extents%s\n", info.numHeaders,
+		info.numSectors, info.extents, info.bad ? " (damaged)" : "");
+    for (int n = 0; ValidSector(sector) && n < info.numHeaders; n++) {
+	DiskHeader *hdr = Header(sector);
+	printf("Header %d (%d bytes):", sector, hdr->numBytes);
+	for (int i = 0; i < NumDataSectors(hdr); i++)
+	    printf(" %d", hdr->dataSectors[i]);
+	printf("\n");
+	sector = hdr->nextSector;
+    }
+}
+
+//----------------------------------------------------------------------
+// StoreFile
+// 	The reverse of FetchFile: copy "length" bytes of "data" over the
+//	contents of the file whose first header is at "sector".  Only
+//	used by fsck to write back a repaired free map.
+//----------------------------------------------------------------------
+
+static void
+StoreFile(int sector, char *data, int length)
+{
+    int done = 0;
+
+    for (; sector != -1 && done < length; sector = Header(sector)->nextSector) {
+	DiskHeader *hdr = Header(sector);
+	for (int i = 0, left = hdr->numBytes; i < hdr->numSectors && left > 0; i++) {
+	    int n = (left < SectorSize) ? left : SectorSize;
+	    memcpy(Sector(hdr->dataSectors[i]), data + done, n);
+	    done += n;
+	    left -= n;
+	}
+    }
+}
+
+// The consistency check ("fsck") has two phases.
+//
+// First, host threads walk the directory tree, counting the references
+// to every sector from a reachable file header (the header sectors
+// themselves included).  The threads share a stack of directories
+// still to be read; each directory found is pushed, so the work fans
+// out over the subtrees.  A directory is only read the first time its
+// header is found, so a damaged tree can't make the walk loop.
+//
+// Second, the sectors are split among the threads, and each compares
+// the counts with the free map:
+//	referenced, but free in the map	-- the next Create would hand the
+//					   sector out twice
+//	in the map, but not referenced	-- leaked, eg. by a crash in the
+//					   middle of Create or Remove
+//	referenced by more headers than the table of shared sectors
+//	allows				-- cross-linked
+// With "repair", the first two are fixed in the free map, which is
+// written back to the image.  Cross-links need a person to decide
+// which file keeps the sector, so they are only reported.
+
+class FsckDirectory {
+  public:
+    int sector;				// Header of a directory to read
+    char *path;				// Its name
+};
+
+static unsigned short *refs;		// References found to each sector
+static unsigned short *allowed;		// References the shared sector
+					// table allows (normally 1)
+static FsckDirectory *fsckStack;	// Directories waiting to be read
+static int fsckStackSize, fsckStackTop;
+static int fsckBusy;			// Threads reading a directory
+static pthread_mutex_t fsckMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t fsckMoreWork = PTHREAD_COND_INITIALIZER;
+static int numFiles, numDirs, numDamaged;
+
+//----------------------------------------------------------------------
+// CountFile
+// 	Count one reference to each header and data sector of the file
+//	whose first header is at "sector".  Return TRUE if this is the
+//	first time its header was found.
+//----------------------------------------------------------------------
+
+static bool
+CountFile(int sector, const char *path)
+{
+    FileInfo info;
+    bool first;
+
+    Describe(sector, &info);
+    if (info.bad) {
+	printf("fsck: %s: header chain or data sectors out of range\n", path);
+	__sync_fetch_and_add(&numDamaged, 1);
+	if (!ValidSector(sector))
+	    return FALSE;
+    }
+    first = __sync_fetch_and_add(&refs[sector], 1) == 0;
+    for (int n = 0; n < info.numHeaders; n++) {
+	DiskHeader *hdr = Header(sector);
+	for (int i = 0; i < NumDataSectors(hdr); i++)
+	    if (ValidSector(hdr->dataSectors[i]))
+		__sync_fetch_and_add(&refs[hdr->dataSectors[i]], 1);
+	if ((sector = hdr->nextSector) != -1 && ValidSector(sector))
+	    __sync_fetch_and_add(&refs[sector], 1);
+    }
+    return first && !info.bad;
+}
+
+//----------------------------------------------------------------------
+// PushDirectory
+// 	Add a directory to the stack of work for the walk.
+//----------------------------------------------------------------------
+
+static void
+PushDirectory(int sector, char *path)
+{
+    pthread_mutex_lock(&fsckMutex);
+    if (fsckStackTop == fsckStackSize) {
+	FsckDirectory *bigger = new FsckDirectory[2 * fsckStackSize];
+	memcpy(bigger, fsckStack, fsckStackSize * sizeof(FsckDirectory));
+	delete [] fsckStack;
+	fsckStack = bigger;
+	fsckStackSize *= 2;
+    }
+    fsckStack[fsckStackTop].sector = sector;
+    fsckStack[fsckStackTop].path = path;
+    fsckStackTop++;
+    pthread_cond_signal(&fsckMoreWork);
+    pthread_mutex_unlock(&fsckMutex);
+}
+
+//----------------------------------------------------------------------
+// CheckDirectory
+// 	Count the references from every entry of one directory, and
+//	push its subdirectories.
+//----------------------------------------------------------------------
+
+static void
+CheckDirectory(int sector, char *path)
+{
+    DirectoryEntry *table = FetchDirectory(sector);
+
+    __sync_fetch_and_add(&numDirs, 1);
+    if (table == NULL) {
+	printf("fsck: %s: directory can't be read\n", (*path == '\0') ? "/" : path);
+	__sync_fetch_and_add(&numDamaged, 1);
+	return;
+    }
+    for (int i = 0; i < NumDirEntries; i++) {
+	if (!table[i].inUse)
+	    continue;
+	char *name = new char[strlen(path) + FileNameMaxLen + 2];
+	sprintf(name, "%s/%.*s", path, FileNameMaxLen, table[i].name);
+	bool first = CountFile(table[i].sector, name);
+	if (table[i].Dir && first) {
+	    PushDirectory(table[i].sector, name);
+	    continue;
+	}
+	if (!table[i].Dir)
+	    __sync_fetch_and_add(&numFiles, 1);
+	delete [] name;
+    }
+    delete [] (char *) table;
+}
+
+//----------------------------------------------------------------------
+// Walk
+// 	Body of each host thread in the first phase: read directories
+//	until the stack is empty and no other thread can add to it.
+//----------------------------------------------------------------------
+
+static void *
+Walk(void *arg)
+{
+    FsckDirectory dir;
+
+    pthread_mutex_lock(&fsckMutex);
+    for (;;) {
+	while (fsckStackTop == 0 && fsckBusy > 0)
+	    pthread_cond_wait(&fsckMoreWork, &fsckMutex);
+	if (fsckStackTop == 0)
+	    break;				// nothing left anywhere
+	dir = fsckStack[--fsckStackTop];
+	fsckBusy++;
+	pthread_mutex_unlock(&fsckMutex);
+
+	CheckDirectory(dir.sector, dir.path);
+	delete [] dir.path;
+
+	pthread_mutex_lock(&fsckMutex);
+	if (--fsckBusy == 0 && fsckStackTop == 0)
+	    pthread_cond_broadcast(&fsckMoreWork);
+    }
+    pthread_mutex_unlock(&fsckMutex);
+    return NULL;
+}
+
+// The work of one host thread in the second phase.
+
+class CompareJob {
+  public:
+    unsigned int *freeMap;		// The whole free map
+    bool repair;			// Fix it?
+    int firstSector, lastSector;	// Slice to compare; both multiples
+					// of BitsInWord, so that no two
+					// threads change the same word
+    int leaked, unmarked, crossLinked;	// Out: problems found
+};
+
+//----------------------------------------------------------------------
+// Compare
+// 	Body of each host thread in the second phase.
+//----------------------------------------------------------------------
+
+static void *
+Compare(void *arg)
+{
+    CompareJob *job = (CompareJob *) arg;
+
+    job->leaked = job->unmarked = job->crossLinked = 0;
+    for (int s = job->firstSector; s < job->lastSector; s++) {
+	unsigned int bit = 1 << (s % BitsInWord);
+	bool used = (job->freeMap[s / BitsInWord] & bit) != 0;
+
+	if (refs[s] > allowed[s]) {
+	    printf("fsck: sector %d is cross-linked (%d references)\n", s, refs[s]);
+	    job->crossLinked++;
+	}
+	if (used && refs[s] == 0) {
+	    job->leaked++;
+	    if (job->repair)
+		job->freeMap[s / BitsInWord] &= ~bit;
+	} else if (!used && refs[s] > 0) {
+	    printf("fsck: sector %d is in use, but marked free\n", s);
+	    job->unmarked++;
+	    if (job->repair)
+		job->freeMap[s / BitsInWord] |= bit;
+	}
+    }
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// Fsck
+// 	Check that the free map agrees with the files reachable from the
+//	root directory; if "repair", fix what can safely be fixed.
+//	Return the number of problems left.
+//----------------------------------------------------------------------
+
+static int
+Fsck(bool repair)
+{
+    int mapLength, length, numEntries = 0;
+    unsigned int *freeMap = (unsigned int *) FetchFile(FreeMapSector, &mapLength);
+    int *shared = (int *) FetchFile(RefCountSector, &length);
+    int leaked = 0, unmarked = 0, crossLinked = 0;
+
+    if (freeMap == NULL || mapLength != FreeMapFileSize) {
+	printf("fsck: the free map is damaged; nothing can be checked\n");
+	return 1;
+    }
+    pthread_t *threads = new pthread_t[numThreads];
+    CompareJob *jobs = new CompareJob[numThreads];
+    refs = new unsigned short[NumSectors];
+    allowed = new unsigned short[NumSectors];
+    memset(refs, 0, NumSectors * sizeof(unsigned short));
+    for (int s = 0; s < NumSectors; s++)
+	allowed[s] = 1;
+    if (shared != NULL && length >= (int) sizeof(int))
+	numEntries = shared[0];
+    if (shared == NULL || length < (int) sizeof(int) || numEntries < 0
+		|| numEntries > MaxSharedSectors
+		|| length < (int) (sizeof(int) + numEntries * sizeof(RefCountEntry))) {
+	printf("fsck: the shared sector table is damaged\n");
+	numEntries = 0;
+	numDamaged++;
+    }
+    RefCountEntry *entries = (RefCountEntry *) (shared + 1);
+    for (int i = 0; i < numEntries; i++)
+	if (ValidSector(entries[i].sector) && entries[i].count > 1)
+	    allowed[entries[i].sector] = entries[i].count;
+
+    // Phase one: who references what
+    CountFile(FreeMapSector, "(free map)");
+    CountFile(RefCountSector, "(shared sector table)");
+    CountFile(DirectorySector, "/");
+    fsckStackSize = 64;
+    fsckStack = new FsckDirectory[fsckStackSize];
+    fsckStackTop = fsckBusy = 0;
+    PushDirectory(DirectorySector, strcpy(new char[1], ""));
+    for (int t = 0; t < numThreads; t++)
+	pthread_create(&threads[t], NULL, Walk, NULL);
+    for (int t = 0; t < numThreads; t++)
+	pthread_join(threads[t], NULL);
+
+    // Phase two: compare with the free map
+    for (int t = 0; t < numThreads; t++) {
+	jobs[t].freeMap = freeMap;
+	jobs[t].repair = repair;
+	jobs[t].firstSector = NumSectors / BitsInWord * t / numThreads * BitsInWord;
+	jobs[t].lastSector = NumSectors / BitsInWord * (t + 1) / numThreads * BitsInWord;
+	pthread_create(&threads[t], NULL, Compare, &jobs[t]);
+    }
+    for (int t = 0; t < numThreads; t++) {
+	pthread_join(threads[t], NULL);
+	leaked += jobs[t].leaked;
+	unmarked += jobs[t].unmarked;
+	crossLinked += jobs[t].crossLinked;
+    }
+
+    printf("fsck: %d files, %d directories\n", numFiles, numDirs);
+    printf("fsck: %d leaked sectors, %d in use but marked free, "
+	   "%d cross-linked, %d damaged files\n", leaked, unmarked,
+	   crossLinked, numDamaged);
+    if (repair && leaked + unmarked > 0) {
+	StoreFile(FreeMapSector, (char *) freeMap, FreeMapFileSize);
+	msync(image, DiskSize, MS_SYNC);
+	printf("fsck: free map repaired\n");
+	leaked = unmarked = 0;
+    }
+
+    delete [] refs;
+    delete [] allowed;
+    delete [] fsckStack;
+    delete [] threads;
+    delete [] jobs;
+    delete [] (char *) freeMap;
+    delete [] (char *) shared;
+    return leaked + unmarked + crossLinked + numDamaged;
+}
+
+//----------------------------------------------------------------------
+// MapImage
+// 	Map the image file "name" into memory, after checking its size
+//	and magic number.  Only fsck repair maps it "writable".
+//----------------------------------------------------------------------
+
+static void
+MapImage(char *name, bool writable)
+{
+    struct stat info;
+    int fd = open(name, writable ? O_RDWR : O_RDONLY);
+
+    if (fd < 0 || fstat(fd, &info) < 0) {
+	printf("fsinspect: can't open %s\n", name);
+	exit(1);
+    }
+    if (info.st_size < DiskSize) {
+	printf("fsinspect: %s is too small to be a Nachos disk\n", name);
+	exit(1);
+    }
+    image = (char *) mmap(NULL, DiskSize, writable ? PROT_READ | PROT_WRITE
+				: PROT_READ, MAP_SHARED, fd, 0);
+    if (image == (char *) MAP_FAILED) {
+	printf("fsinspect: can't map %s\n", name);
+	exit(1);
+    }
+    close(fd);
+    if (*(int *) image != MagicNumber) {
+	printf("fsinspect: %s is not a Nachos disk\n", name);
+	exit(1);
+    }
+}
+
+static void
+Usage()
+{
+    printf("Usage: fsinspect [-j threads] <disk image> ls|lsr|cat|stat <path>\n");
+    printf("       fsinspect [-j threads] <disk image> frag|df\n");
+    printf("       fsinspect [-j threads] <disk image> fsck [repair]\n");
+    exit(1);
+}
+
+int
+main(int argc, char **argv)
+{
+    char *cmd, *path;
+    int sector, length;
+    bool isDir;
+
+    numThreads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if (argc > 2 && strcmp(argv[1], "-j") == 0) {
+	numThreads = atoi(argv[2]);
+	argc -= 2;
+	argv += 2;
+    }
+    if (numThreads < 1)
+	numThreads = 1;
+    if (argc < 3)
+	Usage();
+    cmd = argv[2];
+    if (strcmp(cmd, "fsck") == 0) {
+	bool repair = (argc == 4 && strcmp(argv[3], "repair") == 0);
+	if (argc > 4 || (argc == 4 && !repair))
+	    Usage();
+	MapImage(argv[1], repair);
+	return (Fsck(repair) == 0) ? 0 : 1;
+    }
+    MapImage(argv[1], FALSE);
+
+    if (strcmp(cmd, "frag") == 0 || strcmp(cmd, "df") == 0) {
+	Report(strcmp(cmd, "frag") == 0);
+	return 0;
+    }
+    if (argc != 4)
+	Usage();
+    path = argv[3];
+    if ((sector = Lookup(path, &isDir)) == -1) {
+	printf("fsinspect: %s not found\n", path);
+	return 1;
+    }
+
+    if (strcmp(cmd, "ls") == 0 || strcmp(cmd, "lsr") == 0) {
+	if (!isDir) {
+	    printf("fsinspect: %s is not a directory\n", path);
+	    return 1;
+	}
+	ListDirectory(sector, strcmp(cmd, "lsr") == 0, 0);
+    } else if (strcmp(cmd, "cat") == 0) {
+	char *data = FetchFile(sector, &length);
+	if (data == NULL) {
+	    printf("fsinspect: %s is compressed or damaged; try nachos -p\n", path);
+	    return 1;
+	}
+	fwrite(data, 1, length, stdout);
+	delete [] data;
+    } else if (strcmp(cmd, "stat") == 0) {
+	Stat(path, sector, isDir);
+    } else
+	Usage();
+    return 0;
+}
@@ -16,31 +16,208 @@
 #include "main.h"
 #include "filehdr.h"
 #include "openfile.h"
+#include "filesys.h"
 #include "synchdisk.h"
+#include "synch.h"
+#include "compress.h"
+#include "list.h"
+
+// One entry of a FileLockTable: the lock for a single file header sector,
+// and how many users currently hold a reference to it.
+
+class FileLockEntry {
+  public:
+    int sector;
+    int refCount;
+    RWLock *lock;
+    FileHeader *hdr;
+};
+
+FileLockTable *OpenFile::inodeLocks = NULL;
+
+//----------------------------------------------------------------------
+// FileLockTable::FileLockTable
+// 	Initialize an empty table of per-file locks.
+//
+//	"debugName" is an arbitrary name, useful for debugging.
+//----------------------------------------------------------------------
+
+FileLockTable::FileLockTable(char *debugName)
+{
+    name = debugName;
+    lock = new Lock(debugName);
+    entries = new List<FileLockEntry *>;
+}
+
+//----------------------------------------------------------------------
+// FileLockTable::~FileLockTable
+// 	De-allocate the table, and any locks still in it.
+//----------------------------------------------------------------------
+
+FileLockTable::~FileLockTable()
+{
+    while (!entries->IsEmpty()) {
+	FileLockEntry *entry = entries->RemoveFront();
+	delete entry->lock;
+	delete entry->hdr;
+	delete entry;
+    }
+    delete entries;
+    delete lock;
+}
+
+//----------------------------------------------------------------------
+// FileLockTable::Find
+// 	Return the entry for the file whose header is at "sector", or
+//	NULL if no one is using that file.  The caller holds "lock".
+//----------------------------------------------------------------------
+
+FileLockEntry *
+FileLockTable::Find(int sector)
+{
+    ListIterator<FileLockEntry *> iter(entries);
+
+    for (; !iter.IsDone(); iter.Next()) {
+	if (iter.Item()->sector == sector)
+	    return iter.Item();
+    }
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// FileLockTable::Get
+// 	Return the lock guarding the file whose header is at "sector",
+//	creating one if no one else is using that file right now.
+//	Every Get must be matched by a Put.
+//----------------------------------------------------------------------
+
+RWLock *
+FileLockTable::Get(int sector)
+{
+    FileLockEntry *entry;
+
+    lock->Acquire();
+    entry = Find(sector);
+    if (entry == NULL) {
+	entry = new FileLockEntry;
+	entry->sector = sector;
+	entry->refCount = 0;
+	entry->lock = new RWLock(name);
+	entry->hdr = NULL;
+	entries->Append(entry);
+    }
+    entry->refCount++;
+    lock->Release();
+    return entry->lock;
+}
+
+//----------------------------------------------------------------------
+// FileLockTable::Put
+// 	Drop a reference to the lock for "sector"; the lock is deleted
+//	when its last user is done with it.
+//----------------------------------------------------------------------
+
+void
+FileLockTable::Put(int sector)
+{
+    FileLockEntry *entry;
+
+    lock->Acquire();
+    entry = Find(sector);
+    ASSERT(entry != NULL);
+    if (--entry->refCount == 0) {
+	entries->Remove(entry);
+	delete entry->lock;
+	delete entry->hdr;
+	delete entry;
+    }
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// FileLockTable::Header/SetHeader
+// 	Look up, or remember, the in-core file header for "sector".
+//	The caller must hold a reference from Get.  The header is
+//	deleted along with the lock, when the last reference is dropped.
+//----------------------------------------------------------------------
+
+FileHeader *
+FileLockTable::Header(int sector)
+{
+    FileLockEntry *entry;
+
+    lock->Acquire();
+    entry = Find(sector);
+    ASSERT(entry != NULL);
+    lock->Release();
+    return entry->hdr;
+}
+
+void
+FileLockTable::SetHeader(int sector, FileHeader *hdr)
+{
+    FileLockEntry *entry;
+
+    lock->Acquire();
+    entry = Find(sector);
+    ASSERT(entry != NULL && entry->hdr == NULL);
+    entry->hdr = hdr;
+    lock->Release();
+}
 
 //----------------------------------------------------------------------
 // OpenFile::OpenFile
 // 	Open a Nachos file for reading and writing.  Bring the file header
-//	into memory while the file is open.
+//	into memory while the file is open.  If the file is already open,
+//	share the header that is already in memory.
 //
 //	"sector" -- the location on disk of the file header for this file
 //----------------------------------------------------------------------
 
 OpenFile::OpenFile(int sector)
 { 
-    hdr = new FileHeader;
-    hdr->FetchFrom(sector);
+    if (inodeLocks == NULL)
+	inodeLocks = new FileLockTable("inode lock");
+    inodeLock = inodeLocks->Get(sector);
+    hdrSector = sector;
+    inodeLock->AcquireWrite();
+    hdr = inodeLocks->Header(sector);
+    if (hdr == NULL) {
+	hdr = new FileHeader;
+	hdr->FetchFrom(sector);
+	inodeLocks->SetHeader(sector, hdr);
+    }
+    inodeLock->ReleaseWrite();
     seekPosition = 0;
 }
 
 //----------------------------------------------------------------------
 // OpenFile::~OpenFile
 // 	Close a Nachos file, de-allocating any in-memory data structures.
+//	The header goes away with the last OpenFile on this file.
 //----------------------------------------------------------------------
 
 OpenFile::~OpenFile()
 {
-    delete hdr;
+    inodeLocks->Put(hdrSector);
+}
+
+//----------------------------------------------------------------------
+// OpenFile::LockHeader/UnlockHeader
+// 	Hold the file exclusively, so that its header can be changed in
+//	place (for instance, to clone the file) without racing a WriteAt.
+//----------------------------------------------------------------------
+
+void
+OpenFile::LockHeader()
+{
+    inodeLock->AcquireWrite();
+}
+
+void
+OpenFile::UnlockHeader()
+{
+    inodeLock->ReleaseWrite();
 }
 
 //----------------------------------------------------------------------
@@ -110,34 +287,51 @@ OpenFile::Write(char *into, int numBytes)
 //	"numBytes" -- the number of bytes to transfer
 //	"position" -- the offset within the file of the first byte to be
 //			read/written
+//
+//	ReadAt holds the file's lock shared, WriteAt holds it exclusively,
+//	so a reader never sees a half-written request.  While it holds the
+//	lock, the thread's diskOrigin names the file, for disk traces.
 //----------------------------------------------------------------------
 
 int
 OpenFile::ReadAt(char *into, int numBytes, int position)
 {
     int fileLength = hdr->FileLength();
-    int i, firstSector, lastSector, numSectors;
+    int i, firstSector, lastSector, numSectors, run;
     char *buf;
 
     if ((numBytes <= 0) || (position >= fileLength))
     	return 0; 				// check request
+    inodeLock->AcquireRead();
+    kernel->currentThread->diskOrigin = hdrSector;
     if ((position + numBytes) > fileLength)		
 	numBytes = fileLength - position;
     DEBUG(dbgFile, "Reading " << numBytes << " bytes at " << position << " from file of length " << fileLength);
+    if (hdr->IsCompressed()) {
+	numBytes = ReadChunks(into, numBytes, position);
+	kernel->currentThread->diskOrigin = -1;
+	inodeLock->ReleaseRead();
+	return numBytes;
+    }
 
     firstSector = divRoundDown(position, SectorSize);
     lastSector = divRoundDown(position + numBytes - 1, SectorSize);
     numSectors = 1 + lastSector - firstSector;
 
-    // read in all the full and partial sectors that we need
+    // read in all the full and partial sectors that we need,
+    // each run of consecutive sectors in one request
     buf = new char[numSectors * SectorSize];
-    for (i = firstSector; i <= lastSector; i++)	
-        kernel->synchDisk->ReadSector(hdr->ByteToSector(i * SectorSize), 
-					&buf[(i - firstSector) * SectorSize]);
+    for (i = firstSector; i <= lastSector; i += run) {
+        run = RunLength(i, lastSector);
+        kernel->synchDisk->ReadSectors(hdr->ByteToSector(i * SectorSize), 
+					&buf[(i - firstSector) * SectorSize], run);
+    }
 
     // copy the part we want
     bcopy(&buf[position - (firstSector * SectorSize)], into, numBytes);
     delete [] buf;
+    kernel->currentThread->diskOrigin = -1;
+    inodeLock->ReleaseRead();
     return numBytes;
 }
 
@@ -145,15 +339,23 @@ int
 OpenFile::WriteAt(char *from, int numBytes, int position)
 {
     int fileLength = hdr->FileLength();
-    int i, firstSector, lastSector, numSectors;
+    int i, firstSector, lastSector, numSectors, moved, run;
     bool firstAligned, lastAligned;
     char *buf;
 
     if ((numBytes <= 0) || (position >= fileLength))
 	return 0;				// check request
+    inodeLock->AcquireWrite();
+    kernel->currentThread->diskOrigin = hdrSector;
     if ((position + numBytes) > fileLength)
 	numBytes = fileLength - position;
     DEBUG(dbgFile, "Writing " << numBytes << " bytes at " << position << " from file of length " << fileLength);
+    if (hdr->IsCompressed()) {
+	numBytes = WriteChunks(from, numBytes, position);
+	kernel->currentThread->diskOrigin = -1;
+	inodeLock->ReleaseWrite();
+	return numBytes;
+    }
 
     firstSector = divRoundDown(position, SectorSize);
     lastSector = divRoundDown(position + numBytes - 1, SectorSize);
@@ -168,23 +370,236 @@ OpenFile::WriteAt(char *from, int numBytes, int position)
     lastAligned = ((position + numBytes) == ((lastSector + 1) * SectorSize));
 
 // read in first and last sector, if they are to be partially modified
+// (straight from the disk -- ReadAt would try to take the lock we hold)
     if (!firstAligned)
-        ReadAt(buf, SectorSize, firstSector * SectorSize);	
+        kernel->synchDisk->ReadSector(hdr->ByteToSector(firstSector * SectorSize),
+					buf);
     if (!lastAligned && ((firstSector != lastSector) || firstAligned))
-        ReadAt(&buf[(lastSector - firstSector) * SectorSize], 
-				SectorSize, lastSector * SectorSize);	
+        kernel->synchDisk->ReadSector(hdr->ByteToSector(lastSector * SectorSize),
+				&buf[(lastSector - firstSector) * SectorSize]);
 
 // copy in the bytes we want to change 
     bcopy(from, &buf[position - (firstSector * SectorSize)], numBytes);
 
-// write modified sectors back
-    for (i = firstSector; i <= lastSector; i++)	
-        kernel->synchDisk->WriteSector(hdr->ByteToSector(i * SectorSize), 
-					&buf[(i - firstSector) * SectorSize]);
+// sectors shared with a clone get a private copy first (the old contents
+// of any partially written sector are already in buf)
+    moved = hdr->IsShared() ? CopyOnWrite(firstSector, lastSector) : 0;
+    if (moved < 0) {				// disk full
+        delete [] buf;
+        kernel->currentThread->diskOrigin = -1;
+        inodeLock->ReleaseWrite();
+        return 0;
+    }
+
+// write modified sectors back, each run of consecutive sectors in one request
+    for (i = firstSector; i <= lastSector; i += run) {
+        run = RunLength(i, lastSector);
+        kernel->synchDisk->WriteSectors(hdr->ByteToSector(i * SectorSize), 
+					&buf[(i - firstSector) * SectorSize], run);
+    }
+    if (moved > 0)
+        hdr->WriteBack(hdrSector);		// now points at the copies
     delete [] buf;
+    kernel->currentThread->diskOrigin = -1;
+    inodeLock->ReleaseWrite();
+    return numBytes;
+}
+
+//----------------------------------------------------------------------
+// OpenFile::RunLength
+// 	Return how many of the file's sectors firstSector..lastSector,
+//	starting with the first, are stored in consecutive disk sectors,
+//	and so can be transferred in a single disk request.
+//----------------------------------------------------------------------
+
+int
+OpenFile::RunLength(int firstSector, int lastSector)
+{
+    int start = hdr->ByteToSector(firstSector * SectorSize);
+    int i;
+
+    for (i = firstSector + 1; i <= lastSector; i++)
+        if (hdr->ByteToSector(i * SectorSize) != start + (i - firstSector))
+            break;
+    return i - firstSector;
+}
+
+//----------------------------------------------------------------------
+// OpenFile::CopyOnWrite
+// 	Before writing sectors firstSector..lastSector of a file that
+//	may share data with a clone, move every shared one to a freshly
+//	allocated sector, and record the move in the in-core header.
+//	Return the number of sectors moved (the caller must write the
+//	header back), or -1 if the disk is full.
+//
+//	The caller holds the file exclusively.
+//----------------------------------------------------------------------
+
+int
+OpenFile::CopyOnWrite(int firstSector, int lastSector)
+{
+    int numSectors = 1 + lastSector - firstSector;
+    int *sectors = new int[numSectors];
+    int i, moved;
+
+    for (i = firstSector; i <= lastSector; i++)
+        sectors[i - firstSector] = hdr->ByteToSector(i * SectorSize);
+    moved = kernel->fileSystem->CopyOnWrite(sectors, numSectors);
+    if (moved > 0) {
+        for (i = firstSector; i <= lastSector; i++)
+            hdr->SetSector(i * SectorSize, sectors[i - firstSector]);
+    }
+    delete [] sectors;
+    return moved;
+}
+
+//----------------------------------------------------------------------
+// OpenFile::ReadChunks/WriteChunks
+// 	ReadAt/WriteAt for a compressed file: the request is split along
+//	chunk boundaries, and each chunk is decompressed (from the cache if
+//	possible), and, for a write, changed and compressed again.  A chunk
+//	that is entirely overwritten need not be read first.
+//
+//	WriteChunks returns the number of bytes written before the disk
+//	filled up, if it did.  The header (with its chunk index) is
+//	written back once, at the end.
+//
+//	The caller holds the file's lock, and has already trimmed the
+//	request to the end of the file.
+//----------------------------------------------------------------------
+
+int
+OpenFile::ReadChunks(char *into, int numBytes, int position)
+{
+    char *data = new char[ChunkSize];
+    int end = position + numBytes;
+    int pos, next, chunk;
+
+    for (pos = position; pos < end; pos = next) {
+	chunk = pos / ChunkSize;
+	next = min((chunk + 1) * ChunkSize, end);
+	FetchChunk(chunk, data);
+	bcopy(&data[pos % ChunkSize], &into[pos - position], next - pos);
+    }
+    delete [] data;
     return numBytes;
 }
 
+int
+OpenFile::WriteChunks(char *from, int numBytes, int position)
+{
+    char *data = new char[ChunkSize];
+    int end = position + numBytes;
+    int pos, next, chunk;
+
+    for (pos = position; pos < end; pos = next) {
+	chunk = pos / ChunkSize;
+	next = min((chunk + 1) * ChunkSize, end);
+	if ((pos % ChunkSize) != 0 || (next - pos) < ChunkBytes(chunk))
+	    FetchChunk(chunk, data);		// partially overwritten
+	else
+	    memset(data, 0, ChunkSize);
+	bcopy(&from[pos - position], &data[pos % ChunkSize], next - pos);
+	if (StoreChunk(chunk, data) < 0) {	// disk full
+	    numBytes = pos - position;
+	    break;
+	}
+    }
+    hdr->WriteBack(hdrSector);
+    delete [] data;
+    return numBytes;
+}
+
+//----------------------------------------------------------------------
+// OpenFile::ChunkBytes
+// 	Return the number of bytes of the file in chunk "chunk": ChunkSize,
+//	except for the last chunk of the file.
+//----------------------------------------------------------------------
+
+int
+OpenFile::ChunkBytes(int chunk)
+{
+    return min(ChunkSize, hdr->FileLength() - chunk * ChunkSize);
+}
+
+//----------------------------------------------------------------------
+// OpenFile::FetchChunk
+// 	Put the decompressed contents of chunk "chunk" into "data" (which
+//	holds ChunkSize bytes; any part beyond the end of the file is
+//	zeroed).  Only the sectors holding the compressed chunk are read,
+//	and none at all if the chunk is in the cache.
+//----------------------------------------------------------------------
+
+void
+OpenFile::FetchChunk(int chunk, char *data)
+{
+    ChunkCache *cache = kernel->fileSystem->chunkCache;
+    int length, size, i, first, last, run;
+    char *packed;
+
+    if (cache->Read(hdrSector, chunk, data))
+	return;
+
+    memset(data, 0, ChunkSize);
+    length = hdr->ChunkLength(chunk);
+    size = ChunkBytes(chunk);
+    if (length > 0) {				// else never written: zeros
+	packed = new char[ChunkSize];
+	first = chunk * ChunkSectors;
+	last = first + divRoundUp(length, SectorSize) - 1;
+	for (i = first; i <= last; i += run) {
+	    run = RunLength(i, last);
+	    kernel->synchDisk->ReadSectors(hdr->ByteToSector(i * SectorSize),
+				&packed[(i - first) * SectorSize], run);
+	}
+	if (length == size)			// stored as is
+	    bcopy(packed, data, size);
+	else
+	    Decompress(packed, length, data, size);
+	delete [] packed;
+    }
+    cache->Write(hdrSector, chunk, data);
+}
+
+//----------------------------------------------------------------------
+// OpenFile::StoreChunk
+// 	Compress "data", the new contents of chunk "chunk", write it to
+//	the first sectors reserved for the chunk, and record its length in
+//	the in-core header.  A chunk that does not compress is stored as
+//	is.  Return the number of shared sectors that had to be copied
+//	first, or -1 if the disk is full.
+//----------------------------------------------------------------------
+
+int
+OpenFile::StoreChunk(int chunk, char *data)
+{
+    char *packed = new char[ChunkSize];
+    char *stored = packed;
+    int size = ChunkBytes(chunk);
+    int length = Compress(data, size, packed);
+    int firstSector = chunk * ChunkSectors;
+    int lastSector, moved = 0, i, run;
+
+    if (length < 0) {				// doesn't compress
+	stored = data;
+	length = size;
+    }
+    lastSector = firstSector + divRoundUp(length, SectorSize) - 1;
+    if (hdr->IsShared())
+	moved = CopyOnWrite(firstSector, lastSector);
+    if (moved >= 0) {
+	for (i = firstSector; i <= lastSector; i += run) {
+	    run = RunLength(i, lastSector);
+	    kernel->synchDisk->WriteSectors(hdr->ByteToSector(i * SectorSize),
+				&stored[(i - firstSector) * SectorSize], run);
+	}
+	hdr->SetChunkLength(chunk, length);
+	kernel->fileSystem->chunkCache->Write(hdrSector, chunk, data);
+    }
+    delete [] packed;
+    return moved;
+}
+
 //----------------------------------------------------------------------
 // OpenFile::Length
 // 	Return the number of bytes in the file.
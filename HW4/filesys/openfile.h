@@ -9,9 +9,11 @@
 //
 //	The other is the "real" implementation, that turns these
 //	operations into read and write disk sector requests. 
-//	In this baseline implementation of the file system, we don't 
-//	worry about concurrent accesses to the file system
-//	by different threads.
+//	For a compressed file, requests are turned into reads and writes
+//	of whole chunks instead, which go through a cache (compress.h).
+//	Concurrent ReadAt/WriteAt calls on the same file, from any number
+//	of OpenFile objects, are serialized by a per-file reader/writer
+//	lock: reads proceed together, a write excludes everything else.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -61,6 +63,41 @@ class OpenFile {
 
 #else // FILESYS
 class FileHeader;
+class Lock;
+class RWLock;
+template <class T> class List;
+class FileLockEntry;
+
+// The following class hands out one reader/writer lock per file header
+// sector, so that every OpenFile (or Directory) on the same file shares
+// the same lock.  Locks are reference counted, and deleted once the
+// last user lets go of them.
+//
+// The table can also hold the in-core copy of each file's header, so
+// that a change one OpenFile makes to the header (such as moving a
+// shared sector) is seen by every other OpenFile on that file.
+
+class FileLockTable {
+  public:
+    FileLockTable(char *debugName);	// Initialize an empty table
+    ~FileLockTable();			// De-allocate the table
+
+    RWLock *Get(int sector);		// Return the lock for "sector",
+					// creating it if need be
+    void Put(int sector);		// Drop a reference taken by Get
+    FileHeader *Header(int sector);	// In-core header for "sector",
+					// or NULL if not loaded yet
+    void SetHeader(int sector, FileHeader *hdr);
+					// Remember "hdr" until the last
+					// reference to "sector" is dropped
+
+  private:
+    char *name;				// debugging assist
+    Lock *lock;				// protects "entries"
+    List<FileLockEntry *> *entries;	// locks currently in use
+
+    FileLockEntry *Find(int sector);	// Entry for "sector", or NULL
+};
 
 class OpenFile {
   public:
@@ -87,9 +124,39 @@ class OpenFile {
 					// than the UNIX idiom -- lseek to 
 					// end of file, tell, lseek back 
     
+    int HeaderSector() { return hdrSector; }
+					// Disk sector holding the file header
+    FileHeader *Header() { return hdr; }
+					// In-core header, shared by every
+					// OpenFile on this file
+    void LockHeader();			// Hold the file exclusively, so the
+    void UnlockHeader();		// header can be changed in place
+    
   private:
     FileHeader *hdr;			// Header for this file 
+    int hdrSector;			// Where "hdr" lives on disk
     int seekPosition;			// Current position within the file
+    RWLock *inodeLock;			// Shared by every OpenFile on this
+					// file: readers share, writers don't
+
+    static FileLockTable *inodeLocks;	// Where "inodeLock" comes from
+
+    int RunLength(int firstSector, int lastSector);
+					// How many sectors from firstSector
+					// on are consecutive on disk
+    int CopyOnWrite(int firstSector, int lastSector);
+					// Give this file private copies of
+					// any shared sectors in the range
+
+    int ReadChunks(char *into, int numBytes, int position);
+    int WriteChunks(char *from, int numBytes, int position);
+					// ReadAt/WriteAt for a compressed
+					// file
+    int ChunkBytes(int chunk);		// Uncompressed length of a chunk
+    void FetchChunk(int chunk, char *data);
+					// Decompressed contents of a chunk
+    int StoreChunk(int chunk, char *data);
+					// Compress a chunk and write it out
 };
 
 #endif // FILESYS
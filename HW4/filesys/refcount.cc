@@ -0,0 +1,178 @@
+// refcount.cc 
+//	Routines to manage the table of shared disk sectors.
+//
+//	Entries are kept sorted by sector number so that lookups can use
+//	binary search.  Cloning a file adds many entries at once, so new
+//	entries are simply appended, and the table is sorted again the
+//	next time it is searched.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation 
+// of liability and disclaimer of warranty provisions.
+#ifndef FILESYS_STUB
+
+#include "copyright.h"
+#include "refcount.h"
+#include "debug.h"
+
+//----------------------------------------------------------------------
+// CompareEntries
+//	Order two table entries by sector number, for qsort.
+//----------------------------------------------------------------------
+
+static int
+CompareEntries(const void *a, const void *b)
+{
+    return ((RefCountEntry *) a)->sector - ((RefCountEntry *) b)->sector;
+}
+
+//----------------------------------------------------------------------
+// RefCountTable::RefCountTable
+// 	Initialize an empty table of shared sectors.
+//
+//	"size" is the most sectors that can be shared at once
+//----------------------------------------------------------------------
+
+RefCountTable::RefCountTable(int size)
+{
+    tableSize = size;
+    numEntries = 0;
+    sorted = TRUE;
+    table = new RefCountEntry[size];
+}
+
+//----------------------------------------------------------------------
+// RefCountTable::~RefCountTable
+// 	De-allocate the table.
+//----------------------------------------------------------------------
+
+RefCountTable::~RefCountTable()
+{
+    delete [] table;
+}
+
+//----------------------------------------------------------------------
+// RefCountTable::FetchFrom
+// 	Read the table from disk.  Only the entries in use are read.
+//
+//	"file" -- file containing the table
+//----------------------------------------------------------------------
+
+void
+RefCountTable::FetchFrom(OpenFile *file)
+{
+    (void) file->ReadAt((char *)&numEntries, sizeof(int), 0);
+    ASSERT(numEntries >= 0 && numEntries <= tableSize);
+    (void) file->ReadAt((char *)table, numEntries * sizeof(RefCountEntry),
+				sizeof(int));
+    sorted = TRUE;
+}
+
+//----------------------------------------------------------------------
+// RefCountTable::WriteBack
+// 	Write the table back to disk.  Only the entries in use are written.
+//
+//	"file" -- file to contain the table
+//----------------------------------------------------------------------
+
+void
+RefCountTable::WriteBack(OpenFile *file)
+{
+    if (!sorted) {
+	qsort(table, numEntries, sizeof(RefCountEntry), CompareEntries);
+	sorted = TRUE;
+    }
+    (void) file->WriteAt((char *)&numEntries, sizeof(int), 0);
+    (void) file->WriteAt((char *)table, numEntries * sizeof(RefCountEntry),
+				sizeof(int));
+}
+
+//----------------------------------------------------------------------
+// RefCountTable::FindIndex
+// 	Look up a sector in the table, and return its index, or -1 if
+//	the sector isn't shared.
+//----------------------------------------------------------------------
+
+int
+RefCountTable::FindIndex(int sector)
+{
+    int low = 0, high = numEntries - 1;
+
+    if (!sorted) {
+	qsort(table, numEntries, sizeof(RefCountEntry), CompareEntries);
+	sorted = TRUE;
+    }
+    while (low <= high) {
+	int mid = (low + high) / 2;
+	if (table[mid].sector == sector)
+	    return mid;
+	else if (table[mid].sector < sector)
+	    low = mid + 1;
+	else
+	    high = mid - 1;
+    }
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// RefCountTable::Count
+// 	Return the number of file headers pointing at "sector".  A sector
+//	not in the table is assumed to be allocated to a single file.
+//----------------------------------------------------------------------
+
+int
+RefCountTable::Count(int sector)
+{
+    int i = FindIndex(sector);
+
+    return (i == -1) ? 1 : table[i].count;
+}
+
+//----------------------------------------------------------------------
+// RefCountTable::Increment
+// 	Record one more file header pointing at "sector".  The caller
+//	must first check that NumFree() is large enough.
+//----------------------------------------------------------------------
+
+void
+RefCountTable::Increment(int sector)
+{
+    int i = FindIndex(sector);
+
+    if (i != -1) {
+	table[i].count++;
+	return;
+    }
+    ASSERT(numEntries < tableSize);
+    table[numEntries].sector = sector;
+    table[numEntries].count = 2;
+    if (numEntries > 0 && table[numEntries - 1].sector > sector)
+	sorted = FALSE;
+    numEntries++;
+}
+
+//----------------------------------------------------------------------
+// RefCountTable::Decrement
+// 	Record one file header fewer pointing at "sector", and return how
+//	many are left.  Zero means the caller held the last reference,
+//	and should free the sector.
+//----------------------------------------------------------------------
+
+int
+RefCountTable::Decrement(int sector)
+{
+    int i = FindIndex(sector);
+    int left;
+
+    if (i == -1)
+	return 0;
+    left = --table[i].count;
+    if (left == 1) {			// no longer shared, drop the entry
+	memmove(&table[i], &table[i + 1],
+		(numEntries - i - 1) * sizeof(RefCountEntry));
+	numEntries--;
+    }
+    return left;
+}
+
+#endif // FILESYS_STUB
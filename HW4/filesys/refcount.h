@@ -0,0 +1,60 @@
+// refcount.h 
+//	Data structures defining a persistent table of disk sector
+//	reference counts, used to share data sectors between a file
+//	and its clones (copy-on-write).
+//
+//	Only sectors referenced by more than one file header appear in
+//	the table; any other allocated sector is implicitly referenced
+//	exactly once.  Since most disks share nothing, the table is
+//	usually empty, and fetching it costs a single sector read.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation 
+// of liability and disclaimer of warranty provisions.
+
+#ifndef REFCOUNT_H
+#define REFCOUNT_H
+
+#include "copyright.h"
+#include "openfile.h"
+
+// One entry of the table: a shared sector, and how many file headers
+// point to it (always at least 2).
+
+class RefCountEntry {
+  public:
+    int sector;
+    int count;
+};
+
+// The following class defines the table of shared sectors.  Like the
+// Directory, it is kept in memory while in use; FetchFrom/WriteBack move
+// it from/to a Nachos file.  On disk the file holds the number of
+// entries, followed by the entries sorted by sector number.
+
+class RefCountTable {
+  public:
+    RefCountTable(int size);		// Initialize an empty table with
+					// room for "size" shared sectors
+    ~RefCountTable();			// De-allocate the table
+
+    void FetchFrom(OpenFile *file);	// Init table contents from disk
+    void WriteBack(OpenFile *file);	// Write the table back to disk
+
+    int Count(int sector);		// How many headers point at "sector"?
+    void Increment(int sector);		// One more header points at "sector"
+    int Decrement(int sector);		// One header fewer; return how many
+					// are left (0 means "free it")
+    int NumFree() { return tableSize - numEntries; }
+					// How many more sectors can be shared?
+
+  private:
+    int tableSize;			// Number of entries the table can hold
+    int numEntries;			// Number of entries in use
+    bool sorted;			// Are the entries in sector order?
+    RefCountEntry *table;		// The shared sectors
+
+    int FindIndex(int sector);		// Index of "sector" in table, or -1
+};
+
+#endif // REFCOUNT_H
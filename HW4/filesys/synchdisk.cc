@@ -5,10 +5,10 @@
 //	the disk providing a synchronous interface (requests wait until
 //	the request completes).
 //
-//	Use a semaphore to synchronize the interrupt handlers with the
-//	pending requests.  And, because the physical disk can only
-//	handle one operation at a time, use a lock to enforce mutual
-//	exclusion.
+//	Use a semaphore per request to synchronize the interrupt handlers
+//	with the pending requests.  And, because the physical disk can
+//	only hold so many requests at a time, use a semaphore counting
+//	the free places, for each disk.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -16,20 +16,160 @@
 
 #include "copyright.h"
 #include "synchdisk.h"
+#include "ssd.h"
+#include "main.h"
 
+//----------------------------------------------------------------------
+// DiskUnit::DiskUnit
+// 	Initialize one disk of a volume -- a flash disk, if
+//	kernel->flash -- and what is needed to wait for it.  A rotating
+//	disk gets a write cache of kernel->writeCache sectors, if that
+//	isn't 0.
+//----------------------------------------------------------------------
+
+DiskUnit::DiskUnit(char *name, char *baseName)
+{
+    slots = new Semaphore("synch disk slots", kernel->queueDepth);
+    if (kernel->flash) {			// each request names who
+	disk = new Ssd(name, baseName, NULL);	// to call back, so there
+    } else {					// is no default
+	disk = new Disk(name, baseName, NULL);
+	if (kernel->writeCache > 0)
+	    disk->EnableWriteCache(kernel->writeCache);
+    }
+    busyUntil = 0;
+    numRequests = numReads = numWrites = busyTicks = 0;
+    numReadRequests = readTicks = 0;
+}
+
+DiskUnit::~DiskUnit()
+{
+    delete disk;
+    delete slots;
+}
+
+//----------------------------------------------------------------------
+// DiskUnit::Request
+// 	Send a request to the disk, noting it in the statistics.  The
+//	disk calls back "request" when it is done.
+//----------------------------------------------------------------------
+
+void
+DiskUnit::Request(int sectorNumber, char *data, int numSectors, bool writing,
+		  SynchRequest *request)
+{
+    numRequests++;
+    if (writing) {
+	numWrites += numSectors;
+	disk->WriteRequest(sectorNumber, data, numSectors, request);
+    } else {
+	numReads += numSectors;
+	disk->ReadRequest(sectorNumber, data, numSectors, request);
+    }
+}
+
+//----------------------------------------------------------------------
+// SynchRequest::SynchRequest
+// 	Get ready to send a request to the disk of "unit".
+//----------------------------------------------------------------------
+
+SynchRequest::SynchRequest(DiskUnit *unit, bool writing)
+{
+    this->unit = unit;
+    this->writing = writing;
+    startTicks = kernel->stats->totalTicks;
+    semaphore = new Semaphore("synch disk", 0);
+}
+
+SynchRequest::~SynchRequest()
+{
+    delete semaphore;
+}
+
+//----------------------------------------------------------------------
+// SynchRequest::CallBack
+// 	Disk interrupt handler.  Note how long the request took, and
+//	wake up the thread waiting for it to finish.
+//----------------------------------------------------------------------
+
+void
+SynchRequest::CallBack()
+{ 
+    int ticks = kernel->stats->totalTicks - startTicks;
+
+    unit->busyTicks += ticks;
+    if (!writing) {
+	unit->numReadRequests++;
+	unit->readTicks += ticks;
+    }
+    semaphore->V();
+}
+
+//----------------------------------------------------------------------
+// SynchRequest::Wait
+// 	Wait for the interrupt that says the request is done.
+//----------------------------------------------------------------------
+
+void
+SynchRequest::Wait()
+{
+    semaphore->P();
+}
+
+//----------------------------------------------------------------------
+// DiskUnit::Predict
+// 	Return how long from now a request for "numSectors" sectors from
+//	"sectorNumber" would be done, if sent to this disk: the time to
+//	finish what it was already given, plus the request itself, as
+//	Disk::ComputeLatency sees it from where the head is now.
+//----------------------------------------------------------------------
+
+int
+DiskUnit::Predict(int sectorNumber, int numSectors, bool writing)
+{
+    int now = kernel->stats->totalTicks;
+    int wait = (busyUntil > now) ? (busyUntil - now) : 0;
+
+    return wait + disk->ComputeLatency(sectorNumber, writing)
+		+ (numSectors - 1) * RotationTime;
+}
 
 //----------------------------------------------------------------------
 // SynchDisk::SynchDisk
 // 	Initialize the synchronous interface to the physical disk, in turn
 //	initializing the physical disk.
 //
+//	A single disk is kept in DISK_<host>; disk "n" of a striped or
+//	mirrored volume in DISK_<host>_<n>.  If a new overlay was asked
+//	for, each disk gets one, on the base image of the same name:
+//	"base" for a single disk, "base_<n>" for disk "n".
 //----------------------------------------------------------------------
 
 SynchDisk::SynchDisk()
 {
-    semaphore = new Semaphore("synch disk", 0);
-    lock = new Lock("synch disk lock");
-    disk = new Disk(this);
+    char name[64], baseName[64];
+    char *base = kernel->overlayBase;
+
+    numDisks = kernel->numDisks;
+    stripeUnit = kernel->stripeUnit;
+    mirrored = kernel->mirrored;
+    ASSERT(numDisks > 0 && numDisks <= MaxDisks && stripeUnit > 0);
+    for (int i = 0; i < numDisks; i++) {
+	if (numDisks == 1) {
+	    sprintf(name, "DISK_%d", kernel->hostName);
+	} else {
+	    sprintf(name, "DISK_%d_%d", kernel->hostName, i);
+	    if (base != NULL) {
+		ASSERT(strlen(kernel->overlayBase) < sizeof(baseName) - 4);
+		sprintf(baseName, "%s_%d", kernel->overlayBase, i);
+		base = baseName;
+	    }
+	}
+	units[i] = new DiskUnit(name, base);
+    }
+    trace = NULL;
+    if (kernel->traceFile != NULL)
+	trace = new DiskTrace(kernel->traceFile);
 }
 
 //----------------------------------------------------------------------
@@ -40,9 +180,9 @@ SynchDisk::SynchDisk()
 
 SynchDisk::~SynchDisk()
 {
-    delete disk;
-    delete lock;
-    delete semaphore;
+    for (int i = 0; i < numDisks; i++)
+	delete units[i];
+    delete trace;
 }
 
 //----------------------------------------------------------------------
@@ -57,10 +197,7 @@ SynchDisk::~SynchDisk()
 void
 SynchDisk::ReadSector(int sectorNumber, char* data)
 {
-    lock->Acquire();			// only one disk I/O at a time
-    disk->ReadRequest(sectorNumber, data);
-    semaphore->P();			// wait for interrupt
-    lock->Release();
+    Transfer(sectorNumber, data, 1, FALSE);
 }
 
 //----------------------------------------------------------------------
@@ -75,20 +212,253 @@ SynchDisk::ReadSector(int sectorNumber, char* data)
 void
 SynchDisk::WriteSector(int sectorNumber, char* data)
 {
-    lock->Acquire();			// only one disk I/O at a time
-    disk->WriteRequest(sectorNumber, data);
-    semaphore->P();			// wait for interrupt
-    lock->Release();
+    Transfer(sectorNumber, data, 1, TRUE);
 }
 
 //----------------------------------------------------------------------
-// SynchDisk::CallBack
-// 	Disk interrupt handler.  Wake up any thread waiting for the disk
-//	request to finish.
+// SynchDisk::ReadSectors/WriteSectors
+// 	Read/write "numSectors" consecutive sectors, starting with
+//	"sectorNumber", as a single disk request.  Return only once the
+//	whole run has been transferred.
+//
+//	"data" -- the buffer, numSectors * SectorSize bytes long
 //----------------------------------------------------------------------
 
 void
-SynchDisk::CallBack()
-{ 
-    semaphore->V();
+SynchDisk::ReadSectors(int sectorNumber, char* data, int numSectors)
+{
+    Transfer(sectorNumber, data, numSectors, FALSE);
+}
+
+void
+SynchDisk::WriteSectors(int sectorNumber, char* data, int numSectors)
+{
+    Transfer(sectorNumber, data, numSectors, TRUE);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Flush
+// 	Flush the write cache of every disk, and return only once all of
+//	them are done: every sector written before now is then on the
+//	media.  As in Transfer, the flushes are all sent before waiting
+//	for any, and slots are taken in the order of the disks.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Flush()
+{
+    SynchRequest *requests[MaxDisks];
+
+    if (trace != NULL)
+	trace->Record(-1, 0, TraceFlush);
+    for (int i = 0; i < numDisks; i++) {
+	units[i]->slots->P();
+	requests[i] = new SynchRequest(units[i], TRUE);
+	units[i]->disk->FlushRequest(requests[i]);
+    }
+    for (int i = 0; i < numDisks; i++) {
+	requests[i]->Wait();
+	delete requests[i];
+	units[i]->slots->V();
+    }
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::ChooseMirror
+// 	Return the disk of a mirrored volume that should read
+//	"numSectors" sectors from "sectorNumber": the one that is
+//	predicted to be done first.
+//----------------------------------------------------------------------
+
+int
+SynchDisk::ChooseMirror(int sectorNumber, int numSectors)
+{
+    int best = 0, bestTicks = 0, ticks;
+
+    for (int i = 0; i < numDisks; i++) {
+	ticks = units[i]->Predict(sectorNumber, numSectors, FALSE);
+	if (i == 0 || ticks < bestTicks) {
+	    best = i;
+	    bestTicks = ticks;
+	}
+    }
+    DEBUG(dbgDisk, "Mirror " << best << " reads sector " << sectorNumber
+		<< ", expected in " << bestTicks << " ticks");
+    return best;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::MapSector
+// 	Return the sector of the disk, and set "*unit" to the disk, that
+//	holds "sectorNumber".  Stripe "k" (sectors k * stripeUnit up to
+//	(k + 1) * stripeUnit - 1) is the (k / numDisks)'th stripe on disk
+//	(k % numDisks).  So, on each disk, the part of a run of sectors
+//	it holds is itself a run.
+//
+//	Only the first NumSectors / numDisks sectors of each disk are
+//	used: the file system is laid out for NumSectors sectors.
+//----------------------------------------------------------------------
+
+int
+SynchDisk::MapSector(int sectorNumber, int *unit)
+{
+    int stripe = sectorNumber / stripeUnit;
+
+    *unit = stripe % numDisks;
+    return (stripe / numDisks) * stripeUnit + sectorNumber % stripeUnit;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Transfer
+// 	Read or write "numSectors" consecutive sectors.  The run is split
+//	into one run per disk; a request for each is sent to its disk,
+//	and only then do we wait for them, so that the disks work at the
+//	same time.  Pieces for different disks are interleaved in "data",
+//	so (unless only one disk is involved) they go through a buffer
+//	per disk.
+//
+//	On a mirrored volume, a write goes to the same sectors of every
+//	disk, and a read to one disk chosen by ChooseMirror.
+//
+//	Each disk only takes so many requests at a time; a place ("slot")
+//	is taken on each disk before the request is sent, and given back
+//	once it is done.  Slots are always taken in the same order of
+//	disks, so two requests that need the same disks can't deadlock.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Transfer(int sectorNumber, char *data, int numSectors, 
+		    bool writing)
+{
+    int first[MaxDisks], count[MaxDisks];
+    char *buffer[MaxDisks];
+    SynchRequest *requests[MaxDisks];
+    int unit, sector, length, used = 0;
+
+    ASSERT(numSectors > 0);
+    if (trace != NULL)
+	trace->Record(sectorNumber, numSectors, writing ? TraceWrite : TraceRead);
+    for (int i = 0; i < numDisks; i++)
+	count[i] = 0;
+    if (mirrored) {
+	unit = writing ? -1 : ChooseMirror(sectorNumber, numSectors);
+	for (int i = 0; i < numDisks; i++)
+	    if (unit == -1 || unit == i) {
+		first[i] = sectorNumber;
+		count[i] = numSectors;
+	    }
+	used = 1;				// all disks share "data"
+    } else {
+	for (int done = 0; done < numSectors; done += length) {
+	    sector = MapSector(sectorNumber + done, &unit);
+	    length = stripeUnit - (sectorNumber + done) % stripeUnit;
+	    if (length > numSectors - done)
+		length = numSectors - done;
+	    if (count[unit] == 0) {
+		first[unit] = sector;
+		used++;
+	    }
+	    ASSERT(first[unit] + count[unit] == sector);
+	    count[unit] += length;
+	}
+    }
+
+    for (int i = 0; i < numDisks; i++)		// no copy if only one disk
+	buffer[i] = (used == 1) ? data : new char[count[i] * SectorSize];
+    if (writing && used > 1)
+	for (int done = 0; done < numSectors; done += length) {
+	    sector = MapSector(sectorNumber + done, &unit);
+	    length = stripeUnit - (sectorNumber + done) % stripeUnit;
+	    if (length > numSectors - done)
+		length = numSectors - done;
+	    bcopy(data + done * SectorSize, buffer[unit] 
+		+ (sector - first[unit]) * SectorSize, length * SectorSize);
+	}
+
+    for (int i = 0; i < numDisks; i++)
+	if (count[i] > 0)
+	    units[i]->busyUntil = kernel->stats->totalTicks
+			+ units[i]->Predict(first[i], count[i], writing);
+    for (int i = 0; i < numDisks; i++) {
+	if (count[i] == 0)
+	    continue;
+	units[i]->slots->P();			// wait for room at the disk
+	requests[i] = new SynchRequest(units[i], writing);
+	units[i]->Request(first[i], buffer[i], count[i], writing, requests[i]);
+    }
+    for (int i = 0; i < numDisks; i++) {
+	if (count[i] == 0)
+	    continue;
+	requests[i]->Wait();			// wait for interrupt
+	delete requests[i];
+	units[i]->slots->V();
+    }
+
+    if (!writing && used > 1)
+	for (int done = 0; done < numSectors; done += length) {
+	    sector = MapSector(sectorNumber + done, &unit);
+	    length = stripeUnit - (sectorNumber + done) % stripeUnit;
+	    if (length > numSectors - done)
+		length = numSectors - done;
+	    bcopy(buffer[unit] + (sector - first[unit]) * SectorSize,
+		  data + done * SectorSize, length * SectorSize);
+	}
+    if (used > 1)
+	for (int i = 0; i < numDisks; i++)
+	    delete [] buffer[i];
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::EstimateLatency
+// 	Return how long reading "sectors", in order, would take (see
+//	Disk::EstimateLatency).  With several disks, each reads its own
+//	share at the same time as the others, so the slowest one decides.
+//	The disks of a mirrored volume are all laid out alike.
+//----------------------------------------------------------------------
+
+int
+SynchDisk::EstimateLatency(int *sectors, int numSectors)
+{
+    int *onDisk = new int[numSectors];
+    int unit, n, latency, slowest = 0;
+
+    if (mirrored)
+	return units[0]->disk->EstimateLatency(sectors, numSectors);
+    for (int i = 0; i < numDisks; i++) {
+	n = 0;
+	for (int j = 0; j < numSectors; j++) {
+	    int sector = MapSector(sectors[j], &unit);
+	    if (unit == i)
+		onDisk[n++] = sector;
+	}
+	latency = units[i]->disk->EstimateLatency(onDisk, n);
+	if (latency > slowest)
+	    slowest = latency;
+    }
+    delete [] onDisk;
+    return slowest;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Print
+// 	Print the statistics of each disk of the volume (if there is
+//	more than one), and those the disks keep themselves.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Print()
+{
+    for (int i = 0; i < numDisks; i++) {
+	DiskUnit *u = units[i];
+	u->disk->Print();
+	if (numDisks == 1)
+	    break;
+	cout << "Disk " << i << ": requests " << u->numRequests;
+	cout << ", reads " << u->numReads << ", writes " << u->numWrites;
+	cout << ", in disk " << u->busyTicks << " ticks";
+	if (u->numReadRequests > 0)
+	    cout << ", average read " << u->readTicks / u->numReadRequests
+		 << " ticks";
+	cout << "\n";
+    }
 }
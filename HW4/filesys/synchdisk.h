@@ -12,6 +12,7 @@
 #define SYNCHDISK_H
 
 #include "disk.h"
+#include "disktrace.h"
 #include "synch.h"
 #include "callback.h"
 
@@ -19,17 +20,96 @@
 // As with other I/O devices, the raw physical disk is an asynchronous device --
 // requests to read or write portions of the disk return immediately,
 // and an interrupt occurs later to signal that the operation completed.
-// (Also, the physical characteristics of the disk device assume that
-// only one operation can be requested at a time).
+// (Also, the disk only holds so many requests at a time: by default,
+// just one; with -ncq, up to MaxQueueDepth, which it serves in the
+// order it likes best.)
 //
 // This class provides the abstraction that for any individual thread
 // making a request, it waits around until the operation finishes before
 // returning.
+//
+// The sectors can also be "striped" over several disks (RAID-0): the
+// sector numbers are split into stripe units of consecutive sectors,
+// which are dealt out to the disks in turn.  Each disk has its own
+// head and takes its own requests, so requests for sectors on
+// different disks proceed at the same time, and a long run of
+// sectors is split into one shorter run per disk, all transferred at
+// once.  With a single disk, this is just the plain disk.
+//
+// Each disk can have a write cache (see disk.h).  Flush is then a
+// barrier: it returns once every sector written before it is on the
+// media of every disk.
+//
+// The requests can also be recorded in a trace file (see disktrace.h).
+//
+// Instead, the disks can be "mirrored" (RAID-1): each holds a copy of
+// every sector.  A write goes to all of them; a read goes to the one
+// expected to finish it first, given where its head is and the work
+// already sent to it.
+
+const int MaxDisks = 8;			// Most disks in a volume
+
+class SynchRequest;
+
+// One of the disks of a volume, with what is needed to wait for it.
+
+class DiskUnit {
+  public:
+    DiskUnit(char *name, char *baseName);
+    					// Initialize the disk in UNIX file
+					// "name" (see Disk::Disk)
+    ~DiskUnit();
+
+    void Request(int sectorNumber, char *data, int numSectors,
+		 bool writing, SynchRequest *request);
+    					// Send a request to the disk; the
+					// caller holds one of the "slots"
+    int Predict(int sectorNumber, int numSectors, bool writing);
+    					// How long until a request sent now
+					// would be done, counting the requests
+					// already sent or waiting for a slot
+
+    Disk *disk;				// Raw disk device
+    Semaphore *slots;			// Only so many read/write requests
+					// can be sent to a disk at a time
+					// (kernel->queueDepth)
+    int busyUntil;			// When the requests sent or waiting
+					// are expected to be done
+
+    int numRequests;			// Statistics: requests sent,
+    int numReads, numWrites;		// sectors read and written,
+    int busyTicks;			// time requests spent in the disk,
+    int numReadRequests, readTicks;	// and how long reads took
+};
 
-class SynchDisk : public CallBackObj {
+// A request sent to one disk, for the thread that sent it to wait on.
+
+class SynchRequest : public CallBackObj {
+  public:
+    SynchRequest(DiskUnit *unit, bool writing);
+    ~SynchRequest();
+
+    void CallBack();			// Called by the disk when done:
+					// wake up the waiting thread
+    void Wait();			// Wait until the disk is done
+
+  private:
+    DiskUnit *unit;			// The disk it was sent to
+    bool writing;			// Is it a write?
+    int startTicks;			// When it was sent
+    Semaphore *semaphore; 		// To synchronize requesting thread 
+					// with the interrupt handler
+};
+
+class SynchDisk {
   public:
     SynchDisk();    		        // Initialize a synchronous disk,
-					// by initializing the raw Disk.
+					// by initializing the raw Disk(s):
+					// kernel->numDisks of them, striped
+					// kernel->stripeUnit sectors at a time
+					// or, if kernel->mirrored, mirrored;
+					// recording requests in
+					// kernel->traceFile, if not NULL
     ~SynchDisk();			// De-allocate the synch disk data
     
     void ReadSector(int sectorNumber, char* data);
@@ -39,17 +119,36 @@ class SynchDisk : public CallBackObj {
     					// Disk::ReadRequest/WriteRequest and
 					// then wait until the request is done.
     void WriteSector(int sectorNumber, char* data);
+    void ReadSectors(int sectorNumber, char* data, int numSectors);
+    void WriteSectors(int sectorNumber, char* data, int numSectors);
+    					// The same, for a run of
+					// "numSectors" consecutive sectors
+    void Flush();			// Return only once the write caches
+					// of all disks are on the media
     
-    void CallBack();			// Called by the disk device interrupt
-					// handler, to signal that the
-					// current disk operation is complete.
+    int EstimateLatency(int *sectors, int numSectors);
+    					// How long reading "sectors" in
+					// order would take (see disk.h)
+
+    void Print();			// Print statistics for each disk
 
   private:
-    Disk *disk;		  		// Raw disk device
-    Semaphore *semaphore; 		// To synchronize requesting thread 
-					// with the interrupt handler
-    Lock *lock;		  		// Only one read/write request
-					// can be sent to the disk at a time
+    int numDisks;			// How many disks the sectors are
+					// striped over
+    int stripeUnit;			// Consecutive sectors on each disk
+    bool mirrored;			// Or, does each disk hold all sectors?
+    DiskUnit *units[MaxDisks];		// The disks
+    DiskTrace *trace;			// Where requests are recorded, or
+					// NULL
+
+    int ChooseMirror(int sectorNumber, int numSectors);
+    					// Which disk to read a run from
+    int MapSector(int sectorNumber, int *unit);
+    					// Which disk, and which sector on it,
+					// holds "sectorNumber"
+    void Transfer(int sectorNumber, char *data, int numSectors,
+		  bool writing);	// Read/write a run of sectors,
+					// spread over the disks
 };
 
 #endif // SYNCHDISK_H
@@ -105,13 +105,18 @@ Bitmap::Test(int which) const
 //	(In other words, find and allocate a bit.)
 //
 //	If no bits are clear, return -1.
+//
+//	Words with every bit set are skipped whole, so that a nearly full
+//	map of a big disk is not searched a bit at a time.
 //----------------------------------------------------------------------
 
 int 
 Bitmap::FindAndSet() 
 {
     for (int i = 0; i < numBits; i++) {
-	if (!Test(i)) {
+	if (i % BitsInWord == 0 && map[i / BitsInWord] == ~0u) {
+	    i += BitsInWord - 1;
+	} else if (!Test(i)) {
 	    Mark(i);
 	    return i;
 	}
@@ -128,14 +133,38 @@ Bitmap::FindAndSet()
 int 
 Bitmap::NumClear() const
 {
-    int count = 0;
+    int count = numBits;
+
+    for (int i = 0; i < numWords; i++) {
+	count -= __builtin_popcount(map[i]);	// bits past numBits are clear
+    }
+    return count;
+}
+
+//----------------------------------------------------------------------
+// Bitmap::FindRun
+// 	Return the number of the first bit of the first run of "count"
+//	consecutive clear bits.  The bits are not changed.
+//
+//	If there is no such run, return -1.
+//----------------------------------------------------------------------
+
+int 
+Bitmap::FindRun(int count) const
+{
+    int start = 0;
 
     for (int i = 0; i < numBits; i++) {
-	if (!Test(i)) {
-	    count++;
+	if (i % BitsInWord == 0 && map[i / BitsInWord] == ~0u) {
+	    i += BitsInWord - 1;	// a whole word in use
+	    start = i + 1;
+	} else if (Test(i)) {
+	    start = i + 1;
+	} else if (i - start + 1 == count) {
+	    return start;
 	}
     }
-    return count;
+    return -1;
 }
 
 //----------------------------------------------------------------------
@@ -177,6 +206,7 @@ Bitmap::SelfTest()
     ASSERT(Test(0) && Test(31));
 
     ASSERT(FindAndSet() == 1);
+    ASSERT(FindRun(29) == 2);
     Clear(0);
     Clear(1);
     Clear(31);
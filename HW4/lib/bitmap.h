@@ -43,6 +43,9 @@ class Bitmap {
 				// effect, set the bit. 
 				// If no bits are clear, return -1.
     int NumClear() const;	// Return the number of clear bits
+    int FindRun(int count) const;
+				// Return the # of the first of "count"
+				// consecutive clear bits, or -1
 
     void Print() const;		// Print contents of bitmap
     void SelfTest();		// Test whether bitmap is working
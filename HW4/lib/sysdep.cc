@@ -32,6 +32,8 @@
 #include <sys/file.h>
 #include <sys/socket.h>
 #include <sys/un.h>
+#include <sys/stat.h>
+#include <dirent.h>
 #include <cerrno>
 
 #ifdef SOLARIS
@@ -247,6 +249,42 @@ DeallocBoundedArray(char *ptr, int size)
 }
 #endif
 
+//----------------------------------------------------------------------
+// AllocExecutable
+// 	Return memory that host code can be written into and then run
+//	(see Machine::Compile), or NULL if the host won't give us any.
+//
+//	"size" -- amount of space needed (in bytes)
+//----------------------------------------------------------------------
+
+char *
+AllocExecutable(int size)
+{
+#ifdef NO_MPROT
+    return NULL;
+#else
+    void *ptr = mmap(NULL, size, PROT_READ | PROT_WRITE | PROT_EXEC,
+			MAP_PRIVATE | MAP_ANON, -1, 0);
+
+    if (ptr == MAP_FAILED)
+	return NULL;
+    return (char *) ptr;
+#endif
+}
+
+//----------------------------------------------------------------------
+// DeallocExecutable
+// 	Give back memory from AllocExecutable.
+//----------------------------------------------------------------------
+
+void
+DeallocExecutable(char *ptr, int size)
+{
+#ifndef NO_MPROT
+    munmap(ptr, size);
+#endif
+}
+
 //----------------------------------------------------------------------
 // PollFile
 // 	Check open file or open socket to see if there are any 
@@ -330,6 +368,23 @@ OpenForReadWrite(char *name, bool crashOnError)
     return fd;
 }
 
+//----------------------------------------------------------------------
+// OpenForRead
+// 	Open a file for reading only.
+//	Return the file descriptor, or error if it doesn't exist.
+//
+//	"name" -- file name
+//----------------------------------------------------------------------
+
+int
+OpenForRead(char *name, bool crashOnError)
+{
+    int fd = open(name, O_RDONLY, 0);
+
+    ASSERT(!crashOnError || fd >= 0);
+    return fd;
+}
+
 //----------------------------------------------------------------------
 // Read
 // 	Read characters from an open file.  Abort if read fails.
@@ -420,6 +475,55 @@ Unlink(char *name)
     return unlink(name);
 }
 
+//----------------------------------------------------------------------
+// OpenDirectory
+// 	Open a directory for reading its entries.  Return NULL on error.
+//----------------------------------------------------------------------
+
+void *
+OpenDirectory(char *name)
+{
+    return (void *) opendir(name);
+}
+
+//----------------------------------------------------------------------
+// ReadDirectory
+// 	Return the name of the next entry of an open directory, or NULL
+//	if there are no more.  The name is only good until the next call.
+//----------------------------------------------------------------------
+
+char *
+ReadDirectory(void *dir)
+{
+    struct dirent *entry = readdir((DIR *) dir);
+
+    return (entry == NULL) ? NULL : entry->d_name;
+}
+
+//----------------------------------------------------------------------
+// CloseDirectory
+// 	Close a directory opened with OpenDirectory.
+//----------------------------------------------------------------------
+
+void
+CloseDirectory(void *dir)
+{
+    (void) closedir((DIR *) dir);
+}
+
+//----------------------------------------------------------------------
+// IsDirectory
+// 	Return TRUE if "name" is a directory.
+//----------------------------------------------------------------------
+
+bool
+IsDirectory(char *name)
+{
+    struct stat info;
+
+    return stat(name, &info) == 0 && S_ISDIR(info.st_mode);
+}
+
 //----------------------------------------------------------------------
 // OpenSocket
 // 	Open an interprocess communication (IPC) connection.  For now, 
@@ -19,25 +19,18 @@
 #include "sysdep.h"
 #include "main.h"
 
-// We put a magic number at the front of the UNIX file representing the
-// disk, to make it less likely we will accidentally treat a useful file 
-// as a disk (which would probably trash the file's contents).
-
-const int MagicNumber = 0x456789ab;
-const int MagicSize = sizeof(int);
-const int DiskSize = (MagicSize + (NumSectors * SectorSize));
-
-
 //----------------------------------------------------------------------
 // Disk::Disk()
 // 	Initialize a simulated disk.  Open the UNIX file (creating it
 //	if it doesn't exist), and check the magic number to make sure it's 
 // 	ok to treat it as Nachos disk storage.
 //
+//	"name" -- the UNIX file, eg. DISK_0
+//	"baseName" -- the base image of a new overlay, or NULL
 //	"toCall" -- object to call when disk read/write request completes
 //----------------------------------------------------------------------
 
-Disk::Disk(CallBackObj *toCall)
+Disk::Disk(char *name, char *baseName, CallBackObj *toCall)
 {
     int magicNum;
     int tmp = 0;
@@ -46,12 +39,31 @@ Disk::Disk(CallBackObj *toCall)
     callWhenDone = toCall;
     lastSector = 0;
     bufferInit = 0;
+    pending = new List<DiskRequest *>;
+    current = NULL;
+    baseFileno = -1;
+    overlay = NULL;
+    cacheSize = 0;
+    dirty = NULL;
+    dirtyList = new List<int>;
+    flushes = new List<CallBackObj *>;
+    numCachedWrites = numCachedReads = numWriteThrough = 0;
+    numDestaged = numFlushes = 0;
     
-    sprintf(diskname,"DISK_%d",kernel->hostName);
+    ASSERT(strlen(name) < sizeof(diskname));
+    strcpy(diskname, name);
+    if (baseName != NULL) {		// new overlay, replacing any
+	CreateOverlay(baseName);	// old one
+	active = FALSE;
+	return;
+    }
     fileno = OpenForReadWrite(diskname, FALSE);
     if (fileno >= 0) {		 	// file exists, check magic number 
 	Read(fileno, (char *) &magicNum, MagicSize);
-	ASSERT(magicNum == MagicNumber);
+	if (magicNum == OverlayMagicNumber)
+	    OpenOverlay();
+	else
+	    ASSERT(magicNum == MagicNumber);
     } else {				// file doesn't exist, create it
         fileno = OpenForWrite(diskname);
 	magicNum = MagicNumber;  
@@ -72,7 +84,168 @@ Disk::Disk(CallBackObj *toCall)
 
 Disk::~Disk()
 {
+    while (!pending->IsEmpty())
+	delete pending->RemoveFront();
+    delete pending;
+    delete current;
+    delete dirtyList;
+    delete flushes;
+    delete [] dirty;
     Close(fileno);
+    if (overlay != NULL) {
+	Close(baseFileno);
+	delete [] overlay;
+    }
+}
+
+//----------------------------------------------------------------------
+// Disk::EnableWriteCache
+// 	Give the disk a write cache that holds up to "numSectors"
+//	sectors (see disk.h).  The cache starts out empty.
+//----------------------------------------------------------------------
+
+void
+Disk::EnableWriteCache(int numSectors)
+{
+    ASSERT(numSectors > 0 && dirty == NULL);
+    cacheSize = numSectors;
+    dirty = new bool[NumSectors];
+    for (int i = 0; i < NumSectors; i++)
+	dirty[i] = FALSE;
+}
+
+//----------------------------------------------------------------------
+// Disk::CreateOverlay
+// 	Make the disk's file a new, empty overlay on the image "baseName": the
+//	simulated disk starts out with exactly the contents of the base.
+//	The base can't be the disk's own file, which is about to be
+//	emptied.
+//----------------------------------------------------------------------
+
+void
+Disk::CreateOverlay(char *baseName)
+{
+    char header[SectorSize];
+
+    DEBUG(dbgDisk, "Starting an overlay on " << baseName);
+    ASSERT((int) strlen(baseName) < OverlayNameSize);
+    ASSERT(strcmp(baseName, diskname) != 0);
+    OpenBase(baseName);
+    fileno = OpenForWrite(diskname);
+    bzero(header, SectorSize);
+    *(int *) header = OverlayMagicNumber;
+    strcpy(header + MagicSize, baseName);
+    WriteFile(fileno, header, SectorSize);
+    overlayEnd = SectorSize;
+}
+
+//----------------------------------------------------------------------
+// Disk::OpenOverlay
+// 	The disk's file is an overlay, and its magic number has been read.  Open
+//	the base image it names, and note where each sector in the
+//	overlay is kept.
+//----------------------------------------------------------------------
+
+void
+Disk::OpenOverlay()
+{
+    char baseName[OverlayNameSize];
+    char record[OverlayRecordSize];
+    int sector;
+
+    Read(fileno, baseName, OverlayNameSize);
+    baseName[OverlayNameSize - 1] = '\0';
+    OpenBase(baseName);
+    overlayEnd = SectorSize;
+    while (ReadPartial(fileno, record, OverlayRecordSize) == OverlayRecordSize) {
+	sector = *(int *) record;
+	ASSERT(sector >= 0 && sector < NumSectors);
+	overlay[sector] = overlayEnd + sizeof(int);
+	overlayEnd += OverlayRecordSize;
+    }
+    DEBUG(dbgDisk, "Overlay on " << baseName << " holds "
+		<< (overlayEnd - SectorSize) / OverlayRecordSize << " sectors");
+}
+
+//----------------------------------------------------------------------
+// Disk::OpenBase
+// 	Open the base image of an overlay, read-only, so that other
+//	overlays can share it.  It must be a whole disk, not another
+//	overlay.
+//----------------------------------------------------------------------
+
+void
+Disk::OpenBase(char *baseName)
+{
+    int magicNum;
+
+    baseFileno = OpenForRead(baseName, TRUE);
+    Read(baseFileno, (char *) &magicNum, MagicSize);
+    ASSERT(magicNum == MagicNumber);
+    overlay = new int[NumSectors];
+    for (int i = 0; i < NumSectors; i++)
+	overlay[i] = -1;
+}
+
+//----------------------------------------------------------------------
+// Disk::FetchSectors/StoreSectors
+// 	Copy the contents of "numSectors" sectors, starting at
+//	"sectorNumber", out of or into the UNIX file.  With an overlay,
+//	a sector is read from the overlay if it has ever been written,
+//	and from the base image otherwise; runs of sectors that are only
+//	in the base are read in one piece.  A sector is written in place
+//	if it is already in the overlay, or else appended to it.
+//----------------------------------------------------------------------
+
+void
+Disk::FetchSectors(int sectorNumber, char *data, int numSectors)
+{
+    int run;
+
+    if (overlay == NULL) {
+	Lseek(fileno, SectorSize * sectorNumber + MagicSize, 0);
+	Read(fileno, data, SectorSize * numSectors);
+	return;
+    }
+    for (int i = 0; i < numSectors; i += run) {
+	run = 1;
+	if (overlay[sectorNumber + i] >= 0) {
+	    Lseek(fileno, overlay[sectorNumber + i], 0);
+	    Read(fileno, data + i * SectorSize, SectorSize);
+	    continue;
+	}
+	while (i + run < numSectors && overlay[sectorNumber + i + run] < 0)
+	    run++;
+	Lseek(baseFileno, SectorSize * (sectorNumber + i) + MagicSize, 0);
+	Read(baseFileno, data + i * SectorSize, SectorSize * run);
+    }
+}
+
+void
+Disk::StoreSectors(int sectorNumber, char *data, int numSectors)
+{
+    char record[OverlayRecordSize];
+    int sector;
+
+    if (overlay == NULL) {
+	Lseek(fileno, SectorSize * sectorNumber + MagicSize, 0);
+	WriteFile(fileno, data, SectorSize * numSectors);
+	return;
+    }
+    for (int i = 0; i < numSectors; i++) {
+	sector = sectorNumber + i;
+	if (overlay[sector] >= 0) {
+	    Lseek(fileno, overlay[sector], 0);
+	    WriteFile(fileno, data + i * SectorSize, SectorSize);
+	} else {
+	    *(int *) record = sector;
+	    bcopy(data + i * SectorSize, record + sizeof(int), SectorSize);
+	    Lseek(fileno, overlayEnd, 0);
+	    WriteFile(fileno, record, OverlayRecordSize);
+	    overlay[sector] = overlayEnd + sizeof(int);
+	    overlayEnd += OverlayRecordSize;
+	}
+    }
 }
 
 //----------------------------------------------------------------------
@@ -106,60 +279,338 @@ PrintSector (bool writing, int sector, char *data)
 //	Note that a disk only allows an entire sector to be read/written,
 //	not part of a sector.
 //
+//	A request can also cover a run of consecutive sectors; the disk
+//	positions the head once, then transfers them one after another as
+//	they pass under it.  The disk statistics count sectors, not requests.
+//
+//	The data is moved as soon as the request is accepted, so requests
+//	see each other's data in the order they were sent, whatever order
+//	the head serves them in; only the interrupt waits.  For the same
+//	reason, the write cache only changes when requests complete, not
+//	what they read.
+//
 //	"sectorNumber" -- the disk sector to read/write
 //	"data" -- the bytes to be written, the buffer to hold the incoming bytes
+//	"numSectors" -- the number of sectors in the run
+//	"toCall" -- who to call back when the request is done; if not
+//		given, the object the disk was created with
 //----------------------------------------------------------------------
 
 void
 Disk::ReadRequest(int sectorNumber, char* data)
 {
-    int ticks = ComputeLatency(sectorNumber, FALSE);
+    ReadRequest(sectorNumber, data, 1, callWhenDone);
+}
+
+void
+Disk::WriteRequest(int sectorNumber, char* data)
+{
+    WriteRequest(sectorNumber, data, 1, callWhenDone);
+}
+
+void
+Disk::ReadRequest(int sectorNumber, char* data, int numSectors)
+{
+    ReadRequest(sectorNumber, data, numSectors, callWhenDone);
+}
+
+void
+Disk::WriteRequest(int sectorNumber, char* data, int numSectors)
+{
+    WriteRequest(sectorNumber, data, numSectors, callWhenDone);
+}
 
-    ASSERT(!active);				// only one request at a time
-    ASSERT((sectorNumber >= 0) && (sectorNumber < NumSectors));
+void
+Disk::ReadRequest(int sectorNumber, char* data, int numSectors,
+		  CallBackObj *toCall)
+{
+    bool cached;
+
+    ASSERT((sectorNumber >= 0) && (numSectors > 0)
+		&& (sectorNumber + numSectors <= NumSectors));
     
-    DEBUG(dbgDisk, "Reading from sector " << sectorNumber);
-    Lseek(fileno, SectorSize * sectorNumber + MagicSize, 0);
-    Read(fileno, data, SectorSize);
+    DEBUG(dbgDisk, "Reading " << numSectors << " sectors from sector " << sectorNumber);
+    FetchSectors(sectorNumber, data, numSectors);
     if (debug->IsEnabled('d'))
-	PrintSector(FALSE, sectorNumber, data);
+	for (int i = 0; i < numSectors; i++)
+	    PrintSector(FALSE, sectorNumber + i, data + i * SectorSize);
     
-    active = TRUE;
-    UpdateLast(sectorNumber);
-    kernel->stats->numDiskReads++;
-    kernel->interrupt->Schedule(this, ticks, DiskInt);
+    kernel->stats->numDiskReads += numSectors;
+    cached = InCache(sectorNumber, numSectors);
+    if (cached)
+	numCachedReads += numSectors;
+    Queue(sectorNumber, numSectors, FALSE, cached, toCall);
 }
 
 void
-Disk::WriteRequest(int sectorNumber, char* data)
+Disk::WriteRequest(int sectorNumber, char* data, int numSectors,
+		   CallBackObj *toCall)
 {
-    int ticks = ComputeLatency(sectorNumber, TRUE);
-
-    ASSERT(!active);
-    ASSERT((sectorNumber >= 0) && (sectorNumber < NumSectors));
+    ASSERT((sectorNumber >= 0) && (numSectors > 0)
+		&& (sectorNumber + numSectors <= NumSectors));
     
-    DEBUG(dbgDisk, "Writing to sector " << sectorNumber);
-    Lseek(fileno, SectorSize * sectorNumber + MagicSize, 0);
-    WriteFile(fileno, data, SectorSize);
+    DEBUG(dbgDisk, "Writing " << numSectors << " sectors to sector " << sectorNumber);
+    StoreSectors(sectorNumber, data, numSectors);
     if (debug->IsEnabled('d'))
-	PrintSector(TRUE, sectorNumber, data);
+	for (int i = 0; i < numSectors; i++)
+	    PrintSector(TRUE, sectorNumber + i, data + i * SectorSize);
     
+    kernel->stats->numDiskWrites += numSectors;
+    Queue(sectorNumber, numSectors, TRUE, CacheWrite(sectorNumber, numSectors),
+	  toCall);
+}
+
+//----------------------------------------------------------------------
+// Disk::FlushRequest
+// 	Ask for the write cache to be emptied onto the media.  "toCall"
+//	is called back once every sector that was in the cache has been
+//	destaged -- at once (well, in a tick) if it is empty already.
+//----------------------------------------------------------------------
+
+void
+Disk::FlushRequest(CallBackObj *toCall)
+{
+    bool destaging = active && current->toCall == NULL;
+
+    numFlushes++;
+    if (dirtyList->IsEmpty() && !destaging) {
+	kernel->interrupt->Schedule(toCall, 1, DiskInt);
+	return;
+    }
+    DEBUG(dbgDisk, "Flushing " << dirtyList->NumInList() << " cached sectors");
+    flushes->Append(toCall);
+    if (!active)
+	StartNext();
+}
+
+//----------------------------------------------------------------------
+// Disk::InCache
+// 	Return whether sectors "sectorNumber" up to "sectorNumber +
+//	numSectors - 1" are all in the write cache.
+//----------------------------------------------------------------------
+
+bool
+Disk::InCache(int sectorNumber, int numSectors)
+{
+    if (dirty == NULL)
+	return FALSE;
+    for (int i = 0; i < numSectors; i++)
+	if (!dirty[sectorNumber + i])
+	    return FALSE;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Disk::CacheWrite
+// 	Put the sectors of a write in the write cache, and return TRUE;
+//	or, if there is no room for them (sectors already there take no
+//	more room) or a flush is waiting, return FALSE: the write goes to
+//	the media.  Then any of its sectors still in the cache are
+//	dropped from it, since the write replaces them.
+//----------------------------------------------------------------------
+
+bool
+Disk::CacheWrite(int sectorNumber, int numSectors)
+{
+    int needed = 0;
+
+    if (dirty == NULL)
+	return FALSE;
+    for (int i = 0; i < numSectors; i++)
+	if (!dirty[sectorNumber + i])
+	    needed++;
+    if (flushes->IsEmpty()
+		&& (int) dirtyList->NumInList() + needed <= cacheSize) {
+	for (int i = 0; i < numSectors; i++)
+	    if (!dirty[sectorNumber + i]) {
+		dirty[sectorNumber + i] = TRUE;
+		dirtyList->Append(sectorNumber + i);
+	    }
+	numCachedWrites += numSectors;
+	return TRUE;
+    }
+    for (int i = 0; i < numSectors; i++)
+	if (dirty[sectorNumber + i]) {
+	    dirty[sectorNumber + i] = FALSE;
+	    dirtyList->Remove(sectorNumber + i);
+	}
+    numWriteThrough += numSectors;
+    return FALSE;
+}
+
+//----------------------------------------------------------------------
+// Disk::Queue
+// 	Accept a request, and start it at once if the disk is idle.
+//	"cached" says the request is served from the write cache.
+//
+//	A destage in progress doesn't count against MaxQueueDepth: it
+//	holds no place that SynchDisk handed out.
+//----------------------------------------------------------------------
+
+void
+Disk::Queue(int sectorNumber, int numSectors, bool writing, bool cached,
+	    CallBackObj *toCall)
+{
+    DiskRequest *request = new DiskRequest;
+    bool holding = active && current->toCall != NULL;
+
+    ASSERT(pending->NumInList() + (holding ? 1 : 0) < MaxQueueDepth);
+    request->sector = sectorNumber;
+    request->numSectors = numSectors;
+    request->writing = writing;
+    request->toCall = toCall;
+    request->cached = cached;
+    request->passedOver = 0;
+    request->queued = kernel->stats->totalTicks;
+    pending->Append(request);
+    if (!active)
+	StartNext();
+}
+
+//----------------------------------------------------------------------
+// Disk::StartNext
+// 	Choose the pending request with the shortest positioning time
+//	(seek plus rotational delay, as ComputeLatency works it out from
+//	where the head is now), unless one has been passed over too often
+//	already; then schedule the interrupt for when it will be done.
+//	A request served from the write cache only takes its transfer
+//	time, and leaves the head where it is.
+//
+//	If there are no requests, or a flush is waiting, destage the
+//	write cache instead.
+//----------------------------------------------------------------------
+
+void
+Disk::StartNext()
+{
+    DiskRequest *request, *best = NULL;
+    int bestTicks = 0, ticks;
+
+    if (!dirtyList->IsEmpty() && (pending->IsEmpty() || !flushes->IsEmpty())) {
+	StartDestage();
+	return;
+    }
+    for (ListIterator<DiskRequest *> iter(pending); !iter.IsDone(); iter.Next()) {
+	request = iter.Item();
+	if (request->cached)
+	    ticks = RotationTime;
+	else
+	    ticks = ComputeLatency(request->sector, request->writing);
+	if (request->passedOver >= MaxPassOvers) {
+	    best = request;			// the oldest such goes next
+	    bestTicks = ticks;
+	    break;
+	}
+	if (best == NULL || ticks < bestTicks) {
+	    best = request;
+	    bestTicks = ticks;
+	}
+    }
+    ASSERT(best != NULL);
+    pending->Remove(best);
+    for (ListIterator<DiskRequest *> iter(pending); !iter.IsDone(); iter.Next())
+	iter.Item()->passedOver++;
+
+    DEBUG(dbgDisk, "Starting request for sector " << best->sector << ", " 
+		<< pending->NumInList() << " more pending");
     active = TRUE;
-    UpdateLast(sectorNumber);
-    kernel->stats->numDiskWrites++;
+    current = best;
+    if (best->cached) {
+	ticks = best->numSectors * RotationTime;
+	RecordLatency(best, ticks);
+    } else {
+	ticks = bestTicks + RunLatency(best->sector, best->numSectors);
+	RecordLatency(best, ticks);
+	UpdateLast(best->sector + best->numSectors - 1);
+    }
+    kernel->interrupt->Schedule(this, ticks, DiskInt);
+}
+
+//----------------------------------------------------------------------
+// Disk::StartDestage
+// 	Take the cached sector the head can reach soonest, and the
+//	cached sectors just after it, out of the write cache, and start
+//	writing them to the media.  Nobody is called back when this is
+//	done.
+//----------------------------------------------------------------------
+
+void
+Disk::StartDestage()
+{
+    DiskRequest *request = new DiskRequest;
+    int sector, best = -1, bestTicks = 0, ticks, count = 0;
+
+    for (ListIterator<int> iter(dirtyList); !iter.IsDone(); iter.Next()) {
+	sector = iter.Item();
+	ticks = ComputeLatency(sector, TRUE);
+	if (best == -1 || ticks < bestTicks) {
+	    best = sector;
+	    bestTicks = ticks;
+	}
+    }
+    ASSERT(best != -1);
+    while (best + count < NumSectors && dirty[best + count]) {
+	dirty[best + count] = FALSE;
+	dirtyList->Remove(best + count);
+	count++;
+    }
+    numDestaged += count;
+
+    DEBUG(dbgDisk, "Destaging " << count << " sectors from sector " << best 
+		<< ", " << dirtyList->NumInList() << " more cached");
+    request->sector = best;
+    request->numSectors = count;
+    request->writing = TRUE;
+    request->toCall = NULL;
+    request->cached = FALSE;
+    request->passedOver = 0;
+    request->queued = kernel->stats->totalTicks;
+    active = TRUE;
+    current = request;
+    ticks = bestTicks + RunLatency(best, count);
+    RecordLatency(request, ticks);
+    UpdateLast(best + count - 1);
     kernel->interrupt->Schedule(this, ticks, DiskInt);
 }
 
+//----------------------------------------------------------------------
+// Disk::FinishFlushes
+// 	If the write cache is empty, and nothing is being destaged, call
+//	back every flush that was waiting for it.
+//----------------------------------------------------------------------
+
+void
+Disk::FinishFlushes()
+{
+    if (!dirtyList->IsEmpty() || (active && current->toCall == NULL))
+	return;
+    while (!flushes->IsEmpty())
+	flushes->RemoveFront()->CallBack();
+}
+
 //----------------------------------------------------------------------
 // Disk::CallBack()
 // 	Called by the machine simulation when the disk interrupt occurs.
+//	Start the next request, or destage more of the write cache, if
+//	there is anything to do; then tell whoever sent this request that
+//	it is done.  A destage was sent by nobody.  Either may have emptied
+//	the cache (a write that bypasses it drops the sectors it replaces),
+//	so call back any flush that was waiting for that.
 //----------------------------------------------------------------------
 
 void
 Disk::CallBack ()
 { 
+    DiskRequest *done = current;
+
     active = FALSE;
-    callWhenDone->CallBack();
+    current = NULL;
+    if (!pending->IsEmpty() || !dirtyList->IsEmpty())
+	StartNext();
+    if (done->toCall != NULL)
+	done->toCall->CallBack();
+    FinishFlushes();
+    delete done;
 }
 
 //----------------------------------------------------------------------
@@ -175,12 +626,25 @@ Disk::CallBack ()
 
 int
 Disk::TimeToSeek(int newSector, int *rotation) 
+{
+    return TimeToSeek(newSector, lastSector, kernel->stats->totalTicks, 
+							rotation);
+}
+
+//----------------------------------------------------------------------
+// Disk::TimeToSeek()
+//	Same as above, but for a head sitting over "oldSector" at time
+//	"now", rather than where the head really is.
+//----------------------------------------------------------------------
+
+int
+Disk::TimeToSeek(int newSector, int oldSector, int now, int *rotation) 
 {
     int newTrack = newSector / SectorsPerTrack;
-    int oldTrack = lastSector / SectorsPerTrack;
+    int oldTrack = oldSector / SectorsPerTrack;
     int seek = abs(newTrack - oldTrack) * SeekTime;
 				// how long will seek take?
-    int over = (kernel->stats->totalTicks + seek) % RotationTime; 
+    int over = (now + seek) % RotationTime; 
 				// will we be in the middle of a sector when
 				// we finish the seek?
 
@@ -229,24 +693,133 @@ Disk::ModuloDiff(int to, int from)
 int
 Disk::ComputeLatency(int newSector, bool writing)
 {
-    int rotation;
-    int seek = TimeToSeek(newSector, &rotation);
-    int timeAfter = kernel->stats->totalTicks + seek + rotation;
+    int seek, rotation;
+    bool bufferHit;
+
+    return Latency(newSector, writing, &seek, &rotation, &bufferHit);
+}
+
+//----------------------------------------------------------------------
+// Disk::Latency()
+// 	Same as ComputeLatency, but also return the parts of the latency:
+//	"*seek" and "*rotation" ticks of seek and rotational delay, and
+//	whether the sector comes from the track buffer, "*bufferHit".
+//	The rest is the transfer time.
+//----------------------------------------------------------------------
+
+int
+Disk::Latency(int newSector, bool writing, int *seek, int *rotation,
+	      bool *bufferHit)
+{
+    int timeAfter;
+
+    *seek = TimeToSeek(newSector, rotation);
+    *bufferHit = FALSE;
+    timeAfter = kernel->stats->totalTicks + *seek + *rotation;
 
 #ifndef NOTRACKBUF	// turn this on if you don't want the track buffer stuff
     // check if track buffer applies
-    if ((writing == FALSE) && (seek == 0) 
+    if ((writing == FALSE) && (*seek == 0) 
 		&& (((timeAfter - bufferInit) / RotationTime) 
 	     		> ModuloDiff(newSector, bufferInit / RotationTime))) {
         DEBUG(dbgDisk, "Request latency = " << RotationTime);
+	*rotation = 0;
+	*bufferHit = TRUE;
 	return RotationTime; // time to transfer sector from the track buffer
     }
 #endif
 
-    rotation += ModuloDiff(newSector, timeAfter / RotationTime) * RotationTime;
+    *rotation += ModuloDiff(newSector, timeAfter / RotationTime) * RotationTime;
+
+    DEBUG(dbgDisk, "Request latency = " << (*seek + *rotation + RotationTime));
+    return(*seek + *rotation + RotationTime);
+}
+
+//----------------------------------------------------------------------
+// Disk::RecordLatency()
+// 	Note in the statistics where the time of a request that is being
+//	started, and will take "ticks", goes: how long it waited to be
+//	started (unless it is a destage, which nobody waits for); how far
+//	the head moves, and how long that takes; the rotational delay;
+//	and the transfer of its sectors, including any seeks from one
+//	track to the next along the way.  Must be called before the head
+//	is moved (UpdateLast).
+//----------------------------------------------------------------------
+
+void
+Disk::RecordLatency(DiskRequest *request, int ticks)
+{
+    Statistics *stats = kernel->stats;
+    int seek = 0, rotation = 0, tracks = 0;
+    bool bufferHit = FALSE;
+
+    if (!request->cached) {
+	Latency(request->sector, request->writing, &seek, &rotation, &bufferHit);
+	tracks = abs(request->sector / SectorsPerTrack 
+				- lastSector / SectorsPerTrack);
+    }
+    if (request->toCall != NULL)
+	stats->diskQueueWait->Record(stats->totalTicks - request->queued);
+    stats->diskSeekTracks->Record(tracks);
+    stats->diskSeekTime->Record(seek);
+    stats->diskRotation->Record(rotation);
+    stats->diskTransfer->Record(ticks - seek - rotation);
+    stats->diskService->Record(ticks);
+    if (bufferHit)
+	stats->numTrackBufferHits++;
+}
+
+//----------------------------------------------------------------------
+// Disk::RunLatency()
+// 	Return how long it takes to transfer the rest of a run of
+//	"numSectors" consecutive sectors, once the first one is done: one
+//	rotation time per sector, plus a one-track seek at every track
+//	boundary.  (Tracks are assumed to be skewed so that the next
+//	sector arrives under the head just as the seek completes.)
+//----------------------------------------------------------------------
+
+int
+Disk::RunLatency(int firstSector, int numSectors)
+{
+    int lastSector = firstSector + numSectors - 1;
+    int crossings = lastSector / SectorsPerTrack - firstSector / SectorsPerTrack;
 
-    DEBUG(dbgDisk, "Request latency = " << (seek + rotation + RotationTime));
-    return(seek + rotation + RotationTime);
+    return (numSectors - 1) * RotationTime + crossings * SeekTime;
+}
+
+//----------------------------------------------------------------------
+// Disk::EstimateLatency()
+// 	Return how long it would take to read "sectors", in order, with
+//	each request sent as soon as the previous one completes, starting
+//	with the head over the first sector.  Nothing is read, and the
+//	state of the disk is not changed.
+//
+//	Uses the same seek and rotation model as ComputeLatency, but
+//	leaves out the track buffer, so that the estimate depends only
+//	on where the sectors are, not on what was read before.  Used by
+//	the file system to decide whether moving a file's data is
+//	worthwhile.
+//----------------------------------------------------------------------
+
+int
+Disk::EstimateLatency(int *sectors, int numSectors)
+{
+    int now = 0, total = 0;
+    int from, seek, rotation, latency;
+
+    if (numSectors == 0)
+	return 0;
+    from = sectors[0];
+    for (int i = 0; i < numSectors; i++) {
+	seek = TimeToSeek(sectors[i], from, now, &rotation);
+	rotation += ModuloDiff(sectors[i], (now + seek + rotation) 
+						/ RotationTime) * RotationTime;
+	latency = seek + rotation + RotationTime;
+	now += latency;
+	total += latency;
+	from = sectors[i];
+    }
+    return total;
 }
 
 //----------------------------------------------------------------------
@@ -266,3 +839,22 @@ Disk::UpdateLast(int newSector)
     lastSector = newSector;
     DEBUG(dbgDisk, "Updating last sector = " << lastSector << " , " << bufferInit);
 }
+
+//----------------------------------------------------------------------
+// Disk::Print
+// 	Print what the write cache did, if the disk has one.  Sectors
+//	still in it were written to the UNIX file long ago, but not yet
+//	to the simulated media.
+//----------------------------------------------------------------------
+
+void
+Disk::Print()
+{
+    if (dirty == NULL)
+	return;
+    cout << "Write cache: " << numCachedWrites << " sectors cached, "
+	 << numWriteThrough << " written through, " << numDestaged
+	 << " destaged, " << numCachedReads << " read from cache, "
+	 << numFlushes << " flushes, " << dirtyList->NumInList()
+	 << " still cached\n";
+}
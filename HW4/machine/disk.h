@@ -20,6 +20,7 @@
 #include "copyright.h"
 #include "utility.h"
 #include "callback.h"
+#include "list.h"
 
 // The following class defines a physical disk I/O device.  The disk
 // has a single surface, split up into "tracks", and each track split
@@ -46,6 +47,42 @@
 // disks these days now come with a track buffer.
 //
 // The track buffer simulation can be disabled by compiling with -DNOTRACKBUF
+//
+// Like a real disk with "native command queueing", the disk can be sent
+// up to MaxQueueDepth requests before the first is done.  Each request
+// names the object to call back when it completes.  When the disk
+// finishes a request, it picks the pending one that it can get the head
+// to soonest (seek plus rotation) -- so requests may complete in a
+// different order than they were sent.  To keep a request from waiting
+// forever behind closer ones, one that has been passed over MaxPassOvers
+// times goes next.
+//
+// The disk can also have a "write cache": RAM on the drive that holds
+// up to a given number of sectors written but not yet on the media.
+// A write that fits in the cache is done as soon as its data has been
+// transferred, with no seek or rotational delay; a read of sectors all
+// in the cache is served the same way.  Whenever the disk has no
+// requests to serve, it "destages" the cached sectors to the media,
+// nearest first.  A write that doesn't fit goes straight to the media.
+// A "flush" asks for everything in the cache to be written to the
+// media; it completes once that is done, so a file system can use it
+// as a barrier between writes that must reach the media in order.
+// While a flush is waiting, writes bypass the cache and destaging goes
+// ahead of other requests.
+//
+// Where the time of each request goes -- waiting to be started,
+// seeking, rotational delay, transfer -- is counted in histograms kept
+// with the other statistics (see stats.h).
+//
+// A flash disk (see ssd.h) keeps its sectors the same way, but replaces
+// the timing of requests; so the routines that decide it are virtual.
+//
+// The UNIX file can also be an "overlay": a small file that holds only
+// the sectors written since it was made, on top of a read-only "base"
+// image that holds the rest.  Many overlays can share one base -- for
+// instance, a disk prepared once for a set of tests -- and throwing an
+// overlay away takes the disk back to the base.  An overlay only
+// changes where the host keeps the sectors, not the simulated timing.
 
 const int SectorSize = 128;		// number of bytes per disk sector
 const int SectorsPerTrack  = 32;	// number of sectors per disk track 
@@ -53,40 +90,166 @@ const int NumTracks = 16384;		// demo bonus
 const int NumSectors = (SectorsPerTrack * NumTracks);
 					// total # of sectors per disk
 
+// We put a magic number at the front of the UNIX file representing the
+// disk, to make it less likely we will accidentally treat a useful file 
+// as a disk (which would probably trash the file's contents).  Sector
+// "n" follows it, at byte MagicSize + n * SectorSize of the file.
+
+const int MagicNumber = 0x456789ab;
+const int MagicSize = sizeof(int);
+const int DiskSize = (MagicSize + (NumSectors * SectorSize));
+
+// An overlay file starts with its own magic number, and the name of its
+// base image; the two fill one sector.  After them comes one record per
+// sector written, in the order they were first written: the sector
+// number, then the contents of the sector.
+
+const int OverlayMagicNumber = 0x456789ac;
+const int OverlayNameSize = SectorSize - MagicSize;
+const int OverlayRecordSize = (sizeof(int) + SectorSize);
+
+const int MaxQueueDepth = 32;		// most requests a disk can hold
+const int MaxPassOvers = 16;		// most times a request can be
+					// passed over for a closer one
+
+// A request the disk has accepted, but not yet finished.
+
+class DiskRequest {
+  public:
+    int sector;				// First sector
+    int numSectors;			// How many
+    bool writing;			// Write, or read?
+    CallBackObj *toCall;		// Who to tell when it is done, or
+					// NULL if the disk is destaging its
+					// write cache
+    bool cached;			// Served from the write cache?
+    int passedOver;			// Times another went first
+    int queued;				// When it was accepted
+};
+
 class Disk : public CallBackObj {
   public:
-    Disk(CallBackObj *toCall);          // Create a simulated disk.  
-					// Invoke toCall->CallBack() 
-					// when each request completes.
-    ~Disk();				// Deallocate the disk.
+    Disk(char *name, char *baseName, CallBackObj *toCall);
+    					// Create a simulated disk, kept in
+					// the UNIX file "name".  If
+					// "baseName" isn't NULL, start a new
+					// overlay on it.  Invoke 
+					// toCall->CallBack() when each
+					// request completes.
+    virtual ~Disk();			// Deallocate the disk.
     
     void ReadRequest(int sectorNumber, char* data);
     					// Read/write an single disk sector.
 					// These routines send a request to 
     					// the disk and return immediately.
-    					// Only one request allowed at a time!
     void WriteRequest(int sectorNumber, char* data);
+    void ReadRequest(int sectorNumber, char* data, int numSectors);
+    void WriteRequest(int sectorNumber, char* data, int numSectors);
+    					// Read/write "numSectors" consecutive
+					// sectors in a single request
+    virtual void ReadRequest(int sectorNumber, char* data, int numSectors,
+			     CallBackObj *toCall);
+    virtual void WriteRequest(int sectorNumber, char* data, int numSectors,
+			      CallBackObj *toCall);
+    					// The same, but call back "toCall"
+					// when done.  All of these may be
+					// sent while other requests are
+					// pending.
+
+    void FlushRequest(CallBackObj *toCall);
+    					// Write the contents of the write
+					// cache to the media; call back
+					// "toCall" when it is empty
 
     void CallBack();			// Invoked when disk request 
-					// finishes. In turn calls, callWhenDone.
+					// finishes. In turn calls the
+					// request's "toCall", and starts
+					// the next one.
+
+    void EnableWriteCache(int numSectors);
+    					// Give the disk a write cache of
+					// "numSectors" sectors
 
-    int ComputeLatency(int newSector, bool writing);	
+    virtual int ComputeLatency(int newSector, bool writing);	
     					// Return how long a request to 
 					// newSector will take: 
 					// (seek + rotational delay + transfer)
 
+    virtual int EstimateLatency(int *sectors, int numSectors);
+    					// Return how long reading "sectors",
+					// one after another, would take on
+					// an otherwise idle disk
+
+    virtual void Print();		// Print statistics kept by the
+					// device itself, if any
+
+  protected:
+    bool active;     			// Is a disk operation in progress?
+    CallBackObj *callWhenDone;		// Invoke when a request sent without
+					// its own "toCall" finishes
+
+    void FetchSectors(int sectorNumber, char *data, int numSectors);
+    void StoreSectors(int sectorNumber, char *data, int numSectors);
+					// Move the contents of sectors to or
+					// from the UNIX file(s)
+
   private:
     int fileno;				// UNIX file number for simulated disk 
-    char diskname[32];			// name of simulated disk's file
-    CallBackObj *callWhenDone;		// Invoke when any disk request finishes
-    bool active;     			// Is a disk operation in progress?
+    char diskname[64];			// name of simulated disk's file
+    List<DiskRequest *> *pending;	// Requests waiting for the head
+    DiskRequest *current;		// The request being done, if active
     int lastSector;			// The previous disk request 
     int bufferInit;			// When the track buffer started 
 					// being loaded
+    int baseFileno;			// UNIX file number of the base image,
+					// if "fileno" is an overlay
+    int *overlay;			// Where in the overlay each sector
+					// is kept, or -1 if it is only in the
+					// base; NULL if there is no overlay
+    int overlayEnd;			// Where the next record goes
+
+    int cacheSize;			// Sectors the write cache holds, or
+					// 0 if there is no write cache
+    bool *dirty;			// Is each sector in the write cache?
+    List<int> *dirtyList;		// Sectors in the write cache
+    List<CallBackObj *> *flushes;	// Flushes waiting for the cache
+					// to be empty
+
+    int numCachedWrites;		// Statistics: sectors written to the
+    int numCachedReads;			// cache, read from it, written past
+    int numWriteThrough;		// it, destaged from it; and flushes
+    int numDestaged;
+    int numFlushes;
 
     int TimeToSeek(int newSector, int *rotate); // time to get to the new track
+    int TimeToSeek(int newSector, int oldSector, int now, int *rotate);
     int ModuloDiff(int to, int from);        // # sectors between to and from
+    int Latency(int newSector, bool writing, int *seek, int *rotation,
+		bool *bufferHit);	// ComputeLatency, in parts
+    void RecordLatency(DiskRequest *request, int ticks);
+    					// Note where the time of a request
+					// goes, in the statistics
+    int RunLatency(int firstSector, int numSectors);
+    					// time to stream the rest of a run
     void UpdateLast(int newSector);
+    void Queue(int sectorNumber, int numSectors, bool writing,
+	       bool cached, CallBackObj *toCall);
+    					// Accept a request
+    void StartNext();			// Start the pending request that
+					// can be reached soonest
+    bool CacheWrite(int sectorNumber, int numSectors);
+    					// Put sectors in the write cache,
+					// if there is room
+    bool InCache(int sectorNumber, int numSectors);
+    					// Are the sectors all in the cache?
+    void StartDestage();		// Write the nearest run of cached
+					// sectors to the media
+    void FinishFlushes();		// Call back the flushes, if the
+					// cache is now empty
+
+    void CreateOverlay(char *baseName);	// Start an empty overlay on baseName
+    void OpenOverlay();			// Find the sectors in an old overlay
+    void OpenBase(char *baseName);	// Open and check the base image
 };
 
 #endif // DISK_H
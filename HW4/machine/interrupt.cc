@@ -279,6 +279,84 @@ Interrupt::Close(int id) {
     return kernel->Close(id);
 }
 
+OpenFileId
+Interrupt::Dup(OpenFileId id)
+{
+    return kernel->Dup(id);
+}
+
+int
+Interrupt::Seek(int position, OpenFileId id)
+{
+    return kernel->Seek(position, id);
+}
+
+int
+Interrupt::PRead(char *buffer, int size, int position, OpenFileId id)
+{
+    return kernel->PRead(buffer, size, position, id);
+}
+
+int
+Interrupt::PWrite(char *buffer, int size, int position, OpenFileId id)
+{
+    return kernel->PWrite(buffer, size, position, id);
+}
+
+int
+Interrupt::ReadV(char **buffers, int *sizes, int count, OpenFileId id)
+{
+    return kernel->ReadV(buffers, sizes, count, id);
+}
+
+int
+Interrupt::WriteV(char **buffers, int *sizes, int count, OpenFileId id)
+{
+    return kernel->WriteV(buffers, sizes, count, id);
+}
+
+int
+Interrupt::CopyFile(OpenFileId src, OpenFileId dst, int offset, int len)
+{
+    return kernel->CopyFile(src, dst, offset, len);
+}
+
+int
+Interrupt::Mmap(OpenFileId id, int length)
+{
+    return kernel->Mmap(id, length);
+}
+
+int
+Interrupt::Munmap(int addr)
+{
+    return kernel->Munmap(addr);
+}
+
+#ifndef FILESYS_STUB
+int
+Interrupt::CloneFile(char *from, char *to)
+{
+    return kernel->CloneFile(from, to);
+}
+#endif
+
+//----------------------------------------------------------------------
+// Interrupt::TimeToNext
+// 	Return how many ticks from now the next pending interrupt is due,
+//	or a very large number if none is pending.  Until then, OneTick
+//	does nothing but advance the clock, so the machine can run user
+//	code for that long without calling it (see Machine::RunBlocks).
+//----------------------------------------------------------------------
+
+int
+Interrupt::TimeToNext()
+{
+    if (pending->IsEmpty())
+	return 0x7fffffff;
+    return pending->Front()->when - kernel->stats->totalTicks;
+}
+
 //----------------------------------------------------------------------
 // Interrupt::Schedule
 // 	Arrange for the CPU to be interrupted when simulated time
@@ -110,6 +110,28 @@ class Interrupt {
   int ReadFile(char *buffer, int size, OpenFileId id);
   
   int Close(int id);
+
+  OpenFileId Dup(OpenFileId id);
+
+  int Seek(int position, OpenFileId id);
+
+  int PRead(char *buffer, int size, int position, OpenFileId id);
+
+  int PWrite(char *buffer, int size, int position, OpenFileId id);
+
+  int ReadV(char **buffers, int *sizes, int count, OpenFileId id);
+
+  int WriteV(char **buffers, int *sizes, int count, OpenFileId id);
+
+  int CopyFile(OpenFileId src, OpenFileId dst, int offset, int len);
+
+  int Mmap(OpenFileId id, int length);
+
+  int Munmap(int addr);
+
+#ifndef FILESYS_STUB
+  int CloneFile(char *from, char *to);
+#endif
   
     void YieldOnReturn();	// cause a context switch on return 
 				// from an interrupt handler
@@ -132,6 +154,7 @@ class Interrupt {
     				// by the hardware device simulators.
     
     void OneTick();       	// Advance simulated time
+    int TimeToNext();		// Ticks until the next interrupt is due
 
   private:
     IntStatus level;		// are interrupts enabled or disabled?
@@ -61,6 +61,29 @@ Machine::Machine(bool debug)
     mainMemory = new char[MemorySize];
     for (i = 0; i < MemorySize; i++)
       	mainMemory[i] = 0;
+    decoded = new Instruction[MemorySize / 4];
+    for (i = 0; i < MemorySize / 4; i++) {
+	decoded[i].value = 0;		// which is what memory holds
+	decoded[i].Decode();
+    }
+    fetchEntry = NULL;
+    fetchTable = NULL;
+    fetchPage = 0;
+    blocks = new Block *[MemorySize / 4];
+    for (i = 0; i < MemorySize / 4; i++)
+	blocks[i] = NULL;
+    for (i = 0; i < NumPhysPages; i++)
+	codeFrame[i] = FALSE;
+    codeWritten = FALSE;
+    blockStamp = 0;
+    uncharged = 0;
+#if defined(__i386__) || defined(__x86_64__)
+    codeCache = AllocExecutable(CodeCacheSize);
+#else
+    codeCache = NULL;		// we only know how to emit x86 code
+#endif
+    codeUsed = 0;
+    FlushTranslations();
 #ifdef USE_TLB
     tlb = new TranslationEntry[TLBSize];
     for (i = 0; i < TLBSize; i++)
@@ -83,6 +106,17 @@ Machine::Machine(bool debug)
 Machine::~Machine()
 {
     delete [] mainMemory;
+    delete [] decoded;
+    for (int i = 0; i < MemorySize / 4; i++)
+	if (blocks[i] != NULL) {
+	    delete [] blocks[i]->instrs;
+	    delete [] blocks[i]->native;
+	    delete [] blocks[i]->nativeLength;
+	    delete blocks[i];
+	}
+    delete [] blocks;
+    if (codeCache != NULL)
+	DeallocExecutable(codeCache, CodeCacheSize);
     if (tlb != NULL)
         delete [] tlb;
 }
@@ -101,6 +135,12 @@ void
 Machine::RaiseException(ExceptionType which, int badVAddr)
 {
     DEBUG(dbgMach, "Exception: " << exceptionNames[which]);
+    if (uncharged > 0) {		// count the ticks of the instructions
+					// run before this one (see RunBlocks)
+	kernel->stats->totalTicks += uncharged * UserTick;
+	kernel->stats->userTicks += uncharged * UserTick;
+	uncharged = 0;
+    }
     registers[BadVAddrReg] = badVAddr;
     DelayedLoad(0, 0);			// finish anything in progress
     kernel->interrupt->setStatus(SystemMode);
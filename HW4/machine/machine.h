@@ -39,6 +39,10 @@ const int NumPhysPages = 128;
 
 const int MemorySize = (NumPhysPages * PageSize);
 const int TLBSize = 4;			// if there is a TLB, make it small
+const int SoftTLBSize = 16;		// translations kept by ReadMem and
+					// WriteMem (see translate.cc)
+const int CodeCacheSize = 256 * 1024;	// bytes of host code for compiled
+					// blocks (see mipssim.cc)
 
 enum ExceptionType { NoException,           // Everything ok!
 		     SyscallException,      // A program executed a system call.
@@ -88,7 +92,58 @@ enum ExceptionType { NoException,           // Everything ok!
 // The procedures in this class are defined in machine.cc, mipssim.cc, and
 // translate.cc.
 
-class Instruction;
+// The following class defines an instruction, represented in both
+// 	undecoded binary form
+//      decoded to identify
+//	    operation to do
+//	    registers to act on
+//	    any immediate operand value
+
+class Instruction {
+  public:
+    void Decode();	// decode the binary representation of the instruction
+
+    unsigned int value; // binary representation of the instruction
+
+    char opCode;     // Type of instruction.  This is NOT the same as the
+    		     // opcode field from the instruction: see defs in mips.h
+    char rs, rt, rd; // Three registers from instruction.
+    int extra;       // Immediate or target or shamt field or offset.
+                     // Immediates are sign-extended.
+};
+
+// A basic block of user code: instructions one after another in a page,
+// up to the delay slot of a branch or jump, a system call, or the end
+// of the page.  See Machine::RunBlocks.
+
+typedef void (*NativeCode)(int *registers);
+				// host code for a run of instructions of
+				// a compiled block (see Machine::Compile)
+
+class Block {
+  public:
+    int length;			// number of instructions
+    Instruction *instrs;	// the instructions, decoded
+    int checked;		// stamp of when they were last checked
+				// against memory
+    int runs;			// how many times it has been run
+    NativeCode *native;		// once compiled, the host code for the
+				// run starting at each instruction, or
+				// NULL to execute it; NULL if not compiled
+    char *nativeLength;		// how many instructions each run covers
+};
+
+// A translation kept by ReadMem and WriteMem, so that they needn't
+// call Translate every time.
+
+class SoftTLBEntry {
+  public:
+    unsigned int vpn;		// virtual page, or -1 if none
+    char *read;			// where it is in main memory
+    char *write;		// the same, if it may be written without
+				// setting its dirty bit; otherwise NULL
+};
+
 class Interrupt;
 
 class Machine {
@@ -143,18 +198,38 @@ class Machine {
     				// Read or write 1, 2, or 4 bytes of virtual 
 				// memory (at addr).  Return FALSE if a 
 				// correct translation couldn't be found.
+
+    void FlushTranslations();	// Forget the translations ReadMem and
+				// WriteMem keep; call whenever the page
+				// table changes
   private:
 
 // Routines internal to the machine simulation -- DO NOT call these directly
     void DelayedLoad(int nextReg, int nextVal);  	
 				// Do a pending delayed load (modifying a reg)
 
-    void OneInstruction(Instruction *instr); 	
-    				// Run one instruction of a user program.
+    void OneInstruction(); 	// Run one instruction of a user program.
     
-
-
-    ExceptionType Translate(int virtAddr, int* physAddr, int size,bool writing);
+    Instruction *Fetch();	// Return the decoded instruction at the PC,
+    				// or NULL on an exception
+    ExceptionType TranslateCode(int pc, int *physAddr);
+    				// Translate the address of an instruction
+    bool Execute(Instruction *instr);
+    				// Execute it; FALSE on an exception
+
+    bool RunBlocks();		// Run user code a basic block at a time,
+				// up to the next interrupt
+    Block *FindBlock(int physAddr, int stamp);
+    				// Return the block at "physAddr"
+    void Compile(Block *block);	// Emit host code for its instructions
+    void FlushCodeCache();	// Uncompile every block
+
+
+    void Remember(unsigned int vpn, int physAddr, TranslationEntry *entry);
+    				// Keep a translation for ReadMem/WriteMem
+
+    ExceptionType Translate(int virtAddr, int* physAddr, int size,bool writing,
+			    TranslationEntry **entryPtr = NULL);
     				// Translate an address, and check for 
 				// alignment.  Set the use and dirty bits in 
 				// the translation entry appropriately,
@@ -173,6 +248,29 @@ class Machine {
 
     int registers[NumTotalRegs]; // CPU registers, for executing user programs
 
+    Instruction *decoded;	// the instruction last decoded from each
+				// word of main memory (see Fetch)
+    TranslationEntry *fetchEntry; // translation of the page last fetched
+				// from, or NULL
+    TranslationEntry *fetchTable; // the page table it was found in
+    unsigned int fetchPage;	// the virtual page it translates
+
+    Block **blocks;		// the block starting at each word of main
+				// memory, or NULL
+    bool codeFrame[NumPhysPages]; // which frames hold blocks
+    bool codeWritten;		// a store was made to one of them
+    int blockStamp;		// changed whenever the code may have
+    				// changed
+    int uncharged;		// instructions run in the current block,
+				// whose ticks aren't yet counted
+    char *codeCache;		// host code of compiled blocks, or NULL
+				// if we can't run any
+    int codeUsed;		// how much of it is in use
+
+    SoftTLBEntry softTLB[SoftTLBSize];
+    				// translations kept by ReadMem and
+				// WriteMem, by virtual page
+
     bool singleStep;		// drop back into the debugger after each
 				// simulated instruction
     int runUntilTime;		// drop back into the debugger when simulated
@@ -24,25 +24,15 @@
 
 static void Mult(int a, int b, bool signedArith, int* hiPtr, int* loPtr);
 
-// The following class defines an instruction, represented in both
-// 	undecoded binary form
-//      decoded to identify
-//	    operation to do
-//	    registers to act on
-//	    any immediate operand value
+// With THREADED_DISPATCH, Execute jumps straight to the code for
+// each instruction through a table of label addresses (a gcc extension),
+// rather than through the switch; each case is also such a label.
 
-class Instruction {
-  public:
-    void Decode();	// decode the binary representation of the instruction
-
-    unsigned int value; // binary representation of the instruction
-
-    char opCode;     // Type of instruction.  This is NOT the same as the
-    		     // opcode field from the instruction: see defs in mips.h
-    char rs, rt, rd; // Three registers from instruction.
-    int extra;       // Immediate or target or shamt field or offset.
-                     // Immediates are sign-extended.
-};
+#ifdef THREADED_DISPATCH
+#define CASE(op)	case op: L_##op:
+#else
+#define CASE(op)	case op:
+#endif
 
 //----------------------------------------------------------------------
 // Machine::Run
@@ -51,20 +41,24 @@ class Instruction {
 //
 //	This routine is re-entrant, in that it can be called multiple
 //	times concurrently -- one for each thread executing user code.
+//
+//	Whatever code can be run a block at a time is (see RunBlocks); the
+//	instruction after that is run on its own, followed by a clock tick,
+//	so that any interrupt is taken at exactly the same time as if each
+//	instruction were run on its own.
 //----------------------------------------------------------------------
 
 void
 Machine::Run()
 {
-    Instruction *instr = new Instruction;  // storage for decoded instruction
-
     if (debug->IsEnabled('m')) {
         cout << "Starting program in thread: " << kernel->currentThread->getName();
 		cout << ", at time: " << kernel->stats->totalTicks << "\n";
     }
     kernel->interrupt->setStatus(UserMode);
     for (;;) {
-        OneInstruction(instr);
+	if (!RunBlocks())
+	    OneInstruction();
 		kernel->interrupt->OneTick();
 		if (singleStep && (runUntilTime <= kernel->stats->totalTicks))
 	  		Debugger();
@@ -94,6 +88,561 @@ TypeToReg(RegType reg, Instruction *instr)
     }
 }
 
+//----------------------------------------------------------------------
+// Machine::Fetch
+// 	Return the decoded instruction at the PC.  If it can't be
+//	fetched, raise the exception and return NULL.
+//
+//	Each word of main memory is decoded only once: "decoded" keeps
+//	the instruction last decoded from each word, with its binary
+//	form, and it is used again as long as the word still holds the
+//	same value.  Comparing the word catches every change to the
+//	code, whether a store by the program or the kernel loading a
+//	program or paging into the frame.
+//
+//	The address is translated by TranslateCode.
+//----------------------------------------------------------------------
+
+Instruction *
+Machine::Fetch()
+{
+    int pc = registers[PCReg];
+    ExceptionType exception;
+    Instruction *instr;
+    unsigned int raw;
+    int physAddr;
+
+    exception = TranslateCode(pc, &physAddr);
+    if (exception != NoException) {
+	RaiseException(exception, pc);
+	return NULL;
+    }
+
+    raw = WordToHost(*(unsigned int *) &mainMemory[physAddr]);
+    instr = &decoded[physAddr / 4];
+    if (instr->value != raw) {
+	instr->value = raw;
+	instr->Decode();
+    }
+    return instr;
+}
+
+//----------------------------------------------------------------------
+// Machine::TranslateCode
+// 	Translate "pc", the address of an instruction, as Translate would.
+//
+//	The translation of the page last fetched from is kept, and used
+//	again as long as the entry it came from still maps that page in
+//	the current page table (or TLB).  The use bit is set each time,
+//	as Translate would.
+//----------------------------------------------------------------------
+
+ExceptionType
+Machine::TranslateCode(int pc, int *physAddr)
+{
+    unsigned int vpn = (unsigned) pc / PageSize;
+    TranslationEntry *entry = fetchEntry;
+    ExceptionType exception;
+
+    if (entry != NULL && vpn == fetchPage && !(pc & 0x3) && entry->valid
+	    && (tlb != NULL ? entry->virtualPage == (int) vpn
+	    		    : (pageTable == fetchTable && vpn < pageTableSize))
+	    && entry->physicalPage < NumPhysPages) {
+	entry->use = TRUE;
+	*physAddr = entry->physicalPage * PageSize + pc % PageSize;
+	return NoException;
+    }
+    fetchEntry = NULL;
+    exception = Translate(pc, physAddr, 4, FALSE, &entry);
+    if (exception == NoException) {
+	fetchEntry = entry;
+	fetchTable = pageTable;
+	fetchPage = vpn;
+    }
+    return exception;
+}
+
+//----------------------------------------------------------------------
+// EndsBlock
+// 	Return TRUE if the instruction after "instr" -- its delay slot,
+//	if it is a branch or a jump -- is the last of a basic block.
+//----------------------------------------------------------------------
+
+static bool
+EndsBlock(Instruction *instr)
+{
+    switch (instr->opCode) {
+      case OP_BEQ: case OP_BNE: case OP_BGEZ: case OP_BGEZAL:
+      case OP_BGTZ: case OP_BLEZ: case OP_BLTZ: case OP_BLTZAL:
+      case OP_J: case OP_JAL: case OP_JALR: case OP_JR:
+	return TRUE;
+      default:
+	return FALSE;
+    }
+}
+
+//----------------------------------------------------------------------
+// Machine::FindBlock
+// 	Return the basic block starting at "physAddr" in main memory,
+//	decoding it if it hasn't been, or if the code has changed since.
+//
+//	A block runs from its first instruction to the delay slot of
+//	the first branch or jump after it, or to a system call or an
+//	illegal instruction, or to the end of the page, whichever comes
+//	first.  Its code is checked against memory once for each "stamp"
+//	(see RunBlocks), since the kernel and the program itself can
+//	both change it.
+//----------------------------------------------------------------------
+
+Block *
+Machine::FindBlock(int physAddr, int stamp)
+{
+    Block *block = blocks[physAddr / 4];
+    unsigned int *code = (unsigned int *) &mainMemory[physAddr];
+    int i, limit = (PageSize - physAddr % PageSize) / 4;
+    Instruction *instr;
+
+    if (block != NULL && block->checked != stamp) {
+	for (i = 0; i < block->length; i++)
+	    if (block->instrs[i].value != WordToHost(code[i]))
+		break;
+	if (i < block->length) {		// changed; decode it again
+	    delete [] block->instrs;
+	    delete [] block->native;
+	    delete [] block->nativeLength;
+	    delete block;
+	    block = blocks[physAddr / 4] = NULL;
+	}
+    }
+    if (block == NULL) {
+	block = new Block;
+	block->instrs = new Instruction[limit];
+	for (i = 0; i < limit; i++) {
+	    instr = &block->instrs[i];
+	    instr->value = WordToHost(code[i]);
+	    instr->Decode();
+	    if (instr->opCode == OP_SYSCALL || instr->opCode == OP_UNIMP
+		    || instr->opCode == OP_RES
+		    || (i > 0 && EndsBlock(&block->instrs[i - 1]))) {
+		i++;
+		break;
+	    }
+	}
+	block->length = i;
+	block->runs = 0;
+	block->native = NULL;
+	block->nativeLength = NULL;
+	blocks[physAddr / 4] = block;
+	codeFrame[physAddr / PageSize] = TRUE;
+    }
+    block->checked = stamp;
+    return block;
+}
+
+//----------------------------------------------------------------------
+// Machine::RunBlocks
+// 	Run user code a basic block at a time, for as long as we can
+//	without changing what the program or the kernel could see.
+//
+//	Each block is run straight through, and only then is the clock
+//	advanced, by a tick for each instruction.  This is exact as long
+//	as no interrupt falls due within the block, so a block is only
+//	run if its last tick will still be before the next interrupt.
+//	If an instruction raises an exception, the ticks of those before
+//	it are counted before the kernel is called (see RaiseException).
+//
+//	One block leads on to the next, without returning to Run, until
+//	the next would reach an interrupt or its address can't be
+//	translated, or an exception is raised.  Blocks within a page
+//	follow one another by physical address, without translating
+//	their address again.
+//
+//	With -hot, a block that has been run often enough is compiled
+//	(see Compile), and from then on its instructions are run by
+//	its host code where they have some.  With -noblocks (or
+//	when single stepping or tracing instructions), nothing is run
+//	here, and Run goes an instruction at a time.
+//
+//	Returns TRUE if the last instruction run raised an exception, so
+//	that Run has still to count its tick; FALSE if no more whole
+//	blocks could be run.
+//----------------------------------------------------------------------
+
+bool
+Machine::RunBlocks()
+{
+    Statistics *stats = kernel->stats;
+    int room;			// ticks before the next interrupt is due
+    int pc, physAddr = 0, frame = -1;
+    int i, ticks;
+    int hot = kernel->hotBlocks;
+    Block *block;
+    NativeCode code;
+
+    if (!kernel->runBlocks || singleStep || debug->IsEnabled('m')
+		|| debug->IsEnabled(dbgInt))
+	return FALSE;		// go an instruction at a time
+    room = kernel->interrupt->TimeToNext();
+    blockStamp++;		// the kernel may have changed the code
+    for (;;) {
+	pc = registers[PCReg];
+	if (frame >= 0 && (unsigned) pc / PageSize == fetchPage && !(pc & 0x3))
+	    physAddr = frame * PageSize + pc % PageSize;
+	else if (TranslateCode(pc, &physAddr) == NoException)
+	    frame = physAddr / PageSize;
+	else
+	    return FALSE;	// let OneInstruction raise the exception
+	block = FindBlock(physAddr, blockStamp);
+	if (block->length * UserTick >= room)
+	    return FALSE;
+	if (block->native == NULL && hot > 0 && ++block->runs >= hot)
+	    Compile(block);
+
+	for (i = 0; i < block->length; ) {
+	    uncharged = i;
+	    if (block->native != NULL && (code = block->native[i]) != NULL) {
+		(*code)(registers);
+		i += block->nativeLength[i];
+	    } else if (!Execute(&block->instrs[i]))
+		return TRUE;
+	    else
+		i++;
+	    if (codeWritten || registers[PCReg] != pc + 4 * i)
+		break;
+	}
+	uncharged = 0;
+	ticks = i * UserTick;
+	stats->totalTicks += ticks;
+	stats->userTicks += ticks;
+	room -= ticks;
+	if (codeWritten) {	// a store into code: check it again
+	    codeWritten = FALSE;
+	    blockStamp++;
+	}
+    }
+}
+
+//----------------------------------------------------------------------
+// Host code for compiled blocks.
+//	A compiled block is run by host (i386) code for each run of its
+//	instructions that can't raise an exception, touch memory or
+//	branch; the rest are left to Execute.  The code for a run works
+//	on the simulated registers in place, through a base register
+//	(EBX) that holds "registers": each instruction is a load, an ALU
+//	operation and a store, and the delayed load and program counters
+//	are brought up to date once for the whole run, just as Execute
+//	would have left them after its last instruction.
+//
+//	The code is kept in a code cache, allocated from it one run
+//	after another; when it fills up, every block is uncompiled and
+//	the cache started again (see FlushCodeCache).  On x86-64 hosts
+//	the same instructions are emitted, with a different prologue,
+//	since they are encoded the same way in 32-bit operand size.
+//----------------------------------------------------------------------
+
+static const int MaxCodePerInstr = 24;	// bytes of host code per
+					// instruction, at most
+static const int MaxCodePerRun = 128;	// and for the rest of a run
+
+enum { EAX = 0, ECX = 1, EDX = 2, EBX = 3 };	// host registers
+
+static char *emit;			// where the next byte goes
+
+static void
+Byte(int value)
+{
+    *emit++ = (char) value;
+}
+
+static void
+Word(int value)
+{
+    Byte(value);			// the host is little-endian
+    Byte(value >> 8);
+    Byte(value >> 16);
+    Byte(value >> 24);
+}
+
+// "op reg, r[which]": the operand is at [EBX + 4 * which]
+static void
+RegOp(int op, int reg, int which)
+{
+    Byte(op);
+    Byte(0x83 | reg << 3);
+    Word(4 * which);
+}
+
+static void
+Load(int reg, int which)	// mov reg, r[which]
+{
+    RegOp(0x8b, reg, which);
+}
+
+static void
+Store(int reg, int which)	// mov r[which], reg
+{
+    RegOp(0x89, reg, which);
+}
+
+static void
+StoreImm(int which, int value)	// mov dword r[which], value
+{
+    Byte(0xc7);
+    Byte(0x83);
+    Word(4 * which);
+    Word(value);
+}
+
+static void
+ImmOp(int op, int value)	// op eax, value
+{
+    Byte(op);
+    Word(value);
+}
+
+static void
+Shift(int op, int count)	// shl/sar eax, count (or cl if < 0)
+{
+    if (count < 0) {
+	Byte(0xd3);
+	Byte(op);
+    } else {
+	Byte(0xc1);
+	Byte(op);
+	Byte(count);
+    }
+}
+
+static void
+Set(int condition)		// setcc al; movzx eax, al
+{
+    Byte(0x0f);
+    Byte(condition);
+    Byte(0xc0);
+    Byte(0x0f);
+    Byte(0xb6);
+    Byte(0xc0);
+}
+
+static void
+AddTo(int reg, int value)	// lea reg, [eax + value]
+{
+    Byte(0x8d);
+    Byte(0x80 | reg << 3);
+    Word(value);
+}
+
+//----------------------------------------------------------------------
+// Destination
+// 	Return the register "instr" sets, or -1 if it has no host code.
+//----------------------------------------------------------------------
+
+static int
+Destination(Instruction *instr)
+{
+    switch (instr->opCode) {
+      case OP_ADDIU: case OP_ANDI: case OP_ORI: case OP_XORI:
+      case OP_LUI: case OP_SLTI: case OP_SLTIU:
+	return instr->rt;
+      case OP_ADDU: case OP_SUBU: case OP_AND: case OP_OR: case OP_XOR:
+      case OP_NOR: case OP_SLL: case OP_SLLV: case OP_SRA: case OP_SRAV:
+      case OP_SRL: case OP_SRLV: case OP_SLT: case OP_SLTU:
+      case OP_MFHI: case OP_MFLO:
+	return instr->rd;
+      case OP_MTHI:
+	return HiReg;
+      case OP_MTLO:
+	return LoReg;
+      default:
+	return -1;
+    }
+}
+
+//----------------------------------------------------------------------
+// EmitInstruction
+// 	Emit the host code that computes the result of "instr" and
+//	stores it in its destination register.  Nothing is emitted if
+//	that is r0, which always reads as 0.
+//
+//	SRL and SRLV shift arithmetically, as Execute does.
+//----------------------------------------------------------------------
+
+static void
+EmitInstruction(Instruction *instr)
+{
+    int dest = Destination(instr);
+    int imm = instr->extra & 0xffff;	// zero-extended, for logical ops
+
+    if (dest == 0)
+	return;
+    switch (instr->opCode) {
+      case OP_ADDIU: Load(EAX, instr->rs); ImmOp(0x05, instr->extra); break;
+      case OP_ANDI: Load(EAX, instr->rs); ImmOp(0x25, imm); break;
+      case OP_ORI: Load(EAX, instr->rs); ImmOp(0x0d, imm); break;
+      case OP_XORI: Load(EAX, instr->rs); ImmOp(0x35, imm); break;
+      case OP_LUI: StoreImm(dest, instr->extra << 16); return;
+      case OP_ADDU: Load(EAX, instr->rs); RegOp(0x03, EAX, instr->rt); break;
+      case OP_SUBU: Load(EAX, instr->rs); RegOp(0x2b, EAX, instr->rt); break;
+      case OP_AND: Load(EAX, instr->rs); RegOp(0x23, EAX, instr->rt); break;
+      case OP_OR: Load(EAX, instr->rs); RegOp(0x0b, EAX, instr->rt); break;
+      case OP_XOR: Load(EAX, instr->rs); RegOp(0x33, EAX, instr->rt); break;
+      case OP_NOR:
+	Load(EAX, instr->rs);
+	RegOp(0x0b, EAX, instr->rt);
+	Byte(0xf7);			// not eax
+	Byte(0xd0);
+	break;
+      case OP_SLL: Load(EAX, instr->rt); Shift(0xe0, instr->extra); break;
+      case OP_SRA: case OP_SRL:
+	Load(EAX, instr->rt);
+	Shift(0xf8, instr->extra);
+	break;
+      case OP_SLLV:
+	Load(ECX, instr->rs);		// the host masks the count to 5 bits
+	Load(EAX, instr->rt);
+	Shift(0xe0, -1);
+	break;
+      case OP_SRAV: case OP_SRLV:
+	Load(ECX, instr->rs);
+	Load(EAX, instr->rt);
+	Shift(0xf8, -1);
+	break;
+      case OP_SLT:
+	Load(EAX, instr->rs);
+	RegOp(0x3b, EAX, instr->rt);
+	Set(0x9c);			// setl
+	break;
+      case OP_SLTU:
+	Load(EAX, instr->rs);
+	RegOp(0x3b, EAX, instr->rt);
+	Set(0x92);			// setb
+	break;
+      case OP_SLTI: Load(EAX, instr->rs); ImmOp(0x3d, instr->extra); Set(0x9c);
+	break;
+      case OP_SLTIU: Load(EAX, instr->rs); ImmOp(0x3d, instr->extra); Set(0x92);
+	break;
+      case OP_MFHI: Load(EAX, HiReg); break;
+      case OP_MFLO: Load(EAX, LoReg); break;
+      case OP_MTHI: case OP_MTLO: Load(EAX, instr->rs); break;
+      default: ASSERT(FALSE);
+    }
+    Store(EAX, dest);
+}
+
+//----------------------------------------------------------------------
+// EmitRun
+// 	Emit the host code for the "count" instructions starting at
+//	"instrs", all of which have host code, and return where it
+//	starts.
+//
+//	After the first instruction, any delayed load is done, as
+//	Execute would do after it; the later ones can't start one.
+//	At the end, the program counters are advanced past the run,
+//	from the NextPC it started with.
+//----------------------------------------------------------------------
+
+static NativeCode
+EmitRun(Instruction *instrs, int count)
+{
+    char *start = emit;
+
+    Byte(0x53);				// push ebx
+#ifdef __x86_64__
+    Byte(0x48);				// mov rbx, rdi
+    Byte(0x89);
+    Byte(0xfb);
+#else
+    Byte(0x8b);				// mov ebx, [esp + 8]
+    Byte(0x5c);
+    Byte(0x24);
+    Byte(0x08);
+#endif
+    for (int i = 0; i < count; i++) {
+	EmitInstruction(&instrs[i]);
+	if (i == 0) {			// r[r[LoadReg]] = r[LoadValueReg]
+	    Load(EAX, LoadReg);
+	    Load(EDX, LoadValueReg);
+	    Byte(0x89);			// mov [ebx + eax * 4], edx
+	    Byte(0x14);
+	    Byte(0x83);
+	    StoreImm(LoadReg, 0);
+	    StoreImm(LoadValueReg, 0);
+	    StoreImm(0, 0);
+	}
+    }
+    Load(EAX, NextPCReg);
+    if (count == 1)
+	Load(EDX, PCReg);
+    else
+	AddTo(EDX, 4 * (count - 2));
+    Store(EDX, PrevPCReg);
+    AddTo(EDX, 4 * (count - 1));
+    Store(EDX, PCReg);
+    ImmOp(0x05, 4 * count);		// add eax, 4 * count
+    Store(EAX, NextPCReg);
+    Byte(0x5b);				// pop ebx
+    Byte(0xc3);				// ret
+    return (NativeCode) start;
+}
+
+//----------------------------------------------------------------------
+// Machine::FlushCodeCache
+// 	Throw away the host code of every compiled block, so that the
+//	code cache can be used again from the start.  Blocks that are
+//	still hot are compiled again when they are next run.
+//----------------------------------------------------------------------
+
+void
+Machine::FlushCodeCache()
+{
+    for (int i = 0; i < MemorySize / 4; i++)
+	if (blocks[i] != NULL && blocks[i]->native != NULL) {
+	    delete [] blocks[i]->native;
+	    delete [] blocks[i]->nativeLength;
+	    blocks[i]->native = NULL;
+	    blocks[i]->nativeLength = NULL;
+	    blocks[i]->runs = 0;
+	}
+    codeUsed = 0;
+    DEBUG(dbgMach, "Flushed the code cache");
+}
+
+//----------------------------------------------------------------------
+// Machine::Compile
+// 	Compile a block that is run often: emit host code for each run
+//	of its instructions that can have it, into the code cache.
+//	Instructions without host code are left to Execute, as are all
+//	of them if there is no code cache (a host that isn't x86, or
+//	one that won't give us executable memory).
+//----------------------------------------------------------------------
+
+void
+Machine::Compile(Block *block)
+{
+    int i, count, need = MaxCodePerRun + MaxCodePerInstr * block->length;
+
+    if (codeCache != NULL && codeUsed + need > CodeCacheSize)
+	FlushCodeCache();
+    block->native = new NativeCode[block->length];
+    block->nativeLength = new char[block->length];
+    for (i = 0; i < block->length; i++)
+	block->native[i] = NULL;
+    emit = codeCache + codeUsed;
+    for (i = 0; i < block->length; i += count) {
+	for (count = 0; i + count < block->length
+		&& Destination(&block->instrs[i + count]) >= 0; count++)
+	    ;
+	if (count > 0 && codeCache != NULL)
+	    block->native[i] = EmitRun(&block->instrs[i], count);
+	else
+	    count = 1;
+	block->nativeLength[i] = count;
+    }
+    if (codeCache != NULL)
+	codeUsed = emit - codeCache;
+    DEBUG(dbgMach, "Compiled block of " << block->length << " instructions");
+}
+
 //----------------------------------------------------------------------
 // Machine::OneInstruction
 // 	Execute one instruction from a user-level program
@@ -118,22 +667,13 @@ TypeToReg(RegType reg, Instruction *instr)
 //----------------------------------------------------------------------
 
 void
-Machine::OneInstruction(Instruction *instr)
+Machine::OneInstruction()
 {
-#ifdef SIM_FIX
-    int byte;       // described in Kane for LWL,LWR,...
-#endif
-
-    int raw;
-    int nextLoadReg = 0; 	
-    int nextLoadValue = 0; 	// record delayed load operation, to apply
-				// in the future
+    Instruction *instr;
 
     // Fetch instruction 
-    if (!ReadMem(registers[PCReg], 4, &raw))
+    if ((instr = Fetch()) == NULL)
 	return;			// exception occurred
-    instr->value = raw;
-    instr->Decode();
 
     if (debug->IsEnabled('m')) {
         struct OpString *str = &opStrings[instr->opCode];
@@ -145,86 +685,130 @@ Machine::OneInstruction(Instruction *instr)
 	     TypeToReg(str->args[1], instr), TypeToReg(str->args[2], instr));
         cout << "\t" << buf << "\n";
     }
-    
+
+    Execute(instr);
+}
+
+//----------------------------------------------------------------------
+// Machine::Execute
+// 	Execute "instr", the instruction at the PC.  Return FALSE if it
+//	raised an exception (the kernel has already handled it).
+//
+//	With THREADED_DISPATCH, the instruction is dispatched on with a
+//	computed goto (see CASE, above).
+//----------------------------------------------------------------------
+
+bool
+Machine::Execute(Instruction *instr)
+{
+#ifdef SIM_FIX
+    int byte;       // described in Kane for LWL,LWR,...
+#endif
+
+    int nextLoadReg = 0; 	
+    int nextLoadValue = 0; 	// record delayed load operation, to apply
+				// in the future
+
+#ifdef THREADED_DISPATCH
+    static void *handlers[MaxOpcode + 1] = {
+	&&unknown, &&L_OP_ADD, &&L_OP_ADDI, &&L_OP_ADDIU, &&L_OP_ADDU,
+	&&L_OP_AND, &&L_OP_ANDI, &&L_OP_BEQ, &&L_OP_BGEZ, &&L_OP_BGEZAL,
+	&&L_OP_BGTZ, &&L_OP_BLEZ, &&L_OP_BLTZ, &&L_OP_BLTZAL, &&L_OP_BNE,
+	&&unknown, &&L_OP_DIV, &&L_OP_DIVU, &&L_OP_J, &&L_OP_JAL,
+	&&L_OP_JALR, &&L_OP_JR, &&L_OP_LB, &&L_OP_LBU, &&L_OP_LH,
+	&&L_OP_LHU, &&L_OP_LUI, &&L_OP_LW, &&L_OP_LWL, &&L_OP_LWR,
+	&&unknown, &&L_OP_MFHI, &&L_OP_MFLO, &&unknown, &&L_OP_MTHI,
+	&&L_OP_MTLO, &&L_OP_MULT, &&L_OP_MULTU, &&L_OP_NOR, &&L_OP_OR,
+	&&L_OP_ORI, &&unknown, &&L_OP_SB, &&L_OP_SH, &&L_OP_SLL,
+	&&L_OP_SLLV, &&L_OP_SLT, &&L_OP_SLTI, &&L_OP_SLTIU, &&L_OP_SLTU,
+	&&L_OP_SRA, &&L_OP_SRAV, &&L_OP_SRL, &&L_OP_SRLV, &&L_OP_SUB,
+	&&L_OP_SUBU, &&L_OP_SW, &&L_OP_SWL, &&L_OP_SWR, &&L_OP_XOR,
+	&&L_OP_XORI, &&L_OP_SYSCALL, &&L_OP_UNIMP, &&L_OP_RES
+    };
+#endif
+
     // Compute next pc, but don't install in case there's an error or branch.
     int pcAfter = registers[NextPCReg] + 4;
     int sum, diff, tmp, value;
     unsigned int rs, rt, imm;
 
     // Execute the instruction (cf. Kane's book)
+#ifdef THREADED_DISPATCH
+    goto *handlers[(int) instr->opCode];
+#endif
     switch (instr->opCode) {
 	
-      case OP_ADD:
+      CASE(OP_ADD)
 	sum = registers[instr->rs] + registers[instr->rt];
 	if (!((registers[instr->rs] ^ registers[instr->rt]) & SIGN_BIT) &&
 	    ((registers[instr->rs] ^ sum) & SIGN_BIT)) {
 	    RaiseException(OverflowException, 0);
-	    return;
+	    return FALSE;
 	}
 	registers[instr->rd] = sum;
 	break;
 	
-      case OP_ADDI:
+      CASE(OP_ADDI)
 	sum = registers[instr->rs] + instr->extra;
 	if (!((registers[instr->rs] ^ instr->extra) & SIGN_BIT) &&
 	    ((instr->extra ^ sum) & SIGN_BIT)) {
 	    RaiseException(OverflowException, 0);
-	    return;
+	    return FALSE;
 	}
 	registers[instr->rt] = sum;
 	break;
 	
-      case OP_ADDIU:
+      CASE(OP_ADDIU)
 	registers[instr->rt] = registers[instr->rs] + instr->extra;
 	break;
 	
-      case OP_ADDU:
+      CASE(OP_ADDU)
 	registers[instr->rd] = registers[instr->rs] + registers[instr->rt];
 	break;
 	
-      case OP_AND:
+      CASE(OP_AND)
 	registers[instr->rd] = registers[instr->rs] & registers[instr->rt];
 	break;
 	
-      case OP_ANDI:
+      CASE(OP_ANDI)
 	registers[instr->rt] = registers[instr->rs] & (instr->extra & 0xffff);
 	break;
 	
-      case OP_BEQ:
+      CASE(OP_BEQ)
 	if (registers[instr->rs] == registers[instr->rt])
 	    pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
 	break;
 	
-      case OP_BGEZAL:
+      CASE(OP_BGEZAL)
 	registers[R31] = registers[NextPCReg] + 4;
-      case OP_BGEZ:
+      CASE(OP_BGEZ)
 	if (!(registers[instr->rs] & SIGN_BIT))
 	    pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
 	break;
 	
-      case OP_BGTZ:
+      CASE(OP_BGTZ)
 	if (registers[instr->rs] > 0)
 	    pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
 	break;
 	
-      case OP_BLEZ:
+      CASE(OP_BLEZ)
 	if (registers[instr->rs] <= 0)
 	    pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
 	break;
 	
-      case OP_BLTZAL:
+      CASE(OP_BLTZAL)
 	registers[R31] = registers[NextPCReg] + 4;
-      case OP_BLTZ:
+      CASE(OP_BLTZ)
 	if (registers[instr->rs] & SIGN_BIT)
 	    pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
 	break;
 	
-      case OP_BNE:
+      CASE(OP_BNE)
 	if (registers[instr->rs] != registers[instr->rt])
 	    pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
 	break;
 	
-      case OP_DIV:
+      CASE(OP_DIV)
 	if (registers[instr->rt] == 0) {
 	    registers[LoReg] = 0;
 	    registers[HiReg] = 0;
@@ -234,7 +818,7 @@ Machine::OneInstruction(Instruction *instr)
 	}
 	break;
 	
-      case OP_DIVU:	  
+      CASE(OP_DIVU)	  
 	  rs = (unsigned int) registers[instr->rs];
 	  rt = (unsigned int) registers[instr->rt];
 	  if (rt == 0) {
@@ -248,23 +832,23 @@ Machine::OneInstruction(Instruction *instr)
 	  }
 	  break;
 	
-      case OP_JAL:
+      CASE(OP_JAL)
 	registers[R31] = registers[NextPCReg] + 4;
-      case OP_J:
+      CASE(OP_J)
 	pcAfter = (pcAfter & 0xf0000000) | IndexToAddr(instr->extra);
 	break;
 	
-      case OP_JALR:
+      CASE(OP_JALR)
 	registers[instr->rd] = registers[NextPCReg] + 4;
-      case OP_JR:
+      CASE(OP_JR)
 	pcAfter = registers[instr->rs];
 	break;
 	
-      case OP_LB:
-      case OP_LBU:
+      CASE(OP_LB)
+      CASE(OP_LBU)
 	tmp = registers[instr->rs] + instr->extra;
 	if (!ReadMem(tmp, 1, &value))
-	    return;
+	    return FALSE;
 
 	if ((value & 0x80) && (instr->opCode == OP_LB))
 	    value |= 0xffffff00;
@@ -274,15 +858,15 @@ Machine::OneInstruction(Instruction *instr)
 	nextLoadValue = value;
 	break;
 	
-      case OP_LH:
-      case OP_LHU:	  
+      CASE(OP_LH)
+      CASE(OP_LHU)	  
 	tmp = registers[instr->rs] + instr->extra;
 	if (tmp & 0x1) {
 	    RaiseException(AddressErrorException, tmp);
-	    return;
+	    return FALSE;
 	}
 	if (!ReadMem(tmp, 2, &value))
-	    return;
+	    return FALSE;
 
 	if ((value & 0x8000) && (instr->opCode == OP_LH))
 	    value |= 0xffff0000;
@@ -292,24 +876,24 @@ Machine::OneInstruction(Instruction *instr)
 	nextLoadValue = value;
 	break;
       	
-      case OP_LUI:
+      CASE(OP_LUI)
 	DEBUG(dbgMach, "Executing: LUI r" << instr->rt << ", " << instr->extra);
 	registers[instr->rt] = instr->extra << 16;
 	break;
 	
-      case OP_LW:
+      CASE(OP_LW)
 	tmp = registers[instr->rs] + instr->extra;
 	if (tmp & 0x3) {
 	    RaiseException(AddressErrorException, tmp);
-	    return;
+	    return FALSE;
 	}
 	if (!ReadMem(tmp, 4, &value))
-	    return;
+	    return FALSE;
 	nextLoadReg = instr->rt;
 	nextLoadValue = value;
 	break;
     	
-      case OP_LWL:	  
+      CASE(OP_LWL)	  
 	tmp = registers[instr->rs] + instr->extra;
 
 #ifdef SIM_FIX
@@ -324,7 +908,7 @@ Machine::OneInstruction(Instruction *instr)
         // DEBUG('P', "Addr 0x%X\n",tmp-byte);
 
         if (!ReadMem(tmp-byte, 4, &value))
-            return;
+            return FALSE;
 #else
 	// ReadMem assumes all 4 byte requests are aligned on an even 
 	// word boundary.  Also, the little endian/big endian swap code would
@@ -332,7 +916,7 @@ Machine::OneInstruction(Instruction *instr)
 	ASSERT((tmp & 0x3) == 0);  
 
 	if (!ReadMem(tmp, 4, &value))
-	    return;
+	    return FALSE;
 #endif
 
 	if (registers[LoadReg] == instr->rt)
@@ -361,7 +945,7 @@ Machine::OneInstruction(Instruction *instr)
 	nextLoadReg = instr->rt;
 	break;
       	
-      case OP_LWR:
+      CASE(OP_LWR)
 	tmp = registers[instr->rs] + instr->extra;
 
 #ifdef SIM_FIX
@@ -376,7 +960,7 @@ Machine::OneInstruction(Instruction *instr)
         // DEBUG('P', "Addr 0x%X\n",tmp-byte);
 
         if (!ReadMem(tmp-byte, 4, &value))
-            return;
+            return FALSE;
 #else
 	// ReadMem assumes all 4 byte requests are aligned on an even 
 	// word boundary.  Also, the little endian/big endian swap code would
@@ -384,7 +968,7 @@ Machine::OneInstruction(Instruction *instr)
 	ASSERT((tmp & 0x3) == 0);  
 
 	if (!ReadMem(tmp, 4, &value))
-	    return;
+	    return FALSE;
 #endif
 
 	if (registers[LoadReg] == instr->rt)
@@ -417,80 +1001,80 @@ Machine::OneInstruction(Instruction *instr)
 	nextLoadReg = instr->rt;
 	break;
     	
-      case OP_MFHI:
+      CASE(OP_MFHI)
 	registers[instr->rd] = registers[HiReg];
 	break;
 	
-      case OP_MFLO:
+      CASE(OP_MFLO)
 	registers[instr->rd] = registers[LoReg];
 	break;
 	
-      case OP_MTHI:
+      CASE(OP_MTHI)
 	registers[HiReg] = registers[instr->rs];
 	break;
 	
-      case OP_MTLO:
+      CASE(OP_MTLO)
 	registers[LoReg] = registers[instr->rs];
 	break;
 	
-      case OP_MULT:
+      CASE(OP_MULT)
 	Mult(registers[instr->rs], registers[instr->rt], TRUE,
 	     &registers[HiReg], &registers[LoReg]);
 	break;
 	
-      case OP_MULTU:
+      CASE(OP_MULTU)
 	Mult(registers[instr->rs], registers[instr->rt], FALSE,
 	     &registers[HiReg], &registers[LoReg]);
 	break;
 	
-      case OP_NOR:
+      CASE(OP_NOR)
 	registers[instr->rd] = ~(registers[instr->rs] | registers[instr->rt]);
 	break;
 	
-      case OP_OR:
+      CASE(OP_OR)
 	registers[instr->rd] = registers[instr->rs] | registers[instr->rt];
 	break;
 	
-      case OP_ORI:
+      CASE(OP_ORI)
 	registers[instr->rt] = registers[instr->rs] | (instr->extra & 0xffff);
 	break;
 	
-      case OP_SB:
+      CASE(OP_SB)
 	if (!WriteMem((unsigned) 
 		(registers[instr->rs] + instr->extra), 1, registers[instr->rt]))
-	    return;
+	    return FALSE;
 	break;
 	
-      case OP_SH:
+      CASE(OP_SH)
 	if (!WriteMem((unsigned) 
 		(registers[instr->rs] + instr->extra), 2, registers[instr->rt]))
-	    return;
+	    return FALSE;
 	break;
 	
-      case OP_SLL:
+      CASE(OP_SLL)
 	registers[instr->rd] = registers[instr->rt] << instr->extra;
 	break;
 	
-      case OP_SLLV:
+      CASE(OP_SLLV)
 	registers[instr->rd] = registers[instr->rt] <<
 	    (registers[instr->rs] & 0x1f);
 	break;
 	
-      case OP_SLT:
+      CASE(OP_SLT)
 	if (registers[instr->rs] < registers[instr->rt])
 	    registers[instr->rd] = 1;
 	else
 	    registers[instr->rd] = 0;
 	break;
 	
-      case OP_SLTI:
+      CASE(OP_SLTI)
 	if (registers[instr->rs] < instr->extra)
 	    registers[instr->rt] = 1;
 	else
 	    registers[instr->rt] = 0;
 	break;
 	
-      case OP_SLTIU:	  
+      CASE(OP_SLTIU)	  
 	rs = registers[instr->rs];
 	imm = instr->extra;
 	if (rs < imm)
@@ -499,7 +1083,7 @@ Machine::OneInstruction(Instruction *instr)
 	    registers[instr->rt] = 0;
 	break;
       	
-      case OP_SLTU:	  
+      CASE(OP_SLTU)	  
 	rs = registers[instr->rs];
 	rt = registers[instr->rt];
 	if (rs < rt)
@@ -508,48 +1092,48 @@ Machine::OneInstruction(Instruction *instr)
 	    registers[instr->rd] = 0;
 	break;
       	
-      case OP_SRA:
+      CASE(OP_SRA)
 	registers[instr->rd] = registers[instr->rt] >> instr->extra;
 	break;
 	
-      case OP_SRAV:
+      CASE(OP_SRAV)
 	registers[instr->rd] = registers[instr->rt] >>
 	    (registers[instr->rs] & 0x1f);
 	break;
 	
-      case OP_SRL:
+      CASE(OP_SRL)
 	tmp = registers[instr->rt];
 	tmp >>= instr->extra;
 	registers[instr->rd] = tmp;
 	break;
 	
-      case OP_SRLV:
+      CASE(OP_SRLV)
 	tmp = registers[instr->rt];
 	tmp >>= (registers[instr->rs] & 0x1f);
 	registers[instr->rd] = tmp;
 	break;
 	
-      case OP_SUB:	  
+      CASE(OP_SUB)	  
 	diff = registers[instr->rs] - registers[instr->rt];
 	if (((registers[instr->rs] ^ registers[instr->rt]) & SIGN_BIT) &&
 	    ((registers[instr->rs] ^ diff) & SIGN_BIT)) {
 	    RaiseException(OverflowException, 0);
-	    return;
+	    return FALSE;
 	}
 	registers[instr->rd] = diff;
 	break;
       	
-      case OP_SUBU:
+      CASE(OP_SUBU)
 	registers[instr->rd] = registers[instr->rs] - registers[instr->rt];
 	break;
 	
-      case OP_SW:
+      CASE(OP_SW)
 	if (!WriteMem((unsigned) 
 		(registers[instr->rs] + instr->extra), 4, registers[instr->rt]))
-	    return;
+	    return FALSE;
 	break;
 	
-      case OP_SWL:	  
+      CASE(OP_SWL)	  
 	tmp = registers[instr->rs] + instr->extra;
 
 #ifdef SIM_FIX
@@ -562,7 +1146,7 @@ Machine::OneInstruction(Instruction *instr)
         byte = tmp & 0x3;
         // DEBUG('P', "Addr 0x%X\n",tmp-byte);
         if (!ReadMem(tmp-byte, 4, &value))
-            return;
+            return FALSE;
 
         // DEBUG('P', "Value 0x%X\n",value);
 #else
@@ -572,7 +1156,7 @@ Machine::OneInstruction(Instruction *instr)
 	ASSERT((tmp & 0x3) == 0);  
 
 	if (!ReadMem((tmp & ~0x3), 4, &value))
-	    return;
+	    return FALSE;
 #endif
 
 #ifdef SIM_FIX
@@ -599,16 +1183,16 @@ Machine::OneInstruction(Instruction *instr)
 	}
 #ifndef SIM_FIX
         if (!WriteMem((tmp & ~0x3), 4, value))
-            return;
+            return FALSE;
 #else
         // DEBUG('P', "Value 0x%X\n",value);
 
         if (!WriteMem((tmp - byte), 4, value))
-            return;
+            return FALSE;
 #endif // SIM_FIX
 	break;
     	
-      case OP_SWR:	  
+      CASE(OP_SWR)	  
 	tmp = registers[instr->rs] + instr->extra;
 
 #ifndef SIM_FIX
@@ -617,7 +1201,7 @@ Machine::OneInstruction(Instruction *instr)
         ASSERT((tmp & 0x3) == 0);  
 
         if (!ReadMem((tmp & ~0x3), 4, &value))
-            return;
+            return FALSE;
 #else
         // The only difference between this code and the BIG ENDIAN code
         // is that the ReadMem call is guaranteed an aligned access as 
@@ -630,7 +1214,7 @@ Machine::OneInstruction(Instruction *instr)
         // DEBUG('P', "Addr 0x%X\n",tmp-byte);
 
         if (!ReadMem(tmp-byte, 4, &value))
-            return;
+            return FALSE;
         // DEBUG('P', "Value 0x%X\n",value);
 #endif // SIM_FIX
 
@@ -656,35 +1240,38 @@ Machine::OneInstruction(Instruction *instr)
 
 #ifndef SIM_FIX
         if (!WriteMem((tmp & ~0x3), 4, value))
-            return;
+            return FALSE;
 #else
         // DEBUG('P', "Value 0x%X\n",value);
 
         if (!WriteMem((tmp - byte), 4, value))
-            return;
+            return FALSE;
 #endif // SIM_FIX
 
 
 	break;
     	
-      case OP_SYSCALL:
+      CASE(OP_SYSCALL)
 	RaiseException(SyscallException, 0);
-	return; 
+	return FALSE; 
 	
-      case OP_XOR:
+      CASE(OP_XOR)
 	registers[instr->rd] = registers[instr->rs] ^ registers[instr->rt];
 	break;
 	
-      case OP_XORI:
+      CASE(OP_XORI)
 	registers[instr->rt] = registers[instr->rs] ^ (instr->extra & 0xffff);
 	break;
 	
-      case OP_RES:
-      case OP_UNIMP:
+      CASE(OP_RES)
+      CASE(OP_UNIMP)
 	RaiseException(IllegalInstrException, 0);
-	return;
+	return FALSE;
 	
       default:
+#ifdef THREADED_DISPATCH
+      unknown:
+#endif
 	ASSERT(FALSE);
     }
     
@@ -698,6 +1285,7 @@ Machine::OneInstruction(Instruction *instr)
 						// are jumping into lala-land
     registers[PCReg] = registers[NextPCReg];
     registers[NextPCReg] = pcAfter;
+    return TRUE;
 }
 
 //----------------------------------------------------------------------
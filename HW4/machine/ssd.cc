@@ -0,0 +1,319 @@
+// ssd.cc
+//	Routines to simulate a flash disk, with a flash translation layer
+//	and garbage collection.  See ssd.h for how flash works, and what
+//	is (and isn't) simulated.
+//
+//	The contents of the sectors are kept by the Disk routines; this
+//	file only decides how long each request takes, by following the
+//	flash operations it causes on each channel.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "ssd.h"
+#include "debug.h"
+#include "main.h"
+
+//----------------------------------------------------------------------
+// Ssd::Ssd
+// 	Initialize a simulated flash disk.  The UNIX file is opened (or
+//	created) by Disk::Disk.  Then every sector is written once, in
+//	order, without charging any time, to bring the FTL to the state
+//	of a flash disk that has been filled.
+//----------------------------------------------------------------------
+
+Ssd::Ssd(char *name, char *baseName, CallBackObj *toCall)
+    : Disk(name, baseName, toCall)
+{
+    DEBUG(dbgDisk, "Initializing the flash translation layer.");
+    pageMap = new int[NumSectors];
+    owner = new int[NumFlashBlocks * PagesPerBlock];
+    livePages = new int[NumFlashBlocks];
+    for (int i = 0; i < NumSectors; i++)
+	pageMap[i] = -1;
+    for (int i = 0; i < NumFlashBlocks * PagesPerBlock; i++)
+	owner[i] = -1;
+    for (int c = 0; c < NumChannels; c++) {
+	freeBlocks[c] = new int[BlocksPerChannel];
+	numFree[c] = 0;
+	for (int b = BlocksPerChannel - 1; b >= 0; b--)
+	    freeBlocks[c][numFree[c]++] = b * NumChannels + c;
+	nextPage[c] = PagesPerBlock;		// no block being filled yet
+	busyUntil[c] = 0;
+    }
+    for (int b = 0; b < NumFlashBlocks; b++)
+	livePages[b] = 0;
+    nextChannel = 0;
+
+    timing = FALSE;
+    for (int i = 0; i < NumSectors; i++)
+	WritePage(i, i % NumChannels);
+    timing = TRUE;
+    hostWrites = collectWrites = numErases = numCollections = 0;
+}
+
+//----------------------------------------------------------------------
+// Ssd::~Ssd
+// 	Deallocate the FTL; Disk::~Disk closes the UNIX file.
+//----------------------------------------------------------------------
+
+Ssd::~Ssd()
+{
+    delete [] pageMap;
+    delete [] owner;
+    delete [] livePages;
+    for (int c = 0; c < NumChannels; c++)
+	delete [] freeBlocks[c];
+}
+
+//----------------------------------------------------------------------
+// Ssd::ReadRequest/WriteRequest
+// 	Simulate a request to read/write a run of sectors.  As for a
+//	Disk, the data is moved at once, and an interrupt is scheduled
+//	for when the simulated flash would be done: when the last of
+//	the pages is, on whichever channel it is.  The interrupt goes
+//	straight to "toCall": there is no head, so nothing for the
+//	device to do between requests.  For the same reason, only the
+//	total time of the request is counted in the statistics.
+//----------------------------------------------------------------------
+
+void
+Ssd::ReadRequest(int sectorNumber, char* data, int numSectors,
+		 CallBackObj *toCall)
+{
+    int now = kernel->stats->totalTicks;
+    int done = now + 1, when;
+
+    ASSERT((sectorNumber >= 0) && (numSectors > 0)
+		&& (sectorNumber + numSectors <= NumSectors));
+
+    DEBUG(dbgDisk, "Reading " << numSectors << " sectors from sector " << sectorNumber);
+    FetchSectors(sectorNumber, data, numSectors);
+    for (int i = 0; i < numSectors; i++)
+	if ((when = ReadPage(sectorNumber + i)) > done)
+	    done = when;
+
+    kernel->stats->numDiskReads += numSectors;
+    kernel->stats->diskService->Record(done - now);
+    kernel->interrupt->Schedule(toCall, done - now, DiskInt);
+}
+
+void
+Ssd::WriteRequest(int sectorNumber, char* data, int numSectors,
+		  CallBackObj *toCall)
+{
+    int now = kernel->stats->totalTicks;
+    int done = now + 1, when;
+
+    ASSERT((sectorNumber >= 0) && (numSectors > 0)
+		&& (sectorNumber + numSectors <= NumSectors));
+
+    DEBUG(dbgDisk, "Writing " << numSectors << " sectors to sector " << sectorNumber);
+    StoreSectors(sectorNumber, data, numSectors);
+    for (int i = 0; i < numSectors; i++) {
+	when = WritePage(sectorNumber + i, nextChannel);
+	nextChannel = (nextChannel + 1) % NumChannels;
+	if (when > done)
+	    done = when;
+    }
+    hostWrites += numSectors;
+
+    kernel->stats->numDiskWrites += numSectors;
+    kernel->stats->diskService->Record(done - now);
+    kernel->interrupt->Schedule(toCall, done - now, DiskInt);
+}
+
+//----------------------------------------------------------------------
+// Ssd::ComputeLatency
+// 	Return how long a request for the one sector "newSector" would
+//	take, if it were sent now: the work its channel has yet to do,
+//	plus the read or write itself.  Nothing is changed.
+//----------------------------------------------------------------------
+
+int
+Ssd::ComputeLatency(int newSector, bool writing)
+{
+    int now = kernel->stats->totalTicks;
+    int channel, latency;
+
+    if (writing) {
+	channel = nextChannel;
+	latency = PageTransferTime + PageProgramTime;
+    } else if (pageMap[newSector] == -1) {
+	return PageTransferTime;		// never written: nothing to read
+    } else {
+	channel = (pageMap[newSector] / PagesPerBlock) % NumChannels;
+	latency = PageReadTime + PageTransferTime;
+    }
+    if (busyUntil[channel] > now)
+	latency += busyUntil[channel] - now;
+    return latency;
+}
+
+//----------------------------------------------------------------------
+// Ssd::EstimateLatency
+// 	Return how long reading "sectors" would take, one request after
+//	another.  Flash has no head to move, so where the sectors are
+//	doesn't matter.
+//----------------------------------------------------------------------
+
+int
+Ssd::EstimateLatency(int *sectors, int numSectors)
+{
+    return numSectors * (PageReadTime + PageTransferTime);
+}
+
+//----------------------------------------------------------------------
+// Ssd::Print
+// 	Print how much the FTL wrote, and why.
+//----------------------------------------------------------------------
+
+void
+Ssd::Print()
+{
+    cout << "Flash: host writes " << hostWrites << ", collector writes "
+	 << collectWrites << ", erases " << numErases << ", collections "
+	 << numCollections << "\n";
+    if (hostWrites > 0)
+	cout << "Flash: write amplification "
+	     << (double) (hostWrites + collectWrites) / hostWrites << "\n";
+}
+
+//----------------------------------------------------------------------
+// Ssd::Occupy
+// 	Give "channel" "ticks" more work, after what it already has.
+//	Return when it will all be done.  While the FTL is being set
+//	up, nothing takes any time.
+//----------------------------------------------------------------------
+
+int
+Ssd::Occupy(int channel, int ticks)
+{
+    int now = kernel->stats->totalTicks;
+
+    if (!timing)
+	return now;
+    if (busyUntil[channel] < now)
+	busyUntil[channel] = now;
+    busyUntil[channel] += ticks;
+    return busyUntil[channel];
+}
+
+//----------------------------------------------------------------------
+// Ssd::ReadPage
+// 	Read the page holding "sector", and move it over its channel.
+//	Return when that will be done.
+//----------------------------------------------------------------------
+
+int
+Ssd::ReadPage(int sector)
+{
+    int page = pageMap[sector];
+
+    if (page == -1)				// never written, so no
+	return kernel->stats->totalTicks + PageTransferTime; // flash to read
+    return Occupy((page / PagesPerBlock) % NumChannels,
+		  PageReadTime + PageTransferTime);
+}
+
+//----------------------------------------------------------------------
+// Ssd::WritePage
+// 	Write a new version of "sector" to a free page on "channel", and
+//	make the old version stale.  Return when that will be done.
+//----------------------------------------------------------------------
+
+int
+Ssd::WritePage(int sector, int channel)
+{
+    int oldPage = pageMap[sector];
+    int page = AllocatePage(channel);
+
+    if (oldPage != -1) {
+	owner[oldPage] = -1;
+	livePages[oldPage / PagesPerBlock]--;
+    }
+    pageMap[sector] = page;
+    owner[page] = sector;
+    livePages[page / PagesPerBlock]++;
+    return Occupy(channel, PageTransferTime + PageProgramTime);
+}
+
+//----------------------------------------------------------------------
+// Ssd::AllocatePage
+// 	Return the next free page of "channel", starting to fill a new
+//	block if need be.  Free blocks are kept from running out by
+//	collecting garbage first, when there are few of them.
+//----------------------------------------------------------------------
+
+int
+Ssd::AllocatePage(int channel)
+{
+    if (nextPage[channel] == PagesPerBlock && numFree[channel] < MinFreeBlocks)
+	Collect(channel);
+    if (nextPage[channel] == PagesPerBlock) {	// still no room
+	ASSERT(numFree[channel] > 0);		// out of spare blocks
+	activeBlock[channel] = freeBlocks[channel][--numFree[channel]];
+	nextPage[channel] = 0;
+    }
+    return activeBlock[channel] * PagesPerBlock + nextPage[channel]++;
+}
+
+//----------------------------------------------------------------------
+// Ssd::Collect
+// 	Collect garbage on "channel": erase the blocks with the fewest
+//	live pages, after copying those pages into the block being
+//	filled, until there are MinFreeBlocks free blocks again.  The
+//	copies stay inside the flash, so they don't use the channel's
+//	bus.  The time is charged to the channel, so it delays the
+//	request that needed the space.
+//----------------------------------------------------------------------
+
+void
+Ssd::Collect(int channel)
+{
+    bool *isFree = new bool[NumFlashBlocks];
+    int victim, sector, page;
+
+    numCollections++;
+    for (int b = 0; b < NumFlashBlocks; b++)
+	isFree[b] = FALSE;
+    for (int i = 0; i < numFree[channel]; i++)
+	isFree[freeBlocks[channel][i]] = TRUE;
+
+    while (numFree[channel] < MinFreeBlocks) {
+	victim = -1;
+	for (int b = channel; b < NumFlashBlocks; b += NumChannels)
+	    if (!isFree[b] && b != activeBlock[channel]
+			&& (victim == -1 || livePages[b] < livePages[victim]))
+		victim = b;
+	ASSERT(victim != -1 && livePages[victim] < PagesPerBlock);
+	DEBUG(dbgDisk, "Collecting block " << victim << ", "
+		<< livePages[victim] << " live pages");
+
+	for (int p = victim * PagesPerBlock; livePages[victim] > 0; p++) {
+	    if ((sector = owner[p]) == -1)
+		continue;			// stale
+	    if (nextPage[channel] == PagesPerBlock) {
+		ASSERT(numFree[channel] > 0);
+		activeBlock[channel] = freeBlocks[channel][--numFree[channel]];
+		isFree[activeBlock[channel]] = FALSE;
+		nextPage[channel] = 0;
+	    }
+	    page = activeBlock[channel] * PagesPerBlock + nextPage[channel]++;
+	    owner[p] = -1;
+	    livePages[victim]--;
+	    pageMap[sector] = page;
+	    owner[page] = sector;
+	    livePages[page / PagesPerBlock]++;
+	    Occupy(channel, PageReadTime + PageProgramTime);
+	    collectWrites++;
+	}
+	Occupy(channel, BlockEraseTime);
+	numErases++;
+	freeBlocks[channel][numFree[channel]++] = victim;
+	isFree[victim] = TRUE;
+    }
+    delete [] isFree;
+}
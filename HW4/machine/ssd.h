@@ -0,0 +1,109 @@
+// ssd.h
+//	Data structures to emulate a flash disk (SSD), as an alternative
+//	to the rotating disk of disk.h.  Requests are sent and completed
+//	just as for a Disk; only their timing differs.
+//
+//	Flash is read and written a "page" at a time, but a page can't be
+//	rewritten in place: it has to be erased first, and erasing works
+//	only on a whole "erase block" of pages, which is slow.  So an SSD
+//	has a "flash translation layer" (FTL) that writes each new version
+//	of a sector to a fresh page, and keeps a map from sector number to
+//	page.  The old page is left "stale".  When free blocks run short,
+//	the "garbage collector" picks a block with few live pages, copies
+//	them elsewhere, and erases the block.  Those copies are writes
+//	the file system never asked for: "write amplification" is the
+//	number of pages written to flash per page written by the host.
+//
+//	The flash is split among several "channels", each working
+//	independently of the others; the pages of one request are read
+//	or written in parallel, as far as they are on different channels.
+//	Each channel works through what it is given in order, so any
+//	number of requests can be outstanding: each completes when the
+//	last of its pages is done.
+//
+//	Here, one page holds one sector.  The sector contents are kept in
+//	the UNIX file just as for a Disk (so an image can be used with
+//	either); the FTL is only used to work out how long each request
+//	takes.  The FTL starts out as if every sector had been written
+//	once, in order -- a device that has been in use for a while --
+//	so that garbage collection begins soon after writing starts.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef SSD_H
+#define SSD_H
+
+#include "copyright.h"
+#include "disk.h"
+
+const int PagesPerBlock = 64;		// pages per erase block
+const int NumChannels = 4;		// independent parts of the flash
+const int NumFlashBlocks = (NumSectors / PagesPerBlock) * 17 / 16;
+					// 1/16 more than the sectors need,
+					// as room for the garbage collector
+const int BlocksPerChannel = NumFlashBlocks / NumChannels;
+const int MinFreeBlocks = 2;		// collect garbage on a channel with
+					// fewer free blocks than this
+
+// The following class defines a flash disk.  Flash block "b" is on
+// channel b % NumChannels, and holds pages b * PagesPerBlock up to
+// (b + 1) * PagesPerBlock - 1.  Each channel fills one block at a
+// time, and writes are dealt out to the channels in turn.
+
+class Ssd : public Disk {
+  public:
+    Ssd(char *name, char *baseName, CallBackObj *toCall);
+    					// Create a simulated flash disk,
+					// kept in UNIX file "name" (see
+					// Disk::Disk)
+    ~Ssd();				// Deallocate the flash disk.
+
+    void ReadRequest(int sectorNumber, char* data, int numSectors,
+		     CallBackObj *toCall);
+    void WriteRequest(int sectorNumber, char* data, int numSectors,
+		      CallBackObj *toCall);
+    					// Read/write "numSectors" consecutive
+					// sectors in a single request, and
+					// call back "toCall" when done
+
+    int ComputeLatency(int newSector, bool writing);
+    					// How long a one-sector request
+					// sent now would take
+    int EstimateLatency(int *sectors, int numSectors);
+    					// How long reading "sectors" would
+					// take on an idle flash disk
+    void Print();			// Print FTL statistics
+
+  private:
+    int *pageMap;			// Flash page holding each sector,
+					// or -1 if it was never written
+    int *owner;				// Sector in each flash page, or -1
+					// if the page is free or stale
+    int *livePages;			// Pages in use in each block
+    int *freeBlocks[NumChannels];	// Erased blocks of each channel
+    int numFree[NumChannels];		// How many
+    int activeBlock[NumChannels];	// Block each channel is filling
+    int nextPage[NumChannels];		// Next page of that block to fill
+    int busyUntil[NumChannels];		// When each channel is done with
+					// the work it has been given
+    int nextChannel;			// Channel for the next write
+    bool timing;			// Charge time for flash operations?
+
+    int hostWrites;			// Statistics: pages written for
+    int collectWrites;			// the host, and by the garbage
+    int numErases;			// collector; blocks erased;
+    int numCollections;			// and times it ran
+
+    int Occupy(int channel, int ticks);	// Give a channel "ticks" of work;
+					// return when it will be done
+    int ReadPage(int sector);		// Read one sector; return when done
+    int WritePage(int sector, int channel);
+    					// Write one sector to a new page on
+					// "channel"; return when done
+    int AllocatePage(int channel);	// Next free page of "channel"
+    void Collect(int channel);		// Free some blocks of "channel"
+};
+
+#endif // SSD_H
@@ -22,6 +22,23 @@ Statistics::Statistics()
     numDiskReads = numDiskWrites = 0;
     numConsoleCharsRead = numConsoleCharsWritten = 0;
     numPageFaults = numPacketsSent = numPacketsRecvd = 0;
+    diskQueueWait = new Histogram("disk_queue_wait");
+    diskSeekTracks = new Histogram("disk_seek_tracks");
+    diskSeekTime = new Histogram("disk_seek_time");
+    diskRotation = new Histogram("disk_rotation");
+    diskTransfer = new Histogram("disk_transfer");
+    diskService = new Histogram("disk_service");
+    numTrackBufferHits = 0;
+}
+
+Statistics::~Statistics()
+{
+    delete diskQueueWait;
+    delete diskSeekTracks;
+    delete diskSeekTime;
+    delete diskRotation;
+    delete diskTransfer;
+    delete diskService;
 }
 
 //----------------------------------------------------------------------
@@ -42,4 +59,166 @@ Statistics::Print()
     cout << "Paging: faults " << numPageFaults << "\n";
     cout << "Network I/O: packets received " << numPacketsRecvd;
 		cout << ", sent " << numPacketsSent << "\n";
+    cout << "Disk requests: track buffer hits " << numTrackBufferHits << "\n";
+    diskQueueWait->Print();
+    diskSeekTracks->Print();
+    diskSeekTime->Print();
+    diskRotation->Print();
+    diskTransfer->Print();
+    diskService->Print();
+}
+
+//----------------------------------------------------------------------
+// Statistics::Export
+// 	Write the statistics to the UNIX file "fileName", for other
+//	programs to read.  There is one record per line, with fields
+//	separated by spaces; the first says what the record is:
+//
+//	    counter <name> <value>
+//	    histogram <name> <count> <total> <max> <p50> <p90> <p99>
+//	    bucket <name> <low> <high> <count>
+//
+//	Only buckets that aren't empty are written.
+//----------------------------------------------------------------------
+
+void
+Statistics::Export(char *fileName)
+{
+    FILE *file = fopen(fileName, "w");
+
+    if (file == NULL) {
+	cerr << "Unable to write statistics to " << fileName << "\n";
+	return;
+    }
+    fprintf(file, "counter total_ticks %d\n", totalTicks);
+    fprintf(file, "counter idle_ticks %d\n", idleTicks);
+    fprintf(file, "counter system_ticks %d\n", systemTicks);
+    fprintf(file, "counter user_ticks %d\n", userTicks);
+    fprintf(file, "counter disk_reads %d\n", numDiskReads);
+    fprintf(file, "counter disk_writes %d\n", numDiskWrites);
+    fprintf(file, "counter disk_track_buffer_hits %d\n", numTrackBufferHits);
+    fprintf(file, "counter console_reads %d\n", numConsoleCharsRead);
+    fprintf(file, "counter console_writes %d\n", numConsoleCharsWritten);
+    fprintf(file, "counter page_faults %d\n", numPageFaults);
+    fprintf(file, "counter packets_received %d\n", numPacketsRecvd);
+    fprintf(file, "counter packets_sent %d\n", numPacketsSent);
+    diskQueueWait->Export(file);
+    diskSeekTracks->Export(file);
+    diskSeekTime->Export(file);
+    diskRotation->Export(file);
+    diskTransfer->Export(file);
+    diskService->Export(file);
+    fclose(file);
+}
+
+//----------------------------------------------------------------------
+// Histogram::Histogram
+// 	Initialize an empty histogram.
+//----------------------------------------------------------------------
+
+Histogram::Histogram(char *name)
+{
+    this->name = name;
+    count = 0;
+    total = 0;
+    max = 0;
+    for (int i = 0; i < NumBuckets; i++)
+	buckets[i] = 0;
+}
+
+//----------------------------------------------------------------------
+// Histogram::Record
+// 	Count "value" in its bucket: the number of bits needed to hold
+//	it.
+//----------------------------------------------------------------------
+
+void
+Histogram::Record(int value)
+{
+    int bucket = 0;
+
+    if (value < 0)
+	value = 0;
+    for (unsigned int v = value; v != 0; v >>= 1)
+	bucket++;
+    buckets[bucket]++;
+    count++;
+    total += value;
+    if (value > max)
+	max = value;
+}
+
+//----------------------------------------------------------------------
+// Histogram::Low/High
+// 	Return the smallest/largest value counted in "bucket".
+//----------------------------------------------------------------------
+
+int
+Histogram::Low(int bucket)
+{
+    return (bucket == 0) ? 0 : (1 << (bucket - 1));
+}
+
+int
+Histogram::High(int bucket)
+{
+    return (bucket == 0) ? 0 : (int) ((1u << bucket) - 1);
+}
+
+//----------------------------------------------------------------------
+// Histogram::Percentile
+// 	Return an upper bound on the "percent"'th percentile of the
+//	values: the largest value of the bucket it falls in, or the
+//	largest value recorded, if that is less.  0 if nothing was
+//	recorded.
+//----------------------------------------------------------------------
+
+int
+Histogram::Percentile(int percent)
+{
+    int seen = 0;
+
+    for (int i = 0; i < NumBuckets; i++) {
+	seen += buckets[i];
+	if (seen > 0 && (double) seen * 100 >= (double) count * percent)
+	    return (High(i) < max) ? High(i) : max;
+    }
+    return max;
+}
+
+//----------------------------------------------------------------------
+// Histogram::Print
+// 	Print how many values there were, their mean, maximum and
+//	percentiles, and then each bucket that isn't empty.  Print
+//	nothing if there were none.
+//----------------------------------------------------------------------
+
+void
+Histogram::Print()
+{
+    if (count == 0)
+	return;
+    cout << name << ": count " << count << ", mean " << (int) (total / count)
+	 << ", max " << max << ", p50 " << Percentile(50)
+	 << ", p90 " << Percentile(90) << ", p99 " << Percentile(99) << "\n";
+    for (int i = 0; i < NumBuckets; i++)
+	if (buckets[i] > 0)
+	    cout << "    " << Low(i) << ".." << High(i) << ": " 
+		 << buckets[i] << "\n";
+}
+
+//----------------------------------------------------------------------
+// Histogram::Export
+// 	Write the histogram to "file" (see Statistics::Export).
+//----------------------------------------------------------------------
+
+void
+Histogram::Export(FILE *file)
+{
+    fprintf(file, "histogram %s %d %.0f %d %d %d %d\n", name, count, total, 
+	    max, Percentile(50), Percentile(90), Percentile(99));
+    for (int i = 0; i < NumBuckets; i++)
+	if (buckets[i] > 0)
+	    fprintf(file, "bucket %s %d %d %d\n", name, Low(i), High(i), 
+		    buckets[i]);
 }
@@ -12,6 +12,37 @@
 #define STATS_H
 
 #include "copyright.h"
+#include <stdio.h>
+
+const int NumBuckets = 32;		// enough for any positive int
+
+// The following class defines a histogram with logarithmic buckets:
+// bucket 0 counts values of 0, and bucket "k" values from 2^(k-1) up
+// to 2^k - 1.  Values less than 0 are counted as 0.
+
+class Histogram {
+  public:
+    Histogram(char *name);		// "name" is used in the reports;
+					// it should have no spaces
+
+    void Record(int value);		// Count one more value
+    int Percentile(int percent);	// Upper end of the bucket holding
+					// the "percent"'th percentile
+
+    void Print();			// Print a summary, and the buckets
+    void Export(FILE *file);		// Write the same, one record per
+					// line (see Statistics::Export)
+
+  private:
+    char *name;
+    int count;				// Values recorded
+    double total;			// Their sum
+    int max;				// The largest
+    int buckets[NumBuckets];		// How many fell in each bucket
+
+    int Low(int bucket);		// Smallest value in a bucket
+    int High(int bucket);		// Largest value in a bucket
+};
 
 // The following class defines the statistics that are to be kept
 // about Nachos behavior -- how much time (ticks) elapsed, how
@@ -28,17 +59,30 @@ class Statistics {
 				// (this is also equal to # of
 				// user instructions executed)
 
-    int numDiskReads;		// number of disk read requests
-    int numDiskWrites;		// number of disk write requests
+    int numDiskReads;		// number of disk sectors read
+    int numDiskWrites;		// number of disk sectors written
     int numConsoleCharsRead;	// number of characters read from the keyboard
     int numConsoleCharsWritten; // number of characters written to the display
     int numPageFaults;		// number of virtual memory page faults
     int numPacketsSent;		// number of packets sent over the network
     int numPacketsRecvd;	// number of packets received over the network
 
+				// where the time of each disk request
+				// went, in ticks (see Disk::RecordLatency):
+    Histogram *diskQueueWait;	// waiting for the disk to take it
+    Histogram *diskSeekTracks;	// tracks the head moved
+    Histogram *diskSeekTime;	// seeking
+    Histogram *diskRotation;	// waiting for the sector to come round
+    Histogram *diskTransfer;	// transferring the sectors
+    Histogram *diskService;	// all of the last three
+    int numTrackBufferHits;	// reads served from the track buffer
+
     Statistics(); 		// initialize everything to zero
+    ~Statistics();
 
     void Print();		// print collected statistics
+    void Export(char *fileName);// write them to a file, for programs
+				// to read
 };
 
 // Constants used to reflect the relative time an operation would
@@ -55,6 +99,10 @@ const int RotationTime = 500; 	// time disk takes to rotate one sector
 const int SeekTime =	 500;  	// time disk takes to seek past one track
 const int ConsoleTime =	 100;	// time to read or write one character
 const int NetworkTime =	 100;  	// time to send or receive one packet
+const int PageReadTime =  50;	// time flash takes to read one page
+const int PageProgramTime = 250;// time flash takes to write one page
+const int BlockEraseTime = 2000;// time flash takes to erase one block
+const int PageTransferTime = 20;// time to move a page over a channel
 const int TimerTicks = 	 100;  	// (average) time between timer interrupts
 
 #endif // STATS_H
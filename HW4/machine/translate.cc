@@ -77,6 +77,9 @@ ShortToMachine(unsigned short shortword) { return ShortToHost(shortword); }
 //   	Returns FALSE if the translation step from virtual to physical memory
 //   	failed.
 //
+//	The page is looked up in "softTLB" first (see Remember), and only
+//	translated if it isn't there.
+//
 //	"addr" -- the virtual address to read from
 //	"size" -- the number of bytes to read (1, 2, or 4)
 //	"value" -- the place to write the result
@@ -88,27 +91,37 @@ Machine::ReadMem(int addr, int size, int *value)
     int data;
     ExceptionType exception;
     int physicalAddress;
+    unsigned int vpn = (unsigned) addr / PageSize;
+    SoftTLBEntry *cached = &softTLB[vpn % SoftTLBSize];
+    TranslationEntry *entry;
+    char *host;
     
     DEBUG(dbgAddr, "Reading VA " << addr << ", size " << size);
     
-    exception = Translate(addr, &physicalAddress, size, FALSE);
-    if (exception != NoException) {
-	RaiseException(exception, addr);
-	return FALSE;
+    if (cached->vpn == vpn && !(addr & (size - 1))) {
+	host = cached->read + (unsigned) addr % PageSize;
+    } else {
+	exception = Translate(addr, &physicalAddress, size, FALSE, &entry);
+	if (exception != NoException) {
+	    RaiseException(exception, addr);
+	    return FALSE;
+	}
+	host = &mainMemory[physicalAddress];
+	Remember(vpn, physicalAddress, entry);
     }
     switch (size) {
       case 1:
-	data = mainMemory[physicalAddress];
+	data = *host;
 	*value = data;
 	break;
 	
       case 2:
-	data = *(unsigned short *) &mainMemory[physicalAddress];
+	data = *(unsigned short *) host;
 	*value = ShortToHost(data);
 	break;
 	
       case 4:
-	data = *(unsigned int *) &mainMemory[physicalAddress];
+	data = *(unsigned int *) host;
 	*value = WordToHost(data);
 	break;
 
@@ -127,6 +140,9 @@ Machine::ReadMem(int addr, int size, int *value)
 //   	Returns FALSE if the translation step from virtual to physical memory
 //   	failed.
 //
+//	As in ReadMem, the page is looked up in "softTLB" first; but the
+//	first write to a page is always translated, to set its dirty bit.
+//
 //	"addr" -- the virtual address to write to
 //	"size" -- the number of bytes to be written (1, 2, or 4)
 //	"value" -- the data to be written
@@ -137,26 +153,38 @@ Machine::WriteMem(int addr, int size, int value)
 {
     ExceptionType exception;
     int physicalAddress;
+    unsigned int vpn = (unsigned) addr / PageSize;
+    SoftTLBEntry *cached = &softTLB[vpn % SoftTLBSize];
+    TranslationEntry *entry;
+    char *host;
      
     DEBUG(dbgAddr, "Writing VA " << addr << ", size " << size << ", value " << value);
 
-    exception = Translate(addr, &physicalAddress, size, TRUE);
-    if (exception != NoException) {
-	RaiseException(exception, addr);
-	return FALSE;
+    if (cached->vpn == vpn && cached->write != NULL && !(addr & (size - 1))) {
+	host = cached->write + (unsigned) addr % PageSize;
+    } else {
+	exception = Translate(addr, &physicalAddress, size, TRUE, &entry);
+	if (exception != NoException) {
+	    RaiseException(exception, addr);
+	    return FALSE;
+	}
+	host = &mainMemory[physicalAddress];
+	Remember(vpn, physicalAddress, entry);
     }
+    if (codeFrame[(host - mainMemory) / PageSize])
+	codeWritten = TRUE;		// blocks may have to be decoded again
     switch (size) {
       case 1:
-	mainMemory[physicalAddress] = (unsigned char) (value & 0xff);
+	*host = (unsigned char) (value & 0xff);
 	break;
 
       case 2:
-	*(unsigned short *) &mainMemory[physicalAddress]
+	*(unsigned short *) host
 		= ShortToMachine((unsigned short) (value & 0xffff));
 	break;
       
       case 4:
-	*(unsigned int *) &mainMemory[physicalAddress]
+	*(unsigned int *) host
 		= WordToMachine((unsigned int) value);
 	break;
 	
@@ -166,6 +194,52 @@ Machine::WriteMem(int addr, int size, int value)
     return TRUE;
 }
 
+//----------------------------------------------------------------------
+// Machine::Remember
+// 	Keep the translation of virtual page "vpn", just made by Translate
+//	from "entry", in "softTLB": where the page is in main memory, for
+//	reads, and for writes too if the page is already dirty and may
+//	be written.  ReadMem and WriteMem can then reach the page with no
+//	more than an add, until the entry is replaced by another page
+//	with the same index, or the kernel calls FlushTranslations.
+//
+//	Since the use bit (and the dirty bit, for writes) is already set
+//	when a page is remembered, later accesses needn't set it again --
+//	so long as the kernel flushes whenever it clears those bits.
+//	With a TLB, nothing is remembered: the kernel loads the TLB
+//	itself.
+//----------------------------------------------------------------------
+
+void
+Machine::Remember(unsigned int vpn, int physAddr, TranslationEntry *entry)
+{
+    SoftTLBEntry *cached = &softTLB[vpn % SoftTLBSize];
+
+    if (tlb != NULL)
+	return;
+    cached->vpn = vpn;
+    cached->read = &mainMemory[physAddr - physAddr % PageSize];
+    if (entry->dirty && !entry->readOnly)
+	cached->write = cached->read;
+    else
+	cached->write = NULL;
+}
+
+//----------------------------------------------------------------------
+// Machine::FlushTranslations
+// 	Forget every translation kept in "softTLB".  The kernel must call
+//	this whenever it changes the page table, or switches to another.
+//----------------------------------------------------------------------
+
+void
+Machine::FlushTranslations()
+{
+    for (int i = 0; i < SoftTLBSize; i++) {
+	softTLB[i].vpn = (unsigned) -1;		// no such page
+	softTLB[i].read = softTLB[i].write = NULL;
+    }
+}
+
 //----------------------------------------------------------------------
 // Machine::Translate
 // 	Translate a virtual address into a physical address, using 
@@ -179,10 +253,13 @@ Machine::WriteMem(int addr, int size, int value)
 //	"physAddr" -- the place to store the physical address
 //	"size" -- the amount of memory being read or written
 // 	"writing" -- if TRUE, check the "read-only" bit in the TLB
+//	"entryPtr" -- if not NULL, the place to store the translation
+//		entry used
 //----------------------------------------------------------------------
 
 ExceptionType
-Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
+Machine::Translate(int virtAddr, int* physAddr, int size, bool writing,
+		   TranslationEntry **entryPtr)
 {
     int i;
     unsigned int vpn, offset;
@@ -244,6 +321,8 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
     if (writing)
 	entry->dirty = TRUE;
     *physAddr = pageFrame * PageSize + offset;
+    if (entryPtr != NULL)
+	*entryPtr = entry;
     ASSERT((*physAddr >= 0) && ((*physAddr + size) <= MemorySize));
     DEBUG(dbgAddr, "phys addr = " << *physAddr);
     return NoException;
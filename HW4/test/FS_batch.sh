@@ -0,0 +1,22 @@
+../build.linux/nachos -f -batch - <<EOF
+# same as FS_bonusIII.sh, in a single run
+-mkdir /t0
+-mkdir /t1
+-mkdir /t2
+-cp num_100.txt /t0/f1
+-mkdir /t0/aa
+-mkdir /t0/bb
+-mkdir /t0/cc
+-cp num_100.txt /t0/aa/f1
+-cp num_100.txt /t0/bb/f2
+-cp num_100.txt /t0/cc/f3
+-cp num_100.txt /t0/bb/f4
+-mkdir /t0/aa/momo
+-cp num_100.txt /t0/aa/momo/f1
+-lr /
+-r /t0/bb/f2
+-rr /t0/aa
+-lr /t0
+-rr /t0/bb
+-lr /
+EOF
@@ -0,0 +1,19 @@
+make
+../build.linux/nachos -f
+../build.linux/nachos -cp num_1000.txt /1000
+../build.linux/nachos -clone /1000 /1000_clone
+# write into /1000 in place; the clone must keep the old data
+../build.linux/nachos -cp FS_test7 /FS_test7
+../build.linux/nachos -e /FS_test7
+echo "========================================="
+../build.linux/nachos -p /1000 | head -c 120
+echo
+../build.linux/nachos -p /1000_clone > clone.out
+cmp clone.out num_1000.txt && echo "/1000_clone unchanged"
+echo "========================================="
+../build.linux/nachos -r /1000
+../build.linux/nachos -p /1000_clone > clone.out
+cmp clone.out num_1000.txt && echo "/1000_clone unchanged"
+rm -f clone.out
+echo "========================================="
+../build.linux/nachos -l /
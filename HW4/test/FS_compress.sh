@@ -0,0 +1,7 @@
+../build.linux/nachos -f
+../build.linux/nachos -cp num_1000.txt /1000
+../build.linux/nachos -cpz num_1000.txt /1000z
+echo "========================================="
+../build.linux/nachos -p /1000
+echo "========================================="
+../build.linux/nachos -p /1000z
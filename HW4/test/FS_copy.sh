@@ -0,0 +1,8 @@
+make clean
+make
+../build.linux/nachos -f
+../build.linux/nachos -cp FS_test1 /FS_test1
+../build.linux/nachos -e /FS_test1
+../build.linux/nachos -cp FS_test5 /FS_test5
+../build.linux/nachos -e /FS_test5
+../build.linux/nachos -p /file3
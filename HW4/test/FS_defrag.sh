@@ -0,0 +1,45 @@
+make -C ../build.linux fsinspect
+../build.linux/nachos -f
+# small files, every other one to be removed later, leaving holes of 9
+# sectors (a header and 8 data sectors) between the others
+for i in 0 1 2 3 4 5 6 7 8 9 10 11
+do
+	../build.linux/nachos -cp num_100.txt /a$i
+	../build.linux/nachos -cp num_100.txt /b$i
+done
+# fill the rest of the disk, so that no run is left for the data of a
+# header (28 sectors), and Allocate has to take the sectors one by one.
+# Each big file is 2 * 8120 data sectors and 2 * 290 headers; the last
+# takes what is left, at 28 data sectors per header.
+../build.linux/nachos -mkdir /fill
+free=$(../build.linux/fsinspect DISK_0 df | awk '/ free$/ {print $8}')
+head -c 2078720 /dev/zero > fill.big
+n=0
+while [ $free -ge 16820 ]
+do
+	../build.linux/nachos -cp fill.big /fill/f$n
+	free=$((free - 16820))
+	n=$((n + 1))
+done
+if [ $free -gt 1 ]
+then
+	head -c $(((free - (free + 28) / 29) * 128)) /dev/zero > fill.big
+	../build.linux/nachos -cp fill.big /fill/f$n
+fi
+rm -f fill.big
+for i in 0 1 2 3 4 5 6 7 8 9 10 11
+do
+	../build.linux/nachos -r /b$i
+done
+../build.linux/nachos -cp num_1000.txt /1000
+../build.linux/nachos -rr /fill
+../build.linux/fsinspect DISK_0 frag
+echo "========================================="
+../build.linux/nachos -defrag | tee defrag.out
+grep -q "defrag: 0 files moved" defrag.out && echo "Failed: nothing was moved"
+rm -f defrag.out
+echo "========================================="
+../build.linux/fsinspect DISK_0 frag
+../build.linux/nachos -p /1000 > defrag.out
+cmp defrag.out num_1000.txt && echo "/1000 unchanged"
+rm -f defrag.out
@@ -0,0 +1,20 @@
+make clean
+make
+make -C ../build.linux nachos nachos_threaded
+# the test programs must print the same, down to the tick counts in
+# their statistics, on the switch and the threaded simulator
+for nachos in nachos nachos_threaded
+do
+	../build.linux/$nachos -f
+	../build.linux/$nachos -cp num_1000.txt /1000	# for FS_test7
+	../build.linux/$nachos -clone /1000 /1000_clone
+	for prog in FS_test1 FS_test2 FS_test3 FS_test4 FS_test5 FS_test6 FS_test7 matmult sort
+	do
+		../build.linux/$nachos -cp $prog /$prog
+		../build.linux/$nachos -stats dispatch_stats.txt -e /$prog
+		cat dispatch_stats.txt
+	done > dispatch.$nachos
+done
+grep "^Ticks" dispatch.nachos
+cmp dispatch.nachos dispatch.nachos_threaded && echo "same output"
+rm -f dispatch_stats.txt dispatch.nachos dispatch.nachos_threaded
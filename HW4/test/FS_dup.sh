@@ -0,0 +1,8 @@
+make clean
+make
+../build.linux/nachos -f
+../build.linux/nachos -cp FS_test1 /FS_test1
+../build.linux/nachos -e /FS_test1
+echo "========================================="
+../build.linux/nachos -cp FS_test3 /FS_test3
+../build.linux/nachos -e /FS_test3
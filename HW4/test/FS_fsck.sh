@@ -0,0 +1,25 @@
+make -C ../build.linux fsinspect
+../build.linux/nachos -f
+../build.linux/nachos -mkdir /t0
+../build.linux/nachos -mkdir /t0/aa
+../build.linux/nachos -cp num_100.txt /t0/f1
+../build.linux/nachos -cp num_1000.txt /t0/aa/f2
+../build.linux/nachos -r /t0/f1
+echo "========================================="
+../build.linux/fsinspect DISK_0 fsck
+echo "========================================="
+# damage the free map, through the data sectors listed in its header
+# (sector 0; after the 4 byte magic number and 4 ints of header).  Its
+# first data sector starts with the byte for sectors 0-7, all in use;
+# its 21st with the byte for sectors 20480-20487, all free.
+firstSector=$(od -An -t d4 -j 20 -N 4 DISK_0)
+farSector=$(od -An -t d4 -j 100 -N 4 DISK_0)
+printf '\000' | dd of=DISK_0 bs=1 seek=$((4 + firstSector * 128)) conv=notrunc 2> /dev/null
+printf '\377' | dd of=DISK_0 bs=1 seek=$((4 + farSector * 128)) conv=notrunc 2> /dev/null
+../build.linux/fsinspect DISK_0 fsck
+../build.linux/fsinspect -j 1 DISK_0 fsck
+echo "========================================="
+../build.linux/fsinspect DISK_0 fsck repair
+echo "========================================="
+../build.linux/fsinspect DISK_0 fsck
+../build.linux/nachos -lr /
@@ -0,0 +1,22 @@
+make clean
+make
+# the test programs must print the same, down to the tick counts in
+# their statistics, whether run an instruction at a time (hot.none), a
+# block at a time (hot.0), or with every block compiled after its
+# first run (hot.1)
+for hot in none 0 1
+do
+	flags="-hot $hot"
+	[ $hot = none ] && flags="-noblocks"
+	../build.linux/nachos -f
+	for prog in FS_test1 FS_test2 FS_test3 FS_test4 FS_test5 FS_test6
+	do
+		../build.linux/nachos -cp $prog /$prog
+		../build.linux/nachos $flags -stats hot_stats.txt -e /$prog
+		cat hot_stats.txt
+	done > hot.$hot
+done
+grep "^Ticks" hot.0
+cmp hot.none hot.0 && echo "blocks: same output"
+cmp hot.0 hot.1 && echo "compiled: same output"
+rm -f hot_stats.txt hot.none hot.0 hot.1
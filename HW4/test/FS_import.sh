@@ -0,0 +1,14 @@
+rm -rf import_tree
+mkdir -p import_tree/t0/aa import_tree/t1
+cp num_100.txt import_tree/f1
+cp num_1000.txt import_tree/t0/f2
+cp num_100.txt import_tree/t0/aa/f3
+cp num_1000.txt import_tree/t1/f4
+cp num_100.txt import_tree/t1/too_long_name
+../build.linux/nachos -f
+../build.linux/nachos -cpr import_tree /
+echo "========================================="
+../build.linux/nachos -lr /
+echo "========================================="
+../build.linux/nachos -p /t1/f4
+rm -rf import_tree
@@ -0,0 +1,12 @@
+make -C ../build.linux fsinspect
+../build.linux/nachos -f
+../build.linux/nachos -mkdir /t0
+../build.linux/nachos -cp num_100.txt /t0/f1
+../build.linux/nachos -cp num_1000.txt /t0/f2
+echo "========================================="
+../build.linux/fsinspect DISK_0 lsr /
+../build.linux/fsinspect DISK_0 stat /t0/f2
+../build.linux/fsinspect DISK_0 frag
+../build.linux/fsinspect DISK_0 df
+echo "========================================="
+../build.linux/fsinspect DISK_0 cat /t0/f1
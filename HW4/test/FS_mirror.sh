@@ -0,0 +1,12 @@
+rm -rf import_tree
+mkdir -p import_tree/t0
+cp num_1000.txt import_tree/f1
+cp num_1000.txt import_tree/t0/f2
+../build.linux/nachos -mirror 2 -f
+../build.linux/nachos -mirror 2 -cpr import_tree /
+echo "========================================="
+../build.linux/nachos -mirror 2 -p /f1
+../build.linux/nachos -mirror 2 -p /t0/f2
+echo "========================================="
+../build.linux/nachos -mirror 2 -lr /
+rm -rf import_tree DISK_0_0 DISK_0_1
@@ -0,0 +1,33 @@
+rm -rf import_tree
+mkdir -p import_tree/t0 import_tree/t1
+cp num_1000.txt import_tree/f1
+cp num_1000.txt import_tree/t0/f2
+cp num_1000.txt import_tree/t1/f3
+../build.linux/nachos -ncq 8 -f
+../build.linux/nachos -ncq 8 -cpr import_tree /
+../build.linux/nachos -ncq 8 -lr /
+echo "========================================="
+../build.linux/nachos -ncq 8 -p /t1/f3
+echo "========================================="
+# three kernel threads read /1000, near the start of the disk, and one
+# /far, at the same time: with -ncq 8 their requests are queued together
+# at the disk, which takes the closest first, but never passes over
+# /far's more than MaxPassOvers times.  Every read is checked; compare
+# the ticks and queue waits with one request at a time.
+../build.linux/nachos -f
+../build.linux/nachos -cp num_1000.txt /1000
+for i in 0 1 2 3 4 5 6 7; do
+	../build.linux/nachos -cp num_1000.txt /filler$i
+done
+../build.linux/nachos -cp num_1000.txt /far
+for depth in 1 8; do
+	echo "-ncq $depth"
+	../build.linux/nachos -ncq $depth -stats ncq_stats.txt -readtest /1000 /far \
+		| grep "^Read test"
+	grep "total_ticks\|disk_reads\|^histogram" ncq_stats.txt
+done
+echo "========================================="
+../build.linux/nachos -ncq 8 -mirror 2 -f
+../build.linux/nachos -ncq 8 -mirror 2 -cpr import_tree /
+../build.linux/nachos -ncq 8 -mirror 2 -p /t0/f2
+rm -rf import_tree ncq_stats.txt DISK_0_0 DISK_0_1
@@ -0,0 +1,12 @@
+../build.linux/nachos -f
+../build.linux/nachos -mkdir /t0
+../build.linux/nachos -cp num_100.txt /t0/f1
+mv DISK_0 DISK_base
+echo "========================================="
+../build.linux/nachos -ov DISK_base -cp num_1000.txt /t0/f2
+../build.linux/nachos -lr /
+ls -l DISK_0
+echo "========================================="
+../build.linux/nachos -ov DISK_base -lr /
+../build.linux/nachos -m 1 -ov DISK_base -p /t0/f1
+rm -f DISK_0 DISK_1 DISK_base
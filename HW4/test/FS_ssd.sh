@@ -0,0 +1,14 @@
+rm -rf import_tree
+mkdir -p import_tree/t0
+cp num_1000.txt import_tree/f1
+cp num_1000.txt import_tree/t0/f2
+cp num_1000.txt import_tree/t0/f3
+../build.linux/nachos -ssd -f
+../build.linux/nachos -ssd -cpr import_tree /
+../build.linux/nachos -ssd -lr /
+echo "========================================="
+../build.linux/nachos -ssd -p /t0/f3
+echo "========================================="
+../build.linux/nachos -ssd -r /t0/f2
+../build.linux/nachos -ssd -cp num_1000.txt /t0/f2
+rm -rf import_tree
@@ -0,0 +1,9 @@
+../build.linux/nachos -f
+../build.linux/nachos -cp num_1000.txt /f1
+echo "========================================="
+../build.linux/nachos -stats disk_stats.txt -p /f1 > /dev/null
+grep "^histogram" disk_stats.txt
+echo "========================================="
+../build.linux/nachos -ncq 8 -wcache 64 -stats disk_stats.txt -cp num_1000.txt /f2
+grep "^histogram\|track_buffer" disk_stats.txt
+rm -f disk_stats.txt
@@ -0,0 +1,14 @@
+rm -rf import_tree
+mkdir -p import_tree/t0
+cp num_1000.txt import_tree/f1
+cp num_1000.txt import_tree/t0/f2
+cp num_1000.txt import_tree/t0/f3
+echo "========== one disk =========="
+../build.linux/nachos -f
+../build.linux/nachos -cpr import_tree /
+echo "========== four disks =========="
+../build.linux/nachos -stripe 4 32 -f
+../build.linux/nachos -stripe 4 32 -cpr import_tree /
+../build.linux/nachos -stripe 4 32 -lr /
+../build.linux/nachos -stripe 4 32 -p /t0/f3
+rm -rf import_tree DISK_0_0 DISK_0_1 DISK_0_2 DISK_0_3
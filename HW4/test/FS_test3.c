@@ -0,0 +1,33 @@
+#include "syscall.h"
+
+int main(void)
+{
+	// you should run FS_test1 first before running this one
+	char test[27];
+	char check[] = "abcdefghijklmnopqrstuvwxyz\n";
+	OpenFileId fid, dupfid;
+	int count, success, i;
+	fid = Open("/file1");
+	if (fid < 0) MSG("Failed on opening file");
+	dupfid = Dup(fid);
+	if (dupfid < 0 || dupfid == fid) MSG("Failed on duplicating file id");
+	// both ids share one seek position
+	count = Read(test, 13, fid);
+	if (count != 13) MSG("Failed on reading file");
+	count = Read(test + 13, 14, dupfid);
+	if (count != 14) MSG("Failed on reading duplicated id");
+	success = Close(fid);
+	if (success != 1) MSG("Failed on closing file");
+	if (Read(test, 1, fid) != -1) MSG("Failed: read from closed id");
+	if (Read(test, 1, dupfid) != 0) MSG("Failed: duplicated id closed too");
+	success = Close(dupfid);
+	if (success != 1) MSG("Failed on closing duplicated id");
+	for (i = 0; i < 27; ++i) {
+		if (test[i] != check[i]) MSG("Failed: reading wrong result");
+	}
+	// left open on purpose; it is closed when the program exits
+	fid = Open("/file1");
+	if (fid < 0) MSG("Failed on reopening file");
+	MSG("Passed! ^_^");
+	Halt();
+}
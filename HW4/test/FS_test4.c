@@ -0,0 +1,46 @@
+#include "syscall.h"
+
+int main(void)
+{
+	char head[] = "abcdefghijklm";
+	char tail[] = "nopqrstuvwxyz\n";
+	char check[] = "abcdefghijklmnopqrstuvwxyz\n";
+	char test[27];
+	IoVec iov[2];
+	OpenFileId fid;
+	int count, success, i;
+	success = Create("/file2", 27);
+	if (success != 1) MSG("Failed on creating file");
+	fid = Open("/file2");
+	if (fid < 0) MSG("Failed on opening file");
+	// one trap writes both halves
+	iov[0].buffer = head;
+	iov[0].size = 13;
+	iov[1].buffer = tail;
+	iov[1].size = 14;
+	count = WriteV(iov, 2, fid);
+	if (count != 27) MSG("Failed on writing vector");
+	// positional I/O leaves the seek position alone
+	count = PWrite("Z", 1, 25, fid);
+	if (count != 1) MSG("Failed on positional write");
+	count = PRead(test, 2, 24, fid);
+	if (count != 2 || test[0] != 'y' || test[1] != 'Z') MSG("Failed on positional read");
+	count = PWrite("z", 1, 25, fid);
+	if (count != 1) MSG("Failed on positional write");
+	if (Read(test, 1, fid) != 0) MSG("Failed: seek position moved");
+	success = Seek(0, fid);
+	if (success != 1) MSG("Failed on seeking");
+	iov[0].buffer = test;
+	iov[0].size = 10;
+	iov[1].buffer = test + 10;
+	iov[1].size = 17;
+	count = ReadV(iov, 2, fid);
+	if (count != 27) MSG("Failed on reading vector");
+	for (i = 0; i < 27; ++i) {
+		if (test[i] != check[i]) MSG("Failed: reading wrong result");
+	}
+	success = Close(fid);
+	if (success != 1) MSG("Failed on closing file");
+	MSG("Passed! ^_^");
+	Halt();
+}
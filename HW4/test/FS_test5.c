@@ -0,0 +1,28 @@
+#include "syscall.h"
+
+int main(void)
+{
+	// you should run FS_test1 first before running this one
+	char test[27];
+	char check[] = "abcdefghijklmnopqrstuvwxyz\n";
+	OpenFileId src, dst;
+	int count, success, i;
+	success = Create("/file3", 27);
+	if (success != 1) MSG("Failed on creating file");
+	src = Open("/file1");
+	if (src < 0) MSG("Failed on opening file");
+	dst = Open("/file3");
+	if (dst < 0) MSG("Failed on opening file");
+	// the whole file, in a single trap
+	count = CopyFile(src, dst, 0, 1000);
+	if (count != 27) MSG("Failed on copying file");
+	count = Read(test, 27, dst);
+	if (count != 27) MSG("Failed on reading copy");
+	for (i = 0; i < 27; ++i) {
+		if (test[i] != check[i]) MSG("Failed: reading wrong result");
+	}
+	Close(src);
+	Close(dst);
+	MSG("Passed! ^_^");
+	Halt();
+}
@@ -0,0 +1,30 @@
+#include "syscall.h"
+
+int main(void)
+{
+	// you should run FS_test1 first before running this one
+	char test[27];
+	char check[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ\n";
+	char *map;
+	OpenFileId fid;
+	int count, success, i;
+	fid = Open("/file1");
+	if (fid < 0) MSG("Failed on opening file");
+	map = Mmap(fid, 27);
+	if (map == (char *) -1) MSG("Failed on mapping file");
+	// the first touch faults the page in from the file
+	if (map[0] != 'a' || map[25] != 'z') MSG("Failed: mapped wrong data");
+	for (i = 0; i < 26; ++i)
+		map[i] = map[i] - 'a' + 'A';
+	success = Munmap(map);
+	if (success != 1) MSG("Failed on unmapping file");
+	count = Read(test, 27, fid);
+	if (count != 27) MSG("Failed on reading file");
+	for (i = 0; i < 27; ++i) {
+		if (test[i] != check[i]) MSG("Failed: changes not written back");
+	}
+	success = Close(fid);
+	if (success != 1) MSG("Failed on closing file");
+	MSG("Passed! ^_^");
+	Halt();
+}
@@ -0,0 +1,39 @@
+#include "syscall.h"
+
+int main(void)
+{
+	// /1000 must hold num_1000.txt, and /1000_clone be a clone of it
+	char buf[10];
+	char check[] = "000000000";
+	OpenFileId fid;
+	int count, success, i;
+	fid = Open("/1000");
+	if (fid < 0) MSG("Failed on opening file");
+	// write over shared sectors, at the start and further in
+	count = PWrite("XXXXXXXXX", 9, 0, fid);
+	if (count != 9) MSG("Failed on writing file");
+	count = PWrite("XXXXXXXXX", 9, 500, fid);
+	if (count != 9) MSG("Failed on writing file");
+	count = PRead(buf, 9, 0, fid);
+	if (count != 9 || buf[0] != 'X' || buf[8] != 'X')
+		MSG("Failed: write not seen in the file");
+	success = Close(fid);
+	if (success != 1) MSG("Failed on closing file");
+	// the clone still has the old data
+	fid = Open("/1000_clone");
+	if (fid < 0) MSG("Failed on opening clone");
+	count = PRead(buf, 9, 0, fid);
+	if (count != 9) MSG("Failed on reading clone");
+	for (i = 0; i < 9; ++i) {
+		if (buf[i] != check[i]) MSG("Failed: clone changed too");
+	}
+	count = PRead(buf, 9, 500, fid);
+	if (count != 9) MSG("Failed on reading clone");
+	for (i = 0; i < 9; ++i) {
+		if (buf[i] == 'X') MSG("Failed: clone changed too");
+	}
+	success = Close(fid);
+	if (success != 1) MSG("Failed on closing clone");
+	MSG("Passed! ^_^");
+	Halt();
+}
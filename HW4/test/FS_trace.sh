@@ -0,0 +1,16 @@
+rm -rf import_tree
+mkdir -p import_tree/t0 import_tree/t1
+cp num_1000.txt import_tree/f1
+cp num_1000.txt import_tree/t0/f2
+cp num_1000.txt import_tree/t1/f3
+../build.linux/nachos -f
+../build.linux/nachos -trace disk_trace -cpr import_tree /
+echo "========================================="
+../build.linux/nachos -replay disk_trace
+echo "========================================="
+../build.linux/nachos -ncq 8 -replay disk_trace
+echo "========================================="
+../build.linux/nachos -ncq 8 -wcache 64 -replay disk_trace
+echo "========================================="
+../build.linux/nachos -ssd -replay disk_trace
+rm -rf import_tree disk_trace
@@ -0,0 +1,22 @@
+rm -rf import_tree
+mkdir -p import_tree/t0 import_tree/t1
+cp num_1000.txt import_tree/f1
+cp num_1000.txt import_tree/t0/f2
+cp num_1000.txt import_tree/t1/f3
+../build.linux/nachos -wcache 64 -f
+../build.linux/nachos -wcache 64 -cpr import_tree /
+../build.linux/nachos -wcache 64 -lr /
+echo "========================================="
+../build.linux/nachos -wcache 64 -p /t1/f3
+echo "========================================="
+../build.linux/nachos -wcache 64 -ncq 8 -r /t0/f2
+../build.linux/nachos -wcache 64 -ncq 8 -lr /
+echo "========================================="
+# every Create and Remove waits for a flush of the write cache; the
+# "Write cache:" line shows how many there were, and what was destaged
+../build.linux/nachos -wcache 8 -cp num_1000.txt /f4
+../build.linux/nachos -wcache 8 -ncq 8 -cp num_100.txt /f5
+../build.linux/nachos -wcache 8 -p /f5
+../build.linux/nachos -wcache 8 -r /f4
+../build.linux/nachos -wcache 8 -lr /
+rm -rf import_tree
@@ -17,6 +17,7 @@
 #include "synchdisk.h"
 #include "post.h"
 #include "synchconsole.h"
+#include "filetable.h"
 
 //----------------------------------------------------------------------
 // Kernel::Kernel
@@ -36,9 +37,21 @@ Kernel::Kernel(int argc, char **argv)
     reliability = 1;            // network reliability, default is 1.0
     hostName = 0;               // machine id, also UNIX socket name
                                 // 0 is the default machine id
+    overlayBase = NULL;         // default is a plain disk image
+    numDisks = 1;               // default is a single disk
+    stripeUnit = SectorsPerTrack;
+    mirrored = FALSE;
+    flash = FALSE;              // default is a rotating disk
+    queueDepth = 1;             // default is one request at a time
+    writeCache = 0;             // default is no write cache
+    statsFile = NULL;           // default is not to print statistics
+    traceFile = NULL;           // default is not to trace the disk
+    hotBlocks = 0;              // default is to interpret user code
+    runBlocks = TRUE;           // ... a basic block at a time
 								
 	// MP4 mod tag
 	execfileNum = 0; // dummy operation to keep valgrind happy
+	numPrograms = numWaiting = 0;
 								
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "-rs") == 0) {
@@ -72,6 +85,49 @@ Kernel::Kernel(int argc, char **argv)
             ASSERT(i + 1 < argc);   // next argument is int
             hostName = atoi(argv[i + 1]);
             i++;
+        } else if (strcmp(argv[i], "-ov") == 0) {
+            ASSERT(i + 1 < argc);   // next argument is the base image
+            overlayBase = argv[i + 1];
+            i++;
+        } else if (strcmp(argv[i], "-stripe") == 0) {
+            ASSERT(i + 2 < argc);   // number of disks, stripe unit
+            numDisks = atoi(argv[i + 1]);
+            stripeUnit = atoi(argv[i + 2]);
+            ASSERT(numDisks > 0 && numDisks <= MaxDisks && stripeUnit > 0);
+            i += 2;
+        } else if (strcmp(argv[i], "-mirror") == 0) {
+            ASSERT(i + 1 < argc);   // number of disks
+            numDisks = atoi(argv[i + 1]);
+            ASSERT(numDisks > 0 && numDisks <= MaxDisks);
+            mirrored = TRUE;
+            i++;
+        } else if (strcmp(argv[i], "-ssd") == 0) {
+            flash = TRUE;
+        } else if (strcmp(argv[i], "-ncq") == 0) {
+            ASSERT(i + 1 < argc);   // queue depth
+            queueDepth = atoi(argv[i + 1]);
+            ASSERT(queueDepth > 0 && queueDepth <= MaxQueueDepth);
+            i++;
+        } else if (strcmp(argv[i], "-wcache") == 0) {
+            ASSERT(i + 1 < argc);   // sectors of write cache
+            writeCache = atoi(argv[i + 1]);
+            ASSERT(writeCache > 0 && writeCache <= NumSectors);
+            i++;
+        } else if (strcmp(argv[i], "-stats") == 0) {
+            ASSERT(i + 1 < argc);   // file to export statistics to
+            statsFile = argv[i + 1];
+            i++;
+        } else if (strcmp(argv[i], "-trace") == 0) {
+            ASSERT(i + 1 < argc);   // file to record disk requests in
+            traceFile = argv[i + 1];
+            i++;
+        } else if (strcmp(argv[i], "-hot") == 0) {
+            ASSERT(i + 1 < argc);   // runs before a block is compiled
+            hotBlocks = atoi(argv[i + 1]);
+            ASSERT(hotBlocks >= 0);
+            i++;
+        } else if (strcmp(argv[i], "-noblocks") == 0) {
+            runBlocks = FALSE;
         } else if (strcmp(argv[i], "-u") == 0) {
             cout << "Partial usage: nachos [-rs randomSeed]\n";
 	   		cout << "Partial usage: nachos [-s]\n";
@@ -80,6 +136,14 @@ Kernel::Kernel(int argc, char **argv)
 	    	cout << "Partial usage: nachos [-nf]\n";
 #endif
             cout << "Partial usage: nachos [-n #] [-m #]\n";
+            cout << "Partial usage: nachos [-ov baseImage]\n";
+            cout << "Partial usage: nachos [-stripe #disks #sectors]\n";
+            cout << "Partial usage: nachos [-mirror #disks] [-ssd]\n";
+            cout << "Partial usage: nachos [-ncq depth]\n";
+            cout << "Partial usage: nachos [-wcache #sectors]\n";
+            cout << "Partial usage: nachos [-stats statsFile]\n";
+            cout << "Partial usage: nachos [-trace traceFile]\n";
+            cout << "Partial usage: nachos [-hot #runs] [-noblocks]\n";
 		}
     }
 }
@@ -110,6 +174,7 @@ Kernel::Initialize()
     synchConsoleIn = new SynchConsoleInput(consoleIn); // input from stdin
     synchConsoleOut = new SynchConsoleOutput(consoleOut); // output to stdout
     synchDisk = new SynchDisk();    //
+    programsDone = new Semaphore("programs done", 0);
 #ifdef FILESYS_STUB
     fileSystem = new FileSystem();
 #else
@@ -141,11 +206,21 @@ Kernel::PrepareToEnd()
 
 //----------------------------------------------------------------------
 // Kernel::~Kernel
-// 	Nachos is halting.  De-allocate global data structures.
+// 	Nachos is halting.  De-allocate global data structures.  If
+//	asked to, print the statistics and export them first.
 //----------------------------------------------------------------------
 
 Kernel::~Kernel()
 {
+    if (statsFile != NULL) {
+        stats->Print();
+        stats->Export(statsFile);
+    }
+    synchDisk->Print();
+    // the file system and disk first: closing their files takes locks,
+    // which need the interrupt and the scheduler
+    delete fileSystem;
+    delete synchDisk;
     delete stats;
     delete interrupt;
     delete scheduler;
@@ -153,8 +228,7 @@ Kernel::~Kernel()
     delete machine;
     delete synchConsoleIn;
     delete synchConsoleOut;
-    delete synchDisk;
-    delete fileSystem;
+    delete programsDone;
 	
 	// Mp4 mod tag
 	/*
@@ -296,10 +370,13 @@ void Kernel::ExecAll()
 
 int Kernel::Exec(char* name)
 {
-	t[threadNum] = new Thread(name, threadNum);
-	t[threadNum]->space = new AddrSpace();
-	t[threadNum]->Fork((VoidFunctionPtr) &ForkExecute, (void *)t[threadNum]);
+	Thread *thread = new Thread(name, threadNum);
+	thread->space = new AddrSpace();
+	if (threadNum < (int)(sizeof(t) / sizeof(t[0])))
+		t[threadNum] = thread;	// (a batch may start any number)
+	thread->Fork((VoidFunctionPtr) &ForkExecute, (void *)thread);
 	threadNum++;
+	numPrograms++;
 
 	return threadNum-1;
 /*
@@ -329,6 +406,43 @@ int Kernel::Exec(char* name)
 //  cout << "after ThreadedKernel:Run();" << endl;  // unreachable
 }
 
+//----------------------------------------------------------------------
+// Kernel::ProgramDone
+// 	Called by Thread::Finish for a thread started by Exec.  When it
+//	is the last one, wake up whoever is in WaitForPrograms.
+//----------------------------------------------------------------------
+
+void
+Kernel::ProgramDone()
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+
+    ASSERT(numPrograms > 0);
+    if (--numPrograms == 0)
+	for (; numWaiting > 0; numWaiting--)
+	    programsDone->V();
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// Kernel::WaitForPrograms
+// 	Wait until every thread started by Exec has finished, eg. so that
+//	the next program of a batch doesn't share the memory with one
+//	still running.
+//----------------------------------------------------------------------
+
+void
+Kernel::WaitForPrograms()
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+
+    while (numPrograms > 0) {
+	numWaiting++;
+	programsDone->P();
+    }
+    (void) interrupt->SetLevel(oldLevel);
+}
+
 #ifdef FILESYS_STUB
 int Kernel::CreateFile(char *filename)
 {
@@ -336,7 +450,7 @@ int Kernel::CreateFile(char *filename)
 }
 #else
 int Kernel::CreateFile(char *filename, int initialSize) {
-    return fileSystem->Create(filename, initialSize, FALSE);
+    return fileSystem->Create(filename, initialSize, FALSE, 0);
 }
 #endif
 
@@ -347,27 +461,213 @@ OpenFileId Kernel::Open(char *filename) {
 }
 
 int Kernel::Write(char *buffer, int size, OpenFileId id) {
-    if((id >=1 && id <= MAXFILENUM) == FALSE) return -1;
-    OpenFile* openfile = fileSystem->fileDescriptorTable[id];
+    OpenFile* openfile = currentThread->files->Get(id);
     if(openfile == NULL) return -1; 
     return openfile->Write(buffer, size);
 }
 
 int Kernel::Read(char *buffer, int size, int id) {
-    if((id >=1 && id <= MAXFILENUM) == FALSE) return -1;
-    OpenFile* openfile = fileSystem->fileDescriptorTable[id];
+    OpenFile* openfile = currentThread->files->Get(id);
     if(openfile == NULL) return -1; 
     return openfile->Read(buffer, size);
 }
 
 int Kernel::Close(OpenFileId id) { 
-    if((id >=1 && id <= MAXFILENUM) == FALSE) return -1;  
-    OpenFile* openfile = fileSystem->fileDescriptorTable[id];
-    if(openfile == NULL) return -1; 
-    fileSystem->fileDescriptorTable[id] = NULL;
-    fileSystem->num_openfile--;
-    delete openfile;
+    return fileSystem->Close(id);
+}
+
+OpenFileId Kernel::Dup(OpenFileId id) {
+    return currentThread->files->Dup(id);
+}
+
+int Kernel::Seek(int position, OpenFileId id) {
+    OpenFile* openfile = currentThread->files->Get(id);
+    if(openfile == NULL || position < 0) return -1;
+    openfile->Seek(position);
     return 1;
 }
 
+int Kernel::PRead(char *buffer, int size, int position, OpenFileId id) {
+    OpenFile* openfile = currentThread->files->Get(id);
+    if(openfile == NULL || position < 0) return -1;
+    return openfile->ReadAt(buffer, size, position);
+}
+
+int Kernel::PWrite(char *buffer, int size, int position, OpenFileId id) {
+    OpenFile* openfile = currentThread->files->Get(id);
+    if(openfile == NULL || position < 0) return -1;
+    return openfile->WriteAt(buffer, size, position);
+}
+
+// Total size of the buffers of a vectored read or write, or -1
+static int VectorSize(int *sizes, int count) {
+    int total = 0;
+    if(count < 0) return -1;
+    for (int i = 0; i < count; i++) {
+        if(sizes[i] < 0) return -1;
+        total += sizes[i];
+    }
+    return total;
+}
+
+// The buffers are gathered into (or scattered from) one kernel buffer,
+// so the file sees a single large request rather than one per buffer.
+int Kernel::ReadV(char **buffers, int *sizes, int count, OpenFileId id) {
+    OpenFile* openfile = currentThread->files->Get(id);
+    int total = VectorSize(sizes, count);
+    int done, copied = 0;
+    if(openfile == NULL || total < 0) return -1;
+    char *buffer = new char[total + 1];
+    done = openfile->Read(buffer, total);
+    for (int i = 0; i < count && copied < done; i++) {
+        int n = min(sizes[i], done - copied);
+        bcopy(buffer + copied, buffers[i], n);
+        copied += n;
+    }
+    delete [] buffer;
+    return done;
+}
+
+int Kernel::WriteV(char **buffers, int *sizes, int count, OpenFileId id) {
+    OpenFile* openfile = currentThread->files->Get(id);
+    int total = VectorSize(sizes, count);
+    int done, copied = 0;
+    if(openfile == NULL || total < 0) return -1;
+    char *buffer = new char[total + 1];
+    for (int i = 0; i < count; i++) {
+        bcopy(buffers[i], buffer + copied, sizes[i]);
+        copied += sizes[i];
+    }
+    done = openfile->Write(buffer, total);
+    delete [] buffer;
+    return done;
+}
+
+// The data is moved in pieces of many sectors, each a single ReadAt and
+// WriteAt, so that it reaches the disk as long multi-sector transfers.
+static const int CopyTransferSize = 32 * 1024;
+
+int Kernel::CopyFile(OpenFileId src, OpenFileId dst, int offset, int len) {
+    OpenFile* from = currentThread->files->Get(src);
+    OpenFile* to = currentThread->files->Get(dst);
+    int copied = 0, amountRead, amountWritten;
+    if(from == NULL || to == NULL || offset < 0 || len < 0) return -1;
+    char *buffer = new char[CopyTransferSize];
+    while (copied < len) {
+        amountRead = from->ReadAt(buffer, min(len - copied, CopyTransferSize),
+				offset + copied);
+        if(amountRead <= 0) break;
+        amountWritten = to->WriteAt(buffer, amountRead, offset + copied);
+        copied += amountWritten;
+        if(amountWritten < amountRead) break;	// "dst" is full
+    }
+    delete [] buffer;
+    return copied;
+}
+
+int Kernel::Mmap(OpenFileId id, int length) {
+    return currentThread->space->Mmap(id, length);
+}
+
+int Kernel::Munmap(int addr) {
+    return currentThread->space->Munmap(addr);
+}
+
+#ifndef FILESYS_STUB
+int Kernel::CloneFile(char *from, char *to) {
+    return fileSystem->Clone(from, to);
+}
+
+void DefragmentThread(void *arg)
+{
+    kernel->fileSystem->Defragment();
+}
+
+//----------------------------------------------------------------------
+// Kernel::Defragment
+// 	Start a kernel thread that defragments the disk.  It yields after
+//	each file, so it mostly uses the disk while user programs are
+//	computing, rather than holding them up.
+//----------------------------------------------------------------------
+
+void Kernel::Defragment()
+{
+	Thread *thread = new Thread("defrag", threadNum);
+	if (threadNum < (int)(sizeof(t) / sizeof(t[0])))
+		t[threadNum] = thread;
+	thread->Fork((VoidFunctionPtr) &DefragmentThread, NULL);
+	threadNum++;
+}
+
+// One reader of Kernel::ReadTest: the file it reads, and what it
+// should find there.
+
+class TestReader {
+  public:
+    char *name;
+    char *expected;
+    int length;
+};
+
+static int readersLeft, testReads, testWrong;
+
+void ReadTestThread(void *arg)
+{
+    TestReader *reader = (TestReader *) arg;
+    pair<OpenFile*,OpenFileId> info = kernel->fileSystem->Open(reader->name);
+    char buffer[SectorSize];
+    int n;
+
+    ASSERT(info.first != NULL);
+    for (int pass = 0; pass < 3; pass++)
+	for (int pos = 0; pos < reader->length; pos += SectorSize) {
+	    n = info.first->ReadAt(buffer, SectorSize, pos);
+	    testReads++;
+	    if (n != min(SectorSize, reader->length - pos)
+			|| memcmp(buffer, reader->expected + pos, n) != 0)
+		testWrong++;
+	}
+    kernel->fileSystem->Close(info.second);
+    if (--readersLeft == 0)
+	printf("Read test: %d reads, %d wrong\n", testReads, testWrong);
+}
+
+//----------------------------------------------------------------------
+// Kernel::ReadTest
+// 	Start four kernel threads that read files a sector at a time, at
+//	the same time: three read "near", one "far".  Each disk then
+//	holds several requests to choose among (see -ncq), and a request
+//	for "far" (placed well away from "near") can be passed over.
+//	Each file is read once beforehand, and every read is checked
+//	against it; the last reader to finish reports the count.
+//----------------------------------------------------------------------
+
+void Kernel::ReadTest(char *near, char *far)
+{
+	int which[] = { 0, 0, 1, 0 };	// near, near, far, near
+	TestReader *files[2];
+
+	for (int f = 0; f < 2; f++) {
+		pair<OpenFile*,OpenFileId> info = fileSystem->Open(f == 0 ? near : far);
+		ASSERT(info.first != NULL);
+		files[f] = new TestReader;
+		files[f]->name = f == 0 ? near : far;
+		files[f]->length = info.first->Length();
+		files[f]->expected = new char[files[f]->length];
+		info.first->ReadAt(files[f]->expected, files[f]->length, 0);
+		fileSystem->Close(info.second);
+	}
+	readersLeft = 4;
+	testReads = testWrong = 0;
+	for (int i = 0; i < 4; i++) {
+		Thread *thread = new Thread(files[which[i]]->name, threadNum);
+		if (threadNum < (int)(sizeof(t) / sizeof(t[0])))
+			t[threadNum] = thread;
+		thread->Fork((VoidFunctionPtr) &ReadTestThread,
+			     (void *) files[which[i]]);
+		threadNum++;
+	}
+}
+#endif
+
 
@@ -24,6 +24,7 @@ class PostOfficeOutput;
 class SynchConsoleInput;
 class SynchConsoleOutput;
 class SynchDisk;
+class Semaphore;
 
 
 
@@ -42,6 +43,9 @@ class Kernel {
 	
 	void ExecAll();
 	int Exec(char* name);
+	void ProgramDone();	// a thread started by Exec is finishing
+	void WaitForPrograms();	// return once every one has finished
+	int NumPrograms() { return numPrograms; }
     void ThreadSelfTest();	// self test of threads and synchronization
 	
     void ConsoleTest();         // interactive console self test
@@ -57,6 +61,21 @@ class Kernel {
   int Write(char *buffer, int size, OpenFileId id);
   int Read(char *buffer, int size, OpenFileId id);
   int Close(OpenFileId id);
+  OpenFileId Dup(OpenFileId id);
+  int Seek(int position, OpenFileId id);
+  int PRead(char *buffer, int size, int position, OpenFileId id);
+  int PWrite(char *buffer, int size, int position, OpenFileId id);
+  int ReadV(char **buffers, int *sizes, int count, OpenFileId id);
+  int WriteV(char **buffers, int *sizes, int count, OpenFileId id);
+  int CopyFile(OpenFileId src, OpenFileId dst, int offset, int len);
+  int Mmap(OpenFileId id, int length);
+  int Munmap(int addr);
+	#ifndef FILESYS_STUB
+	int CloneFile(char *from, char *to); // fileSystem call
+	void Defragment();	// defragment the disk in a thread of its own
+	void ReadTest(char *near, char *far);	// read files from several
+				// threads at once (see -readtest)
+	#endif
 
 // These are public for notational convenience; really, 
 // they're global variables used everywhere.
@@ -75,6 +94,23 @@ class Kernel {
     PostOfficeOutput *postOfficeOut;
 
     int hostName;               // machine identifier
+    char *overlayBase;          // base image of a new overlay disk
+                                // (see disk.h), or NULL
+    int numDisks;               // disks the sectors are striped over
+    int stripeUnit;             // sectors per stripe (see synchdisk.h)
+    bool mirrored;              // mirror the disks instead of striping
+    bool flash;                 // simulate flash disks (see ssd.h)
+    int queueDepth;             // requests each disk can hold (see disk.h)
+    int writeCache;             // sectors of write cache in each disk,
+                                // or 0 for none (see disk.h)
+    char *statsFile;            // where to export the statistics at
+                                // halt (see stats.h), or NULL
+    char *traceFile;            // where to record disk requests
+                                // (see disktrace.h), or NULL
+    int hotBlocks;              // runs after which a block of user code
+                                // is compiled (see mipssim.cc), or 0
+    bool runBlocks;             // run user code a block at a time, not
+                                // an instruction (see mipssim.cc)
 
   private:
 
@@ -82,6 +118,9 @@ class Kernel {
 	char*   execfile[10];
 	int execfileNum;
 	int threadNum;
+	int numPrograms;	// threads started by Exec, not yet finished
+	int numWaiting;		// threads in WaitForPrograms
+	Semaphore *programsDone;	// they wait here
     bool randomSlice;		// enable pseudo-random time slicing
     bool debugUserProg;         // single step user program
     double reliability;         // likelihood messages are dropped
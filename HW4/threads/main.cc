@@ -4,9 +4,17 @@
 //
 // Usage: nachos -d <debugflags> -rs <random seed #>
 //              -s -x <nachos file> -ci <consoleIn> -co <consoleOut>
-//              -f -cp <unix file> <nachos file>
-//              -p <nachos file> -r <nachos file> -l -D
+//              -f -cp <unix file> <nachos file> -cpz <unix file> <nachos file>
+//              -cpr <unix directory> <nachos directory>
+//              -clone <nachos file> <nachos file>
+//              -p <nachos file> -r <nachos file> -l -D -defrag
+//              -batch <command file>
 //              -n <network reliability> -m <machine id>
+//              -ov <base disk image> -stripe <disks> <stripe unit>
+//              -mirror <disks> -ssd -ncq <depth> -wcache <sectors>
+//              -stats <statistics file> -trace <trace file> -hot <runs>
+//              -noblocks -replay <trace file>
+//              -readtest <nachos file> <nachos file>
 //              -z -K -C -N
 //
 //    -d causes certain debugging messages to be printed (see debug.h)
@@ -18,6 +26,23 @@
 //    -co specify file for console output (stdout is the default)
 //    -n sets the network reliability
 //    -m sets this machine's host id (needed for the network)
+//    -ov starts a new overlay disk on top of a read-only base image
+//       (see disk.h); later runs without -ov keep using the overlay
+//    -stripe stripes the disk sectors over several disks, a given
+//       number of sectors at a time (see synchdisk.h)
+//    -mirror keeps a copy of every sector on each of several disks
+//    -ssd simulates flash disks instead of rotating ones (see ssd.h)
+//    -ncq lets each disk hold several requests, and serve the one
+//       it can reach soonest first (see disk.h)
+//    -wcache gives each disk a write cache of a given number of
+//       sectors (see disk.h)
+//    -stats prints the statistics at halt, including where the time of
+//       disk requests went, and writes them to a file (see stats.cc)
+//    -trace records every disk request in a file (see disktrace.h)
+//    -hot compiles each block of user code that has run a given number
+//       of times into i386 code (see Machine::Compile)
+//    -noblocks runs user code an instruction at a time, as before
+//       Machine::RunBlocks; the output, ticks included, is the same
 //    -K run a simple self test of kernel threads and synchronization
 //    -C run an interactive console test
 //    -N run a two-machine network test (see Kernel::NetworkTest)
@@ -25,10 +50,20 @@
 //    Filesystem-related flags:
 //    -f forces the Nachos disk to be formatted
 //    -cp copies a file from UNIX to Nachos
+//    -cpz copies a file from UNIX to Nachos, storing it compressed
+//    -cpr copies a UNIX directory tree into Nachos
+//    -clone makes a copy-on-write copy of a Nachos file
 //    -p prints a Nachos file to stdout
 //    -r removes a Nachos file from the file system
 //    -l lists the contents of the Nachos directory
 //    -D prints the contents of the entire file system 
+//    -defrag moves scattered files into consecutive sectors
+//    -batch runs the commands in a file ("-" for stdin), one per line,
+//       in this one Nachos instance (see Batch below)
+//    -replay times the requests of a trace on a scratch disk, chosen
+//       by -ncq, -wcache and -ssd (see disktrace.h)
+//    -readtest reads two files from several kernel threads at once,
+//       checking what they read (see Kernel::ReadTest)
 //
 //  Note: the file system flags are not used if the stub filesystem
 //        is being used
@@ -43,7 +78,10 @@
 
 #include "main.h"
 #include "filesys.h"
+#include "directory.h"
 #include "openfile.h"
+#include "disktrace.h"
+#include "synchconsole.h"
 #include "sysdep.h"
 
 // global variables
@@ -70,25 +108,36 @@ Cleanup(int x)
 //-------------------------------------------------------------------
 static const int TransferSize = 128;
 
+// Copy moves data in much bigger pieces, so that each write reaches
+// the disk as a few long runs of consecutive sectors.
+static const int BulkTransferSize = 64 * 1024;
+
 
 #ifndef FILESYS_STUB
 //----------------------------------------------------------------------
 // Copy
 //      Copy the contents of the UNIX file "from" to the Nachos file "to"
+//	If "compressed", the Nachos file stores its data compressed.
+//	Return the number of bytes copied, or -1 on failure.
+//
+//	Every sector of the new file is about to be overwritten, so it
+//	is created without first being filled with zeroes.
 //----------------------------------------------------------------------
 
-static void
-Copy(char *from, char *to)
+static int
+Copy(char *from, char *to, bool compressed)
 {
     int fd;
     OpenFile* openFile;
     int amountRead, fileLength;
     char *buffer;
+    int flags = CreateUncleared | (compressed ? CreateCompressed : 0);
+    int startTicks = kernel->stats->totalTicks;
 
 // Open UNIX file
     if ((fd = OpenForReadWrite(from,FALSE)) < 0) {       
         printf("Copy: couldn't open input file %s\n", from);
-        return;
+        return -1;
     }
 
 // Figure out length of UNIX file
@@ -98,26 +147,96 @@ Copy(char *from, char *to)
 
 // Create a Nachos file of the same length
     DEBUG('f', "Copying file " << from << " of size " << fileLength <<  " to file " << to);
-    if (!kernel->fileSystem->Create(to, fileLength, FALSE)) {   // Create Nachos file
+    if (!kernel->fileSystem->Create(to, fileLength, FALSE, flags)) {   // Create Nachos file
         printf("Copy: couldn't create output file %s\n", to);
         Close(fd);
-        return;
+        return -1;
     }
     pair<OpenFile*,OpenFileId> openFileInfo = kernel->fileSystem->Open(to);/////////////////////////////////////////////
     openFile = openFileInfo.first;///////////////////////////////////////////////////////////////////
     ASSERT(openFile != NULL);
     
-// Copy the data in TransferSize chunks
-    buffer = new char[TransferSize];
-    while ((amountRead=ReadPartial(fd, buffer, sizeof(char)*TransferSize)) > 0)
+// Copy the data in BulkTransferSize chunks
+    buffer = new char[BulkTransferSize];
+    while ((amountRead=ReadPartial(fd, buffer, sizeof(char)*BulkTransferSize)) > 0)
         openFile->Write(buffer, amountRead);    
     delete [] buffer;
 
 // Close the UNIX and the Nachos files
-    delete openFile;
-    kernel->fileSystem->fileDescriptorTable[openFileInfo.second] = NULL;///////////////////////////
-	kernel->fileSystem->num_openfile--;///////////////////////////////////////////////
+    kernel->fileSystem->Close(openFileInfo.second);
     Close(fd);
+
+    DEBUG('f', "Copied " << fileLength << " bytes in "
+		<< kernel->stats->totalTicks - startTicks << " ticks");
+    return fileLength;
+}
+
+//----------------------------------------------------------------------
+// CopyTree
+//      Copy the UNIX directory "from", and everything below it, to the
+//	Nachos directory "to", which is created if need be.  Entries
+//	whose names are too long for a Nachos directory are skipped.
+//	Add what was copied to "numFiles" and "numBytes".
+//----------------------------------------------------------------------
+
+static void
+CopyTree(char *from, char *to, int *numFiles, int *numBytes)
+{
+    void *dir;
+    char *name;
+    char *fromPath, *toPath;
+    int copied;
+
+    if ((dir = OpenDirectory(from)) == NULL) {
+	printf("Copy: couldn't open input directory %s\n", from);
+	return;
+    }
+    if (strcmp(to, "/") != 0)
+	kernel->fileSystem->Create(to, 0, TRUE, 0);	// fails if it exists
+
+    while ((name = ReadDirectory(dir)) != NULL) {
+	if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0)
+	    continue;
+	if (strlen(name) > FileNameMaxLen) {
+	    printf("Copy: skipping %s/%s, name is too long\n", from, name);
+	    continue;
+	}
+	fromPath = new char[strlen(from) + strlen(name) + 2];
+	sprintf(fromPath, "%s/%s", from, name);
+	toPath = new char[strlen(to) + strlen(name) + 2];
+	sprintf(toPath, "%s/%s", (strcmp(to, "/") == 0) ? "" : to, name);
+
+	if (IsDirectory(fromPath))
+	    CopyTree(fromPath, toPath, numFiles, numBytes);
+	else if ((copied = Copy(fromPath, toPath, FALSE)) >= 0) {
+	    (*numFiles)++;
+	    *numBytes += copied;
+	}
+	delete [] fromPath;
+	delete [] toPath;
+    }
+    CloseDirectory(dir);
+}
+
+//----------------------------------------------------------------------
+// Import
+//      Copy a whole UNIX directory tree into Nachos, and report how
+//	fast it went, in simulated time.
+//----------------------------------------------------------------------
+
+static void
+Import(char *from, char *to)
+{
+    int numFiles = 0, numBytes = 0;
+    int startTicks = kernel->stats->totalTicks;
+    int ticks;
+
+    CopyTree(from, to, &numFiles, &numBytes);
+    ticks = kernel->stats->totalTicks - startTicks;
+    printf("Imported %d files, %d bytes, in %d ticks", numFiles, numBytes, ticks);
+    if (ticks > 0)
+	printf(" (%d bytes per 1000 ticks)", (int) ((double) numBytes * 1000 / ticks));
+    printf("\n");
 }
 
 #endif // FILESYS_STUB
@@ -146,9 +265,7 @@ Print(char *name)
             printf("%c", buffer[i]);
     delete [] buffer;
 
-    delete openFile;            // close the Nachos file
-    kernel->fileSystem->fileDescriptorTable[openFileInfo.second] = NULL;       ////////////
-	kernel->fileSystem->num_openfile--;                                     //////////////
+    kernel->fileSystem->Close(openFileInfo.second);	// close the Nachos file
     return;
 }
 
@@ -160,10 +277,129 @@ Print(char *name)
 static void
 CreateDirectory(char *name)
 {
-	if(kernel->fileSystem->Create(name, 0, TRUE) == FALSE)////////////////////////////
+	if(kernel->fileSystem->Create(name, 0, TRUE, 0) == FALSE)////////////////////////////
         printf ( "Unable to create directory %s\n", name);    ///////////////
 }
 
+#ifndef FILESYS_STUB
+//----------------------------------------------------------------------
+// RunCommand
+//      Run one file system or exec command of a batch, given as its
+//	words, eg. {"-cp", "num_100.txt", "/t0/f1"}.  The commands and
+//	their arguments are the same as the command line flags:
+//	  -f -cp -cpz -cpr -clone -p -r -rr -l -lr -mkdir -D -defrag -e
+//	Return FALSE if the command is not one of these.
+//
+//	A program started with -e is run to the end before the next
+//	command: programs are loaded at the same place in memory, so two
+//	can't run at once.
+//----------------------------------------------------------------------
+
+static bool
+RunCommand(int argc, char **argv)
+{
+    char *cmd = argv[0];
+
+    if (argc == 1 && strcmp(cmd, "-f") == 0) {
+	if (kernel->NumPrograms() > 0) {	// they have files open
+	    printf("Batch: can't format while user programs are running\n");
+	    return TRUE;
+	}
+	delete kernel->fileSystem;
+	kernel->fileSystem = new FileSystem(TRUE);
+    } else if (argc == 3 && strcmp(cmd, "-cp") == 0) {
+	Copy(argv[1], argv[2], FALSE);
+    } else if (argc == 3 && strcmp(cmd, "-cpz") == 0) {
+	Copy(argv[1], argv[2], TRUE);
+    } else if (argc == 3 && strcmp(cmd, "-cpr") == 0) {
+	Import(argv[1], argv[2]);
+    } else if (argc == 3 && strcmp(cmd, "-clone") == 0) {
+	if (!kernel->fileSystem->Clone(argv[1], argv[2]))
+	    printf("Unable to clone %s to %s\n", argv[1], argv[2]);
+    } else if (argc == 2 && strcmp(cmd, "-p") == 0) {
+	Print(argv[1]);
+    } else if (argc == 2 && strcmp(cmd, "-r") == 0) {
+	kernel->fileSystem->Remove(FALSE, argv[1]);
+    } else if (argc == 2 && strcmp(cmd, "-rr") == 0) {
+	kernel->fileSystem->Remove(TRUE, argv[1]);
+    } else if (argc == 2 && strcmp(cmd, "-l") == 0) {
+	kernel->fileSystem->List(FALSE, argv[1]);
+    } else if (argc == 2 && strcmp(cmd, "-lr") == 0) {
+	kernel->fileSystem->List(TRUE, argv[1]);
+    } else if (argc == 2 && strcmp(cmd, "-mkdir") == 0) {
+	CreateDirectory(argv[1]);
+    } else if (argc == 1 && strcmp(cmd, "-D") == 0) {
+	kernel->fileSystem->Print();
+    } else if (argc == 1 && strcmp(cmd, "-defrag") == 0) {
+	kernel->fileSystem->Defragment();
+    } else if (argc == 2 && strcmp(cmd, "-e") == 0) {
+	char *name = new char[strlen(argv[1]) + 1];   // the thread keeps it
+	strcpy(name, argv[1]);
+	kernel->Exec(name);
+	kernel->WaitForPrograms();
+    } else {
+	return FALSE;
+    }
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Batch
+//      Run the commands in the UNIX file "name" (or standard input, if
+//	"name" is "-"), one per line, in order.  Blank lines, and lines
+//	starting with '#', are skipped.
+//
+//	Everything runs in this one kernel, so the disk is opened and
+//	the file system metadata read only once, and in-memory caches
+//	stay warm from one command to the next.
+//
+//	When the commands come from standard input, console input is
+//	turned off, so that its polling doesn't take them from us.
+//----------------------------------------------------------------------
+
+static const int MaxBatchLine = 1024;
+static const int MaxBatchWords = 8;
+
+static void
+Batch(char *name)
+{
+    FILE *input;
+    char line[MaxBatchLine];
+    char *words[MaxBatchWords];
+    int numWords, lineNum = 0, numRun = 0;
+
+    if (strcmp(name, "-") == 0) {
+	input = stdin;
+	kernel->synchConsoleIn->Disable();
+    } else if ((input = fopen(name, "r")) == NULL) {
+	printf("Batch: couldn't open command file %s\n", name);
+	return;
+    }
+
+    while (fgets(line, MaxBatchLine, input) != NULL) {
+	lineNum++;
+	numWords = 0;
+	for (char *word = strtok(line, " \t\r\n"); word != NULL;
+			word = strtok(NULL, " \t\r\n"))
+	    if (numWords++ < MaxBatchWords)
+		words[numWords - 1] = word;
+	if (numWords == 0 || words[0][0] == '#')
+	    continue;
+	if (numWords > MaxBatchWords)
+	    printf("Batch: line %d: more than %d words\n", lineNum, MaxBatchWords);
+	else if (RunCommand(numWords, words))
+	    numRun++;
+	else
+	    printf("Batch: line %d: unknown command %s\n", lineNum, words[0]);
+	fflush(stdout);
+    }
+
+    if (input != stdin)
+	fclose(input);
+    DEBUG(dbgFile, "Batch ran " << numRun << " commands");
+}
+#endif // FILESYS_STUB
+
 //----------------------------------------------------------------------
 // main
 // 	Bootstrap the operating system kernel.  
@@ -190,6 +426,11 @@ main(int argc, char **argv)
 #ifndef FILESYS_STUB
     char *copyUnixFileName = NULL;    // UNIX file to be copied into Nachos
     char *copyNachosFileName = NULL;  // name of copied file in Nachos
+    bool copyCompressedFlag = false;  // store the copy compressed
+    char *importUnixDirName = NULL;   // UNIX directory tree to be copied
+    char *importNachosDirName = NULL; // where it goes in Nachos
+    char *cloneFromName = NULL;       // Nachos file to be cloned
+    char *cloneToName = NULL;         // name of the clone
     char *printFileName = NULL; 
     char *removeFileName = NULL;
     bool dirListFlag = false;
@@ -200,6 +441,11 @@ main(int argc, char **argv)
 	bool mkdirFlag = false;
 	bool recursiveListFlag = false;
 	bool recursiveRemoveFlag = false;
+	bool defragFlag = false;
+	char *batchFileName = NULL;
+	char *replayFileName = NULL;
+	char *readTestNear = NULL;	// files for the read test
+	char *readTestFar = NULL;
 #endif //FILESYS_STUB
 
     // some command line arguments are handled here.
@@ -235,6 +481,25 @@ main(int argc, char **argv)
 	    copyNachosFileName = argv[i + 2];
 	    i += 2;
 	}
+	else if (strcmp(argv[i], "-cpz") == 0) {
+	    ASSERT(i + 2 < argc);
+	    copyUnixFileName = argv[i + 1];
+	    copyNachosFileName = argv[i + 2];
+	    copyCompressedFlag = true;
+	    i += 2;
+	}
+	else if (strcmp(argv[i], "-cpr") == 0) {
+	    ASSERT(i + 2 < argc);
+	    importUnixDirName = argv[i + 1];
+	    importNachosDirName = argv[i + 2];
+	    i += 2;
+	}
+	else if (strcmp(argv[i], "-clone") == 0) {
+	    ASSERT(i + 2 < argc);
+	    cloneFromName = argv[i + 1];
+	    cloneToName = argv[i + 2];
+	    i += 2;
+	}
 	else if (strcmp(argv[i], "-p") == 0) {
 	    ASSERT(i + 1 < argc);
 	    printFileName = argv[i + 1];
@@ -278,6 +543,25 @@ main(int argc, char **argv)
 	else if (strcmp(argv[i], "-D") == 0) {
 	    dumpFlag = true;
 	}
+	else if (strcmp(argv[i], "-defrag") == 0) {
+	    defragFlag = true;
+	}
+	else if (strcmp(argv[i], "-batch") == 0) {
+	    ASSERT(i + 1 < argc);
+	    batchFileName = argv[i + 1];
+	    i++;
+	}
+	else if (strcmp(argv[i], "-readtest") == 0) {
+	    ASSERT(i + 2 < argc);
+	    readTestNear = argv[i + 1];
+	    readTestFar = argv[i + 2];
+	    i += 2;
+	}
+	else if (strcmp(argv[i], "-replay") == 0) {
+	    ASSERT(i + 1 < argc);
+	    replayFileName = argv[i + 1];
+	    i++;
+	}
 #endif //FILESYS_STUB
 	else if (strcmp(argv[i], "-u") == 0) {
             cout << "Partial usage: nachos [-z -d debugFlags]\n";
@@ -285,8 +569,14 @@ main(int argc, char **argv)
 	    cout << "Partial usage: nachos [-K] [-C] [-N]\n";
 #ifndef FILESYS_STUB
             cout << "Partial usage: nachos [-cp UnixFile NachosFile]\n";
+            cout << "Partial usage: nachos [-cpz UnixFile NachosFile]\n";
+            cout << "Partial usage: nachos [-cpr UnixDirectory NachosDirectory]\n";
+            cout << "Partial usage: nachos [-clone NachosFile NachosFile]\n";
             cout << "Partial usage: nachos [-p fileName] [-r fileName]\n";
-            cout << "Partial usage: nachos [-l] [-D]\n";
+            cout << "Partial usage: nachos [-l] [-D] [-defrag]\n";
+            cout << "Partial usage: nachos [-batch commandFile]\n";
+            cout << "Partial usage: nachos [-replay traceFile]\n";
+            cout << "Partial usage: nachos [-readtest nearFile farFile]\n";
 #endif //FILESYS_STUB
 	}
 
@@ -318,7 +608,14 @@ main(int argc, char **argv)
 		kernel->fileSystem->Remove(recursiveRemoveFlag,removeFileName);// demo
     }
     if (copyUnixFileName != NULL && copyNachosFileName != NULL) {
-		Copy(copyUnixFileName,copyNachosFileName);
+		Copy(copyUnixFileName,copyNachosFileName,copyCompressedFlag);
+    }
+    if (importUnixDirName != NULL && importNachosDirName != NULL) {
+		Import(importUnixDirName, importNachosDirName);
+    }
+    if (cloneFromName != NULL && cloneToName != NULL) {
+		if (!kernel->fileSystem->Clone(cloneFromName, cloneToName))
+			printf("Unable to clone %s to %s\n", cloneFromName, cloneToName);
     }
     if (dumpFlag) {
 		kernel->fileSystem->Print();
@@ -333,6 +630,21 @@ main(int argc, char **argv)
     if (printFileName != NULL) {
       Print(printFileName);
     }
+    if (defragFlag) {
+		kernel->Defragment();	// runs alongside any user programs
+    }
+    if (batchFileName != NULL) {
+		Batch(batchFileName);
+    }
+    if (readTestNear != NULL) {
+		kernel->ReadTest(readTestNear, readTestFar);	// in threads
+    }
+    if (replayFileName != NULL) {
+		TraceReplay *replay = new TraceReplay(replayFileName);
+		replay->Run();
+		replay->Print();
+		delete replay;
+    }
 #endif // FILESYS_STUB
 
     // finally, run an initial user program if requested to do so
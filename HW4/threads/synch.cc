@@ -295,3 +295,94 @@ void Condition::Broadcast(Lock* conditionLock)
         Signal(conditionLock);
     }
 }
+
+//----------------------------------------------------------------------
+// RWLock::RWLock
+// 	Initialize a reader/writer lock.  Initially, no one holds it.
+//
+//	"debugName" is an arbitrary name, useful for debugging.
+//----------------------------------------------------------------------
+
+RWLock::RWLock(char* debugName)
+{
+    name = debugName;
+    lock = new Lock("rwlock");
+    readOk = new Condition("rwlock read");
+    writeOk = new Condition("rwlock write");
+    activeReaders = 0;
+    waitingWriters = 0;
+    writer = NULL;
+}
+
+//----------------------------------------------------------------------
+// RWLock::~RWLock
+// 	Deallocate a reader/writer lock.
+//----------------------------------------------------------------------
+
+RWLock::~RWLock()
+{
+    ASSERT(activeReaders == 0 && writer == NULL);
+    delete writeOk;
+    delete readOk;
+    delete lock;
+}
+
+//----------------------------------------------------------------------
+// RWLock::AcquireRead/ReleaseRead
+//	Share the lock with other readers.  A reader waits while a
+//	writer holds the lock, or while any writer is waiting for it.
+//	The last reader to leave lets a waiting writer in.
+//----------------------------------------------------------------------
+
+void RWLock::AcquireRead()
+{
+    lock->Acquire();
+    while (writer != NULL || waitingWriters > 0) {
+	readOk->Wait(lock);
+    }
+    activeReaders++;
+    lock->Release();
+}
+
+void RWLock::ReleaseRead()
+{
+    lock->Acquire();
+    ASSERT(activeReaders > 0);
+    activeReaders--;
+    if (activeReaders == 0) {
+	writeOk->Signal(lock);
+    }
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// RWLock::AcquireWrite/ReleaseWrite
+//	Hold the lock exclusively.  A writer waits until there are no
+//	active readers and no other writer.  On release, waiting writers
+//	are preferred; otherwise all waiting readers are let in together.
+//----------------------------------------------------------------------
+
+void RWLock::AcquireWrite()
+{
+    lock->Acquire();
+    waitingWriters++;
+    while (writer != NULL || activeReaders > 0) {
+	writeOk->Wait(lock);
+    }
+    waitingWriters--;
+    writer = kernel->currentThread;
+    lock->Release();
+}
+
+void RWLock::ReleaseWrite()
+{
+    lock->Acquire();
+    ASSERT(writer == kernel->currentThread);
+    writer = NULL;
+    if (waitingWriters > 0) {
+	writeOk->Signal(lock);
+    } else {
+	readOk->Broadcast(lock);
+    }
+    lock->Release();
+}
@@ -1,8 +1,9 @@
 // synch.h 
 //	Data structures for synchronizing threads.
 //
-//	Three kinds of synchronization are defined here: semaphores,
-//	locks, and condition variables.  The implementation for
+//	Four kinds of synchronization are defined here: semaphores,
+//	locks, condition variables, and reader/writer locks (which are
+//	built out of locks and condition variables).  The implementation for
 //	semaphores is given; for the latter two, only the procedure
 //	interface is given -- they are to be implemented as part of 
 //	the first assignment.
@@ -141,4 +142,33 @@ class Condition {
     char* name;
     List<Semaphore *> *waitQueue;	// list of waiting threads
 };
+
+// The following class defines a "reader/writer lock".  Any number of
+// readers may hold the lock at once, but a writer holds it exclusively.
+// Waiting writers are given preference over new readers, so that a
+// steady stream of readers cannot starve a writer.
+//
+// Built out of a Lock and two condition variables, so that it has the
+// same Mesa-style semantics as the rest of this file.
+
+class RWLock {
+  public:
+    RWLock(char* debugName);		// initialize lock to be FREE
+    ~RWLock();				// deallocate lock
+    char* getName() { return name; }	// debugging assist
+
+    void AcquireRead();			// wait until no writer is active
+    void ReleaseRead();			// or waiting, then share the lock
+    void AcquireWrite();		// wait until no one holds the lock,
+    void ReleaseWrite();		// then hold it exclusively
+
+  private:
+    char *name;				// debugging assist
+    Lock *lock;				// protects the counts below
+    Condition *readOk;			// signalled when readers may proceed
+    Condition *writeOk;			// signalled when a writer may proceed
+    int activeReaders;			// # of threads reading right now
+    int waitingWriters;			// # of threads waiting to write
+    Thread *writer;			// thread holding the lock to write
+};
 #endif // SYNCH_H
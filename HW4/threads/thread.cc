@@ -21,6 +21,7 @@
 #include "switch.h"
 #include "synch.h"
 #include "sysdep.h"
+#include "filetable.h"
 
 // this is put at the top of the execution stack, for detecting stack overflows
 const int STACK_FENCEPOST = 0xdedbeef;
@@ -46,6 +47,8 @@ Thread::Thread(char* threadName, int threadID)
 					// of machine registers
     }
     space = NULL;
+    files = new OpenFileTable(MAXFILENUM);
+    diskOrigin = -1;
 }
 
 //----------------------------------------------------------------------
@@ -66,6 +69,7 @@ Thread::~Thread()
     ASSERT(this != kernel->currentThread);
     if (stack != NULL)
 	DeallocBoundedArray((char *) stack, StackSize * sizeof(int));
+    delete files;
 }
 
 //----------------------------------------------------------------------
@@ -163,13 +167,19 @@ Thread::Begin ()
 //	to call the destructor, once it is running in the context of a different thread.
 //
 // 	NOTE: we disable interrupts, because Sleep() assumes interrupts
-//	are disabled.
+//	are disabled.  Mapped files are written back, and files left
+//	open are closed, first, since that may have to wait for a lock.
 //----------------------------------------------------------------------
 
 //
 void
 Thread::Finish ()
 {
+    if (space != NULL)
+	space->UnmapAll();
+    files->RemoveAll();
+    if (space != NULL)
+	kernel->ProgramDone();
     (void) kernel->interrupt->SetLevel(IntOff);		
     ASSERT(this == kernel->currentThread);
     
@@ -43,6 +43,8 @@
 #include "machine.h"
 #include "addrspace.h"
 
+class OpenFileTable;
+
 // CPU register state to be saved on context switch.  
 // The x86 needs to save only a few registers, 
 // SPARC and MIPS needs to save 10 registers, 
@@ -131,6 +133,11 @@ class Thread {
     void RestoreUserState();		// restore user-level register state
 
     AddrSpace *space;			// User code this thread is running.
+    OpenFileTable *files;		// Files this thread has open; all
+					// are closed when it finishes
+    int diskOrigin;			// Header sector of the file whose
+					// data the thread is reading or
+					// writing, or -1 (see disktrace.h)
 };
 
 // external function, dummy routine whose sole job is to call Thread::Print
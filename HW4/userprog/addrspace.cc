@@ -20,6 +20,7 @@
 #include "addrspace.h"
 #include "machine.h"
 #include "noff.h"
+#include "filetable.h"
 
 //----------------------------------------------------------------------
 // SwapHeader
@@ -76,6 +77,9 @@ AddrSpace::AddrSpace()
 	pageTable[i].dirty = FALSE;
 	pageTable[i].readOnly = FALSE;  
     }
+    for (int i = 0; i < MaxMappings; i++)
+	regions[i].id = -1;
+    numPages = mapLimit = 0;
     
     // zero out the entire address space
     bzero(kernel->machine->mainMemory, MemorySize);
@@ -135,6 +139,7 @@ AddrSpace::Load(char *fileName)
 #endif
     numPages = divRoundUp(size, PageSize);
     size = numPages * PageSize;
+    mapLimit = numPages;
 
     ASSERT(numPages <= NumPhysPages);		// check we're not trying
 						// to run anything too big --
@@ -170,7 +175,7 @@ AddrSpace::Load(char *fileName)
     }
 #endif
 
-    delete executable;			// close file
+    kernel->fileSystem->Close(openFileInfo.second);	// close file
     return TRUE;			// success
 }
 
@@ -252,13 +257,187 @@ void AddrSpace::SaveState()
 // 	On a context switch, restore the machine state so that
 //	this address space can run.
 //
-//      For now, tell the machine where to find the page table.
+//      For now, tell the machine where to find the page table, and
+//	to forget the translations it kept from the last one.
 //----------------------------------------------------------------------
 
 void AddrSpace::RestoreState() 
 {
     kernel->machine->pageTable = pageTable;
-    kernel->machine->pageTableSize = numPages;
+    kernel->machine->pageTableSize = mapLimit;
+    kernel->machine->FlushTranslations();
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::FindRegion
+// 	Return the mapped region holding virtual page "vpn", or NULL.
+//----------------------------------------------------------------------
+
+MappedRegion *
+AddrSpace::FindRegion(int vpn)
+{
+    for (int i = 0; i < MaxMappings; i++)
+	if (regions[i].id != -1 && vpn >= regions[i].firstPage
+			&& vpn < regions[i].firstPage + regions[i].numPages)
+	    return &regions[i];
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::FindFreePages
+// 	Find "count" consecutive pages, past the program and its stack,
+//	that no region is using.  Return the first, or -1 if there is
+//	no room.
+//----------------------------------------------------------------------
+
+int
+AddrSpace::FindFreePages(int count)
+{
+    int first = numPages;
+
+    for (int page = numPages; page < NumPhysPages; page++) {
+	if (FindRegion(page) != NULL)
+	    first = page + 1;
+	else if (page - first + 1 == count)
+	    return first;
+    }
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::Mmap
+// 	Map the first "length" bytes of an open file into this address
+//	space.  Nothing is read yet: the pages are marked invalid, and
+//	PageIn reads each one from the file when it is first touched.
+//	Return the virtual address of the region, or -1 on failure.
+//
+//	The region gets a descriptor of its own (see OpenFileTable::Dup),
+//	so the program may close "id" and keep using the mapping.
+//
+//	"id" -- the open file to map
+//	"length" -- how many bytes of it to map
+//----------------------------------------------------------------------
+
+int
+AddrSpace::Mmap(OpenFileId id, int length)
+{
+    OpenFileTable *files = kernel->currentThread->files;
+    MappedRegion *region = NULL;
+    int count, first;
+
+    if (length <= 0)
+	return -1;
+    for (int i = 0; i < MaxMappings && region == NULL; i++)
+	if (regions[i].id == -1)
+	    region = &regions[i];
+    count = divRoundUp(length, PageSize);
+    if (region == NULL || (first = FindFreePages(count)) == -1)
+	return -1;
+    if ((region->id = files->Dup(id)) == -1)
+	return -1;
+
+    region->file = files->Get(region->id);
+    region->firstPage = first;
+    region->numPages = count;
+    for (int page = first; page < first + count; page++) {
+	pageTable[page].valid = FALSE;
+	pageTable[page].use = FALSE;
+	pageTable[page].dirty = FALSE;
+    }
+    if (first + count > (int) mapLimit)
+	mapLimit = first + count;
+    kernel->machine->pageTableSize = mapLimit;
+    kernel->machine->FlushTranslations();
+
+    DEBUG(dbgAddr, "Mapped " << count << " pages of file " << id << " at page " << first);
+    return first * PageSize;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::PageIn
+// 	Handle a page fault on a mapped page: read it in from the file,
+//	and make it valid.  Past the end of the file, the page is zero.
+//	Return FALSE if "vaddr" is not in any mapped region.
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::PageIn(unsigned int vaddr)
+{
+    int vpn = vaddr / PageSize;
+    MappedRegion *region = FindRegion(vpn);
+    char *frame;
+
+    if (region == NULL || pageTable[vpn].valid)
+	return FALSE;
+    frame = &(kernel->machine->mainMemory[pageTable[vpn].physicalPage * PageSize]);
+    bzero(frame, PageSize);
+    region->file->ReadAt(frame, PageSize, (vpn - region->firstPage) * PageSize);
+    pageTable[vpn].valid = TRUE;
+    pageTable[vpn].dirty = FALSE;
+    kernel->machine->FlushTranslations();
+    kernel->stats->numPageFaults++;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::Unmap
+// 	Write each page of "region" that the program changed back to the
+//	file, then give back the pages and the region's descriptor.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::Unmap(MappedRegion *region)
+{
+    for (int page = region->firstPage; 
+		page < region->firstPage + region->numPages; page++) {
+	if (pageTable[page].valid && pageTable[page].dirty)
+	    region->file->WriteAt(
+		&(kernel->machine->mainMemory[pageTable[page].physicalPage * PageSize]),
+		PageSize, (page - region->firstPage) * PageSize);
+	pageTable[page].valid = TRUE;	// back to the 1:1 default
+	pageTable[page].dirty = FALSE;
+    }
+    kernel->currentThread->files->Remove(region->id);
+    region->id = -1;
+
+    mapLimit = numPages;
+    for (int i = 0; i < MaxMappings; i++)
+	if (regions[i].id != -1 && regions[i].firstPage + regions[i].numPages > (int) mapLimit)
+	    mapLimit = regions[i].firstPage + regions[i].numPages;
+    kernel->machine->pageTableSize = mapLimit;
+    kernel->machine->FlushTranslations();
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::Munmap
+// 	Unmap the region Mmap returned at "addr".
+//	Return 1 on success, -1 if nothing is mapped there.
+//----------------------------------------------------------------------
+
+int
+AddrSpace::Munmap(int addr)
+{
+    MappedRegion *region;
+
+    if (addr % PageSize != 0 || (region = FindRegion(addr / PageSize)) == NULL
+		|| region->firstPage * PageSize != addr)
+	return -1;
+    Unmap(region);
+    return 1;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::UnmapAll
+// 	Unmap every region; called when the program finishes, while its
+//	files are still open.
+//----------------------------------------------------------------------
+
+void
+AddrSpace::UnmapAll()
+{
+    for (int i = 0; i < MaxMappings; i++)
+	if (regions[i].id != -1)
+	    Unmap(&regions[i]);
 }
 
 
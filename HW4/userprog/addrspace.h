@@ -17,6 +17,20 @@
 #include "filesys.h"
 
 #define UserStackSize		1024 	// increase this as necessary!
+#define MaxMappings		4	// files one address space can map
+
+// A file mapped into an address space by Mmap.  Its pages follow the
+// program and its stack; each is read in from the file the first time
+// it is touched, and written back, if changed, by Munmap.
+
+class MappedRegion {
+  public:
+    int firstPage;			// First virtual page of the region
+    int numPages;			// How many pages it covers
+    OpenFile *file;			// The file mapped there
+    OpenFileId id;			// Our own descriptor for "file",
+					// or -1 if this slot is unused
+};
 
 class AddrSpace {
   public:
@@ -39,6 +53,14 @@ class AddrSpace {
     // is 0 for Read, 1 for Write.
     ExceptionType Translate(unsigned int vaddr, unsigned int *paddr, int mode);
 
+    int Mmap(OpenFileId id, int length);	// Map "length" bytes of an
+					// open file; return their address
+    int Munmap(int addr);		// Write back and unmap the region
+					// Mmap returned at "addr"
+    void UnmapAll();			// Unmap everything, before exit
+    bool PageIn(unsigned int vaddr);	// Read in the mapped page holding
+					// "vaddr"; FALSE if it isn't mapped
+
   private:
     TranslationEntry *pageTable;	// Assume linear page table translation
 					// for now!
@@ -48,6 +70,13 @@ class AddrSpace {
     void InitRegisters();		// Initialize user-level CPU registers,
 					// before jumping to user code
 
+    MappedRegion regions[MaxMappings];	// Files mapped by Mmap
+    unsigned int mapLimit;		// Pages in use, mapped ones included
+    MappedRegion *FindRegion(int vpn);	// Region holding page "vpn", or NULL
+    int FindFreePages(int count);	// First of "count" unmapped pages
+					// past the stack, or -1
+    void Unmap(MappedRegion *region);
+
 };
 
 #endif // ADDRSPACE_H
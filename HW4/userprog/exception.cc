@@ -25,6 +25,30 @@
 #include "main.h"
 #include "syscall.h"
 #include "ksyscall.h"
+
+//----------------------------------------------------------------------
+// FetchIoVecs
+// 	Copy the array of IoVecs a user program passed to ReadV or WriteV
+//	into "buffers" and "sizes", translating each buffer address.
+//	Return FALSE if there are too many of them.
+//
+//	"addr" -- where the array is in user memory
+//	"count" -- how many IoVecs it holds
+//----------------------------------------------------------------------
+
+static bool
+FetchIoVecs(int addr, int count, char **buffers, int *sizes)
+{
+    if (count < 0 || count > IoVecMax)
+	return FALSE;
+    for (int i = 0; i < count; i++) {
+	char *iov = &(kernel->machine->mainMemory[addr + 8 * i]);
+	buffers[i] = &(kernel->machine->mainMemory[WordToHost(*(unsigned int *) iov)]);
+	sizes[i] = (int) WordToHost(*(unsigned int *) (iov + 4));
+    }
+    return TRUE;
+}
+
 //----------------------------------------------------------------------
 // ExceptionHandler
 // 	Entry point into the Nachos kernel.  Called when a user program
@@ -156,6 +180,21 @@ ExceptionHandler(ExceptionType which)
 			return;
 			ASSERTNOTREACHED();
 			break;
+		#ifndef FILESYS_STUB
+        case SC_Clone:
+			{
+				char *from = &(kernel->machine->mainMemory[kernel->machine->ReadRegister(4)]);
+				char *to = &(kernel->machine->mainMemory[kernel->machine->ReadRegister(5)]);
+				status = SysClone(from, to);
+				kernel->machine->WriteRegister(2, (int)status);
+			}
+			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+			kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			return;
+			ASSERTNOTREACHED();
+			break;
+		#endif
         case SC_Close:
 			{
 				id = kernel->machine->ReadRegister(4);
@@ -168,6 +207,99 @@ ExceptionHandler(ExceptionType which)
 			return;
 			ASSERTNOTREACHED();
 			break;
+        case SC_Dup:
+			{
+				id = kernel->machine->ReadRegister(4);
+				kernel->machine->WriteRegister(2, (int)SysDup(id));
+			}
+				kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+				kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+				kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			return;
+			ASSERTNOTREACHED();
+			break;
+        case SC_Seek:
+			val = kernel->machine->ReadRegister(4);
+			id = kernel->machine->ReadRegister(5);
+			status = SysSeek(val, id);
+			kernel->machine->WriteRegister(2, (int)status);
+			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+			kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			return;
+			ASSERTNOTREACHED();
+			break;
+        case SC_PRead:
+        case SC_PWrite:
+			val = kernel->machine->ReadRegister(4);
+			buffer = &(kernel->machine->mainMemory[val]);
+			size = kernel->machine->ReadRegister(5);
+			id = kernel->machine->ReadRegister(7);
+			{
+				int position = kernel->machine->ReadRegister(6);
+				int bytes = (type == SC_PRead) ? SysPRead(buffer, size, position, id)
+							: SysPWrite(buffer, size, position, id);
+				kernel->machine->WriteRegister(2, bytes);
+			}
+			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+			kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			return;
+			ASSERTNOTREACHED();
+			break;
+        case SC_ReadV:
+        case SC_WriteV:
+			val = kernel->machine->ReadRegister(4);
+			size = kernel->machine->ReadRegister(5);
+			id = kernel->machine->ReadRegister(6);
+			{
+				char *buffers[IoVecMax];
+				int sizes[IoVecMax];
+				int bytes = -1;
+				if (FetchIoVecs(val, size, buffers, sizes))
+					bytes = (type == SC_ReadV) ? SysReadV(buffers, sizes, size, id)
+								: SysWriteV(buffers, sizes, size, id);
+				kernel->machine->WriteRegister(2, bytes);
+			}
+			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+			kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			return;
+			ASSERTNOTREACHED();
+			break;
+        case SC_CopyFile:
+			{
+				OpenFileId src = kernel->machine->ReadRegister(4);
+				OpenFileId dst = kernel->machine->ReadRegister(5);
+				int offset = kernel->machine->ReadRegister(6);
+				int len = kernel->machine->ReadRegister(7);
+				kernel->machine->WriteRegister(2, SysCopyFile(src, dst, offset, len));
+			}
+			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+			kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			return;
+			ASSERTNOTREACHED();
+			break;
+        case SC_Mmap:
+			id = kernel->machine->ReadRegister(4);
+			size = kernel->machine->ReadRegister(5);
+			kernel->machine->WriteRegister(2, SysMmap(id, size));
+			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+			kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			return;
+			ASSERTNOTREACHED();
+			break;
+        case SC_Munmap:
+			val = kernel->machine->ReadRegister(4);
+			kernel->machine->WriteRegister(2, SysMunmap(val));
+			kernel->machine->WriteRegister(PrevPCReg, kernel->machine->ReadRegister(PCReg));
+			kernel->machine->WriteRegister(PCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			kernel->machine->WriteRegister(NextPCReg, kernel->machine->ReadRegister(PCReg) + 4);
+			return;
+			ASSERTNOTREACHED();
+			break;
       	case SC_Add:
 			DEBUG(dbgSys, "Add " << kernel->machine->ReadRegister(4) << " + " << kernel->machine->ReadRegister(5) << "\n");
 			/* Process SysAdd Systemcall*/
@@ -203,6 +335,12 @@ ExceptionHandler(ExceptionType which)
 			break;
 		}
 		break;
+	case PageFaultException:
+		val = kernel->machine->ReadRegister(BadVAddrReg);
+		if (kernel->currentThread->space->PageIn(val))
+			return;		// the instruction is retried
+		cerr << "Page fault at unmapped address " << val << "\n";
+		break;
 	default:
 		cerr << "Unexpected user mode exception " << (int)which << "\n";
 		break;
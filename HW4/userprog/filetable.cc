@@ -0,0 +1,173 @@
+// filetable.cc 
+//	Routines to manage the table of open files of a process.
+//
+//	The free list is a stack: the id given back most recently is the
+//	next one handed out.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation 
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "filetable.h"
+#include "debug.h"
+
+//----------------------------------------------------------------------
+// OpenFileTable::OpenFileTable
+// 	Initialize an empty table, with every slot on the free list.
+//
+//	"size" is the most files the process can have open at once
+//----------------------------------------------------------------------
+
+OpenFileTable::OpenFileTable(int size)
+{
+    tableSize = size;
+    table = new OpenFileTableEntry[size];
+    for (int i = 0; i < size; i++) {
+	table[i].open = NULL;
+	table[i].nextFree = (i + 1 < size) ? i + 1 : -1;
+    }
+    freeList = (size > 0) ? 0 : -1;
+}
+
+//----------------------------------------------------------------------
+// OpenFileTable::~OpenFileTable
+// 	Close any files still open, and de-allocate the table.
+//----------------------------------------------------------------------
+
+OpenFileTable::~OpenFileTable()
+{
+    RemoveAll();
+    delete [] table;
+}
+
+//----------------------------------------------------------------------
+// OpenFileTable::Slot
+// 	Return the slot that "id" names, or -1 if "id" is not in use.
+//----------------------------------------------------------------------
+
+int
+OpenFileTable::Slot(OpenFileId id)
+{
+    int i = id - 1;
+
+    if (i < 0 || i >= tableSize || table[i].open == NULL)
+	return -1;
+    return i;
+}
+
+//----------------------------------------------------------------------
+// OpenFileTable::Insert
+// 	Take a slot off the free list and point it at "open".
+//	Return its id, or -1 if the table is full.
+//----------------------------------------------------------------------
+
+OpenFileId
+OpenFileTable::Insert(SharedOpenFile *open)
+{
+    int i = freeList;
+
+    if (i == -1)
+	return -1;
+    freeList = table[i].nextFree;
+    table[i].open = open;
+    table[i].nextFree = -1;
+    return i + 1;
+}
+
+//----------------------------------------------------------------------
+// OpenFileTable::Add
+// 	Hand out an id for a newly opened file.  The table owns the file
+//	from now on, and deletes it when its last id is removed.
+//	Return -1 (and leave "file" to the caller) if the table is full.
+//
+//	"file" -- the file just opened
+//----------------------------------------------------------------------
+
+OpenFileId
+OpenFileTable::Add(OpenFile *file)
+{
+    SharedOpenFile *open = new SharedOpenFile;
+    OpenFileId id;
+
+    open->file = file;
+    open->refs = 1;
+    if ((id = Insert(open)) == -1)
+	delete open;
+    return id;
+}
+
+//----------------------------------------------------------------------
+// OpenFileTable::Get
+// 	Return the open file "id" refers to, or NULL if there is none.
+//----------------------------------------------------------------------
+
+OpenFile *
+OpenFileTable::Get(OpenFileId id)
+{
+    int i = Slot(id);
+
+    return (i == -1) ? NULL : table[i].open->file;
+}
+
+//----------------------------------------------------------------------
+// OpenFileTable::Dup
+// 	Hand out a second id for the file "id" refers to.  Reads and
+//	writes through either id move the same seek position.
+//	Return -1 if "id" is not open, or if the table is full.
+//----------------------------------------------------------------------
+
+OpenFileId
+OpenFileTable::Dup(OpenFileId id)
+{
+    int i = Slot(id);
+    OpenFileId newId;
+
+    if (i == -1)
+	return -1;
+    if ((newId = Insert(table[i].open)) != -1)
+	table[i].open->refs++;
+    return newId;
+}
+
+//----------------------------------------------------------------------
+// OpenFileTable::Remove
+// 	Give back "id", and put its slot on the free list.  The file is
+//	closed once no id refers to it.
+//	Return 1 on success, -1 if "id" is not open.
+//----------------------------------------------------------------------
+
+int
+OpenFileTable::Remove(OpenFileId id)
+{
+    int i = Slot(id);
+    SharedOpenFile *open;
+
+    if (i == -1)
+	return -1;
+    open = table[i].open;
+    table[i].open = NULL;
+    table[i].nextFree = freeList;
+    freeList = i;
+
+    if (--open->refs == 0) {
+	delete open->file;
+	delete open;
+    }
+    return 1;
+}
+
+//----------------------------------------------------------------------
+// OpenFileTable::RemoveAll
+// 	Give back every id still in use; called when the process ends.
+//----------------------------------------------------------------------
+
+void
+OpenFileTable::RemoveAll()
+{
+    for (int i = 0; i < tableSize; i++)
+	if (table[i].open != NULL) {
+	    DEBUG(dbgFile, "Closing leftover open file " << i + 1);
+	    Remove(i + 1);
+	}
+}
@@ -0,0 +1,72 @@
+// filetable.h 
+//	Data structures for the table of open files of a process.
+//
+//	Each thread has a table of its own, mapping the OpenFileIds it was
+//	handed by Open to the files themselves.  Ids are never shared
+//	between processes, and whatever is still open when the thread
+//	finishes is closed then.
+//
+//	Free slots are kept on a list threaded through the table, so that
+//	handing out or giving back an id takes constant time, however
+//	many files are open.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation 
+// of liability and disclaimer of warranty provisions.
+
+#ifndef FILETABLE_H
+#define FILETABLE_H
+
+#include "copyright.h"
+#include "openfile.h"
+
+typedef int OpenFileId;
+
+// An open file, with the number of ids that refer to it.  Dup makes
+// a second id for the same SharedOpenFile, so that the two share one
+// seek position, as in UNIX.
+
+class SharedOpenFile {
+  public:
+    OpenFile *file;			// The open file
+    int refs;				// How many ids refer to it
+};
+
+// One slot of the table: either in use, or on the free list.
+
+class OpenFileTableEntry {
+  public:
+    SharedOpenFile *open;		// NULL if the slot is free
+    int nextFree;			// Next free slot, or -1
+};
+
+// The following class defines the open file table of one process.
+// OpenFileIds are the slot numbers plus one, so that 0 (console input)
+// is never handed out.
+
+class OpenFileTable {
+  public:
+    OpenFileTable(int size);		// Initialize an empty table with
+					// room for "size" open files
+    ~OpenFileTable();			// Close everything, de-allocate
+
+    OpenFileId Add(OpenFile *file);	// Give "file" an id; -1 if full
+    OpenFile *Get(OpenFileId id);	// The file "id" refers to, or NULL
+    OpenFileId Dup(OpenFileId id);	// A second id for the same open
+					// file; -1 on failure
+    int Remove(OpenFileId id);		// Give back "id", closing the file
+					// if it was the last id for it;
+					// 1 on success, -1 on failure
+    void RemoveAll();			// Give back every id
+
+  private:
+    int tableSize;			// Number of slots
+    OpenFileTableEntry *table;		// The slots
+    int freeList;			// First free slot, or -1 if full
+
+    int Slot(OpenFileId id);		// Slot of an id in use, or -1
+    OpenFileId Insert(SharedOpenFile *open);
+					// Put "open" in a free slot
+};
+
+#endif // FILETABLE_H
@@ -60,5 +60,51 @@ int SysClose(int id){
     return kernel->interrupt->Close(id); 
 }
 
+OpenFileId SysDup(OpenFileId id){
+    return kernel->interrupt->Dup(id);
+}
+
+int SysSeek(int position, OpenFileId id){
+    return kernel->interrupt->Seek(position, id);
+}
+
+int SysPRead(char *buffer, int size, int position, OpenFileId id){
+    return kernel->interrupt->PRead(buffer, size, position, id);
+}
+
+int SysPWrite(char *buffer, int size, int position, OpenFileId id){
+    return kernel->interrupt->PWrite(buffer, size, position, id);
+}
+
+int SysReadV(char **buffers, int *sizes, int count, OpenFileId id){
+    return kernel->interrupt->ReadV(buffers, sizes, count, id);
+}
+
+int SysWriteV(char **buffers, int *sizes, int count, OpenFileId id){
+    return kernel->interrupt->WriteV(buffers, sizes, count, id);
+}
+
+int SysCopyFile(OpenFileId src, OpenFileId dst, int offset, int len){
+    return kernel->interrupt->CopyFile(src, dst, offset, len);
+}
+
+int SysMmap(OpenFileId id, int length){
+    return kernel->interrupt->Mmap(id, length);
+}
+
+int SysMunmap(int addr){
+    return kernel->interrupt->Munmap(addr);
+}
+
+#ifndef FILESYS_STUB
+int SysClone(char *from, char *to)
+{
+	// return value
+	// 1: success
+	// 0: failed
+	return kernel->interrupt->CloneFile(from, to);
+}
+#endif
+
 
 #endif /* ! __USERPROG_KSYSCALL_H__ */
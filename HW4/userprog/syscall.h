@@ -34,6 +34,15 @@
 #define SC_ExecV	13
 #define SC_ThreadExit   14
 #define SC_ThreadJoin   15
+#define SC_Clone	16
+#define SC_Dup		17
+#define SC_PRead	18
+#define SC_PWrite	19
+#define SC_ReadV	20
+#define SC_WriteV	21
+#define SC_CopyFile	22
+#define SC_Mmap		23
+#define SC_Munmap	24
 #define SC_Add		42
 #define SC_MSG		100
 
@@ -140,14 +149,71 @@ int Read(char *buffer, int size, OpenFileId id);
 
 /* Set the seek position of the open file "id"
  * to the byte "position".
+ * Return 1 on success, -1 on failure
  */
 int Seek(int position, OpenFileId id);
 
+/* Read or write "size" bytes at the byte "position" of the open file,
+ * without using or moving its seek position.  Several threads can
+ * share one OpenFileId this way.
+ * Return the number of bytes actually read/written, -1 on failure.
+ */
+int PRead(char *buffer, int size, int position, OpenFileId id);
+int PWrite(char *buffer, int size, int position, OpenFileId id);
+
+/* One buffer of a vectored read or write. */
+typedef struct {
+    char *buffer;
+    int size;
+} IoVec;
+
+/* Most buffers one ReadV or WriteV can move */
+#define IoVecMax	16
+
+/* Like Read and Write, but fill or drain the "count" buffers of "iov"
+ * in order, as one operation on the file.
+ * Return the total number of bytes read/written, -1 on failure.
+ */
+int ReadV(IoVec *iov, int count, OpenFileId id);
+int WriteV(IoVec *iov, int count, OpenFileId id);
+
+/* Copy "len" bytes at the byte "offset" of the open file "src" to the
+ * same place in the open file "dst", without the data passing through
+ * the user program.  Neither seek position moves.
+ * Return the number of bytes copied (fewer if "src" ends first, or
+ * "dst" is too short), -1 on failure.
+ */
+int CopyFile(OpenFileId src, OpenFileId dst, int offset, int len);
+
+/* Map the first "length" bytes of the open file "id" into memory, and
+ * return their address; -1 on failure.  Pages are read from the file
+ * when first touched.  The mapping stays valid after Close(id).
+ */
+char *Mmap(OpenFileId id, int length);
+
+/* Write the changed pages of the mapping at "addr" back to the file, and
+ * unmap it.  Mappings left at exit are unmapped the same way.
+ * Return 1 on success, -1 on failure.
+ */
+int Munmap(char *addr);
+
 /* Close the file, we're done reading and writing to it.
  * Return 1 on success, negative error code on failure
  */
 int Close(OpenFileId id);
 
+/* Return a second OpenFileId for the open file "id".  Both share one
+ * seek position, and the file stays open until both are closed.
+ * Return -1 on failure.
+ */
+OpenFileId Dup(OpenFileId id);
+
+/* Make the Nachos file "to" a copy of the file "from".  No data is
+ * copied until one of the two files is written.
+ * Return 1 on success, 0 on failure
+ */
+int Clone(char *from, char *to);
+
 
 /* User-level thread operations: Fork and Yield.  To allow multiple
  * threads to run within a user program. 